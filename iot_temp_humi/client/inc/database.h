@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-05 19:24:03
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-10 18:18:29
+ * @LastEditTime: 2026-10-17 20:08:01
  * @Description: sqlite的使用
  */
 
@@ -11,8 +11,44 @@
 
 #include "iot_main.h"
 #include "packinfo.h"
+#include <stdint.h>
 
-int database_init(char *dbname, sqlite3 **db);
+#define DB_PROFILE_DEFAULT  "durable"     // 默认存储配置
+
+/***
+ * @name: db_profile_t
+ * @description: 存储配置，在database_init()打开数据库时一次性设置
+ */
+typedef struct db_profile_s
+{
+    char            name[16];           // 预设名
+    char            journal_mode[16];   // 日志模式 WAL/DELETE/TRUNCATE...
+    char            synchronous[8];     // 同步级别 OFF/NORMAL/FULL/EXTRA
+    long long       mmap_size;          // 内存映射大小(字节)，0为不使用
+    int             page_size;          // 页大小(字节)，只对新建的数据库文件生效
+    int             cache_size;         // 页缓存大小，负数为KiB
+    int             wal_autocheckpoint; // WAL自动检查点页数
+} db_profile_t;
+
+/***
+ * @name: db_batch_t
+ * @description: 批量插入句柄，缓存预编译的INSERT语句，多行合并到一个事务中提交
+ */
+typedef struct db_batch_s
+{
+    sqlite3        *db;                 // 数据库句柄
+    sqlite3_stmt   *stmt;               // 缓存的INSERT语句
+    int             max_rows;           // 每个事务最多插入的行数
+    int             max_ms;             // 事务最长持续时间(ms)
+    int             pending;            // 当前事务中未提交的行数
+    long long       begin_ms;           // 当前事务开始时间(ms)
+    uint64_t        rows;               // 已提交的行数
+    uint64_t        commits;            // 已提交的事务数
+} db_batch_t;
+
+int database_profile_parse(const char *str, db_profile_t *profile);
+
+int database_init(char *dbname, sqlite3 **db, const db_profile_t *profile);
 
 int database_close(char *dbname, sqlite3 **db);
 
@@ -24,8 +60,24 @@ int database_select_data(char *dbname, sqlite3 **db, packinfo_t *pack_info);
 
 int database_delete_data(char *dbname, sqlite3 **db);
 
+int database_select_batch(char *dbname, sqlite3 **db, int64_t after_rowid, packinfo_t *pack_info, int max_rows, int64_t *last_rowid);
+
+int database_delete_upto(char *dbname, sqlite3 **db, int64_t last_rowid);
+
 int database_check_data(char *dbname, sqlite3 **db);
 
+int database_rowid_range(char *dbname, sqlite3 **db, int64_t *min_rowid, int64_t *max_rowid);
+
+int database_batch_init(char *dbname, sqlite3 **db, db_batch_t *batch, int max_rows, int max_ms);
+
+int database_batch_insert(db_batch_t *batch, packinfo_t *pack_info);
+
+int database_batch_commit(db_batch_t *batch);
+
+int database_batch_poll(db_batch_t *batch);
+
+int database_batch_close(db_batch_t *batch);
+
 
 
 
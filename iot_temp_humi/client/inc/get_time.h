@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-04 17:04:22
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-04 17:26:19
+ * @LastEditTime: 2026-10-17 21:04:02
  * @Description: 获取时间函数
  */
 
@@ -11,8 +11,13 @@
 
 #include "iot_main.h"
 #include <sys/time.h>
+#include <time.h>
 
 double get_time(char *datime);
 
+int64_t get_time_ms(char *datime);
+
+int64_t get_time_parse(const char *datime);
+
 
 # endif
@@ -2,8 +2,8 @@
  * @Author: RoxyKko
  * @Date: 2023-03-24 19:10:08
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-03-25 21:31:06
- * @Description: sht20驱动
+ * @LastEditTime: 2026-10-17 21:04:02
+ * @Description: sht20驱动，通过sensor.h的总线后端访问器件
  */
 #ifndef _I2C_SHT20_IOCTL_H_
 #define _I2C_SHT20_IOCTL_H_
@@ -12,20 +12,15 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
-#include <gpiod.h>
 #include <errno.h>
 #include <string.h>
 #include <stdint.h>
 #include <time.h>
 #include <sys/stat.h>
-#include <sys/ioctl.h>
-#include <linux/types.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
 
-#define I2C_BUS                     "/dev/i2c-1"    // 设备名
+#include "sensor.h"
+
 #define SHT20_ADDR                  0x40            // i2c设备物理地址
-#define CHIP_NAME                   "/dev/gpiochip0"     // GPIO NAME
 
 #define CMD_TRIGGER_TEMP_HOLD       0xE3            // 温度触发保持         8'b1110’0011 = 0xE3
 #define CMD_TRIGGER_HUMI_HOLD       0xE5            // 湿度触发保持         8'b1110’0101 = 0xE5
@@ -36,13 +31,73 @@
 #define CMD_SOFT_RESET              0xFE            // 软复位               8'b1111’1110 = 0xFE
 
 #define SHT20_MEASURING_DELAY 15                    // 上升沿延迟 15ms
+#define SHT20_USER_REG_RES          0x81            // 用户寄存器中的分辨率位 bit7、bit0
+#define SHT20_RESET_DELAY           50              // 软复位等待时间(ms)
+#define SHT20_POLL_INTERVAL         2               // NACK轮询间隔(ms)
+#define SHT20_RETRY_MAX             2               // 每次采样在总线错误或CRC错误后最多重试的次数
+#define SHT20_MODE_DEFAULT          "poll"          // 默认采集方式
+#define SHT20_RESOLUTION_DEFAULT    "14/12"         // 上电和软复位后的分辨率
+
+/***
+ * @name: SHT2X_STATE
+ * @description: 异步测量的状态
+ */
+enum SHT2X_STATE
+{
+    SHT2X_IDLE = 0,                                 // 没有进行中的测量
+    SHT2X_TEMP,                                     // 温度转换中
+    SHT2X_HUMI                                      // 湿度转换中
+};
+
+/***
+ * @name: SHT2X_MODE
+ * @description: 采集方式
+ */
+enum SHT2X_MODE
+{
+    SHT2X_MODE_DELAY = 0,                           // 不保持主机，按数据手册最长转换时间等待后读取
+    SHT2X_MODE_POLL,                                // 不保持主机，每SHT20_POLL_INTERVAL毫秒读一次，器件不再NACK时即读出
+    SHT2X_MODE_HOLD                                 // 保持主机，器件拉低SCL直到转换完成，写命令和读结果在一次传输中完成，会阻塞调用者
+};
+
+/***
+ * @name: SHT2X_RESOLUTION
+ * @description: 温度/湿度分辨率，取值为用户寄存器 bit7<<1 | bit0，转换时间见i2c_sht20.c中的数据手册时间表
+ */
+enum SHT2X_RESOLUTION
+{
+    SHT2X_RES_14_12 = 0,                            // 14位温度/12位湿度，默认
+    SHT2X_RES_12_8,                                 // 12位温度/8位湿度
+    SHT2X_RES_13_10,                                // 13位温度/10位湿度
+    SHT2X_RES_11_11                                 // 11位温度/11位湿度
+};
 
-#define I2C_API_RDWR                                // 使用i2c用户空间驱动Read/Write API (linux/i2c-dev.h)
-// #define I2C_API_IOCTL                               // 使用i2c用户空间驱动LOCTL API (linux/i2c-dev.h)
+/***
+ * @name: sht2x_meas_t
+ * @description: 一次异步测量，sht2x_trigger()开始，sht2x_collect()在转换完成后读出结果
+ */
+typedef struct sht2x_meas_s
+{
+    int             state;                          // enum SHT2X_STATE
+    int             mode;                           // enum SHT2X_MODE
+    int             resolution;                     // enum SHT2X_RESOLUTION，决定等待的转换时间
+    long long       deadline_ms;                    // 轮询放弃的时刻
+    int             attempts;                       // 本次采样已用的重试次数
+    uint32_t        crc_errors;                     // 累计CRC或状态位错误
+    uint32_t        retries;                        // 累计重试次数
+    float           temp;                           // 温度
+    float           rh;                             // 湿度
+} sht2x_meas_t;
 
-int sht2x_init(void);
-int sht2x_softReset(int fd);
-int sht2x_get_temp_humidity(int fd, float *temp, float *rh);
-int sht2x_get_serialNumber(int fd, uint8_t *serialNumber, int size);
+int sht2x_init(sensor_t *sensor, const char *spec);
+int sht2x_mode_parse(const char *str);
+int sht2x_resolution_parse(const char *str);
+int sht2x_meas_time(int resolution);
+int sht2x_set_resolution(sensor_t *sensor, int resolution);
+int sht2x_softReset(sensor_t *sensor);
+int sht2x_trigger(sensor_t *sensor, sht2x_meas_t *meas);
+int sht2x_collect(sensor_t *sensor, sht2x_meas_t *meas);
+int sht2x_get_temp_humidity(sensor_t *sensor, float *temp, float *rh);
+int sht2x_get_serialNumber(sensor_t *sensor, uint8_t *serialNumber, int size);
 
 #endif
\ No newline at end of file
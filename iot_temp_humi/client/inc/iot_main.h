@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-04 17:06:27
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-10 18:26:32
+ * @LastEditTime: 2026-10-17 20:35:14
  * @Description: 
  */
 
@@ -17,11 +17,13 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
-#include <gpiod.h>
 #include <stdint.h>
 #include <ctype.h>
 #include <syslog.h>
 #include <signal.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 
 #include "i2c_sht20.h"
 #include "socket_client.h"
@@ -30,5 +32,8 @@
 #include "logger.h"
 #include "database.h"
 #include "packinfo.h"
+#include "send_window.h"
+#include "sample_ring.h"
+#include "sampler.h"
 
 # endif
\ No newline at end of file
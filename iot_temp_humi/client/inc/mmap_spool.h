@@ -0,0 +1,109 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:50:00
+ * @Description: 基于内存映射的追加式缓存文件，按队列使用，替代SQLite缓存
+ *
+ *   文件预分配为 1页文件头 + capacity条64字节记录，记录按序号对capacity取模循环存放
+ *   +-----------------+----------+----------+-----+
+ *   | 文件头(4096字节) | 记录0    | 记录1    | ... |
+ *   +-----------------+----------+----------+-----+
+ *
+ *   追加只写一条记录，每max_rows条或max_ms毫秒msync一次脏记录所在的页
+ *   文件头中的head/tail不单独同步，由内核回写，打开文件时从tail向后扫描序号连续且CRC正确的记录恢复tail
+ *   取走记录只修改内存中的head，断电后可能重发少量已取走的记录，服务器按(设备,时间)去重
+ */
+
+#ifndef __MMAP_SPOOL_H__
+#define __MMAP_SPOOL_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "packinfo.h"
+#include "proto.h"
+#include "logger.h"
+
+#define MMAP_SPOOL_MAGIC        0x314C5053  // "SPL1"
+#define MMAP_SPOOL_HDR_SIZE     4096        // 文件头大小，一页
+#define MMAP_SPOOL_REC_SIZE     64          // 记录大小
+#define MMAP_SPOOL_TIME_LEN     20          // 记录中时间字符串长度，"YYYY-MM-DD HH:MM:SS"
+#define MMAP_SPOOL_DEFAULT      262144      // 默认容量，16MiB，4s采样约12天
+#define MMAP_SPOOL_MAX          (1 << 24)   // 容量上限
+
+/***
+ * @name: mmap_spool_hdr_t
+ * @description: 文件头，head和tail是从0开始递增的记录序号
+ */
+typedef struct mmap_spool_hdr_s
+{
+    uint32_t        magic;                  // MMAP_SPOOL_MAGIC
+    uint32_t        rec_size;               // 记录大小
+    uint32_t        capacity;               // 记录条数
+    uint32_t        reserved;
+    uint64_t        head;                   // 最早一条记录的序号
+    uint64_t        tail;                   // 下一条记录的序号
+    uint16_t        crc;                    // CRC-16/CCITT-FALSE，覆盖crc之前的字段
+} mmap_spool_hdr_t;
+
+/***
+ * @name: mmap_spool_rec_t
+ * @description: 定长记录，seq与所在位置不符或CRC错误的记录视为无效
+ */
+typedef struct mmap_spool_rec_s
+{
+    uint64_t        seq;                    // 记录序号
+    int64_t         ts;                     // 采样时间，epoch毫秒
+    float           temp;                   // 温度
+    float           humi;                   // 湿度
+    char            devid[DEVID_LEN];       // 设备名
+    char            time[MMAP_SPOOL_TIME_LEN]; // 采样时间字符串
+    uint16_t        crc;                    // CRC-16/CCITT-FALSE，覆盖crc之前的字段
+    uint16_t        reserved;
+} mmap_spool_rec_t;
+
+/***
+ * @name: mmap_spool_t
+ * @description: 打开的缓存文件
+ */
+typedef struct mmap_spool_s
+{
+    int                 fd;                 // 文件描述符
+    uint8_t            *base;               // 映射地址
+    size_t              size;               // 映射长度
+    mmap_spool_hdr_t   *hdr;                // 文件头
+    mmap_spool_rec_t   *recs;               // 记录数组
+    uint32_t            capacity;           // 记录条数
+    uint64_t            synced;             // 已同步到存储的tail
+    int                 max_rows;           // 每同步一次最多追加的记录数
+    int                 max_ms;             // 未同步记录最长等待时间(ms)
+    long long           first_ms;           // 最早一条未同步记录的追加时间(ms)
+    int                 skipped;            // 上一次读取时跳过的损坏记录数
+    uint64_t            dropped;            // 文件满时覆盖的最早记录数
+} mmap_spool_t;
+
+int mmap_spool_open(mmap_spool_t *sp, const char *path, uint32_t capacity, int max_rows, int max_ms);
+
+int mmap_spool_append(mmap_spool_t *sp, const packinfo_t *pack_info);
+
+int mmap_spool_sync(mmap_spool_t *sp);
+
+int mmap_spool_poll(mmap_spool_t *sp);
+
+int mmap_spool_count(mmap_spool_t *sp);
+
+int mmap_spool_read(mmap_spool_t *sp, packinfo_t *pack_info, int max_rows);
+
+void mmap_spool_consume(mmap_spool_t *sp, int count);
+
+int mmap_spool_close(mmap_spool_t *sp);
+
+#endif
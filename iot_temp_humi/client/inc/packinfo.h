@@ -2,13 +2,15 @@
  * @Author: RoxyKko
  * @Date: 2023-04-05 22:32:51
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-05 22:34:21
+ * @LastEditTime: 2026-10-17 19:33:34
  * @Description: 传输数据结构体
  */
 
 #ifndef __PACKINFO_H__
 #define __PACKINFO_H__
 
+#include <stdint.h>
+
 #define DEVID_LEN   16
 #define TIME_LEN    32
 
@@ -17,6 +19,7 @@ typedef struct packinfo_st
 {
     char devid[DEVID_LEN];
     char time[TIME_LEN];
+    int64_t ts;             // 采样时间，epoch毫秒
     float temp;
     float humi;
 } packinfo_t;
@@ -0,0 +1,67 @@
+/***
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:43:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:43:00
+ * @Description: 持久化线程，采样流水线的第二级
+ *
+ *   采样线程 --SPSC--> 持久化线程 --SPSC--> 网络线程(主线程)
+ *   持久化线程独占溢出缓存，网络线程的内存缓冲区和发送队列放不下的采样写入溢出缓存
+ *   网络线程取走采样后再按顺序从溢出缓存读回，慢速的fsync不阻塞发送，慢速的发送也不阻塞落盘
+ */
+
+#ifndef __PERSIST_H__
+#define __PERSIST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "logger.h"
+#include "packinfo.h"
+#include "spool.h"
+#include "sampler.h"
+#include "sample_queue.h"
+
+#define PERSIST_QUEUE_SIZE      64      // 交给网络线程的队列容量，必须为2的幂，内存中的采样最多为-M加上这么多
+#define PERSIST_REFILL_ROWS     64      // 每次从溢出缓存读回的最多行数
+#define PERSIST_WAIT_TIMEOUT    1000    // 没有事务要提交时的最长等待(ms)
+
+/***
+ * @name: persist_t
+ * @description: 持久化线程，启动后溢出缓存只由本线程访问，退出后交还给主线程
+ *               spooled和error由本线程写、网络线程读
+ */
+typedef struct persist_s
+{
+    pthread_t       tid;                        // 线程id
+    spool_t        *spool;                      // 溢出缓存
+    sampler_t      *sampler;                    // 输入，各总线的采样队列
+    sample_queue_t  out;                        // 输出，按采样顺序交给网络线程
+    int             out_efd;                    // out中有新采样时写入，网络线程在epoll中等待
+    int             wake_efd;                   // 网络线程取走采样后写入，唤醒本线程从溢出缓存读回
+    int             stop;                       // 为1时取完采样队列后退出
+    int             error;                      // 溢出缓存读写失败时为负数
+    int             spooled;                    // 溢出缓存中的采样数
+    uint64_t        spilled;                    // 写入溢出缓存的采样数
+    uint64_t        refilled;                   // 从溢出缓存读回的采样数
+    long long       max_busy_ms;                // 一轮处理的最长耗时，慢速的写入和fsync体现在这里
+    packinfo_t      rows[PERSIST_REFILL_ROWS];  // 读回用的临时数组
+} persist_t;
+
+int persist_start(persist_t *persist, spool_t *spool, sampler_t *sampler);
+
+void persist_kick(persist_t *persist);
+
+void persist_stop(persist_t *persist);
+
+void persist_free(persist_t *persist);
+
+#endif
@@ -0,0 +1,57 @@
+/***
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:35:14
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:43:00
+ * @Description: 线程之间传递采样的有界无锁单生产者单消费者队列
+ */
+
+#ifndef __SAMPLE_QUEUE_H__
+#define __SAMPLE_QUEUE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "packinfo.h"
+
+#define SAMPLE_QUEUE_SIZE       256     // 默认队列容量，必须为2的幂
+#define CACHELINE_SIZE          64
+
+/***
+ * @name: sample_queue_t
+ * @description: 有界SPSC环形队列，tail只由生产者修改，head只由消费者修改，分别放在不同缓存行
+ *               入队后写一次eventfd，消费者在epoll中等待，多个队列可以共用同一个eventfd
+ */
+typedef struct sample_queue_s
+{
+    packinfo_t     *slots;                      // 槽位数组
+    uint64_t        mask;                       // 容量-1
+    int             efd;                        // 入队后写入的eventfd，-1为不通知
+
+    char            pad0[CACHELINE_SIZE];
+    uint64_t        tail;                       // 下一个入队位置，生产者写
+    uint64_t        high_water;                 // 队列深度最高水位，生产者写
+    uint64_t        drops;                      // 队列已满丢弃的采样数，生产者写
+    char            pad1[CACHELINE_SIZE - 3 * sizeof(uint64_t)];
+    uint64_t        head;                       // 下一个出队位置，消费者写
+    char            pad2[CACHELINE_SIZE - sizeof(uint64_t)];
+} sample_queue_t;
+
+int sample_queue_init(sample_queue_t *queue, uint64_t capacity, int efd);
+
+void sample_queue_destroy(sample_queue_t *queue);
+
+int sample_queue_push(sample_queue_t *queue, const packinfo_t *pack);
+
+int sample_queue_pop(sample_queue_t *queue, packinfo_t *pack);
+
+uint64_t sample_queue_depth(sample_queue_t *queue);
+
+uint64_t sample_queue_space(sample_queue_t *queue);
+
+#endif
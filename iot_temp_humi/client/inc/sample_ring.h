@@ -0,0 +1,48 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:20:00
+ * @Description: 内存中的采样环形缓冲区，放在SQLite缓存之前，短时断网时不写闪存
+ */
+
+#ifndef __SAMPLE_RING_H__
+#define __SAMPLE_RING_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "packinfo.h"
+
+#define SAMPLE_RING_DEFAULT     1024        // 默认容量，4s采样约68分钟
+#define SAMPLE_RING_MAX         (1 << 20)   // 容量上限
+
+/***
+ * @name: sample_ring_t
+ * @description: 采样环形缓冲区，每条记录有一个从1开始递增的位置，位置对size取模即为下标
+ *               [head, tail)是还未被服务器确认的记录，发送窗口用位置代替rowid
+ */
+typedef struct sample_ring_s
+{
+    packinfo_t     *slots;                  // 记录数组
+    int             size;                   // 容量
+    int64_t         head;                   // 最早一条记录的位置
+    int64_t         tail;                   // 下一条记录的位置
+} sample_ring_t;
+
+int sample_ring_init(sample_ring_t *ring, int size);
+
+void sample_ring_free(sample_ring_t *ring);
+
+int sample_ring_count(sample_ring_t *ring);
+
+int sample_ring_space(sample_ring_t *ring);
+
+int sample_ring_push(sample_ring_t *ring, const packinfo_t *pack_info);
+
+int sample_ring_peek(sample_ring_t *ring, int64_t after, packinfo_t *pack_info, int max_rows, int64_t *last);
+
+void sample_ring_release(sample_ring_t *ring, int64_t upto);
+
+#endif
@@ -0,0 +1,105 @@
+/***
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:35:14
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:04:02
+ * @Description: 多传感器采样，每条i2c总线一个采样线程，各总线并行，同一总线上的器件依次测量
+ *
+ *   传感器表每行一个器件，#开头为注释:
+ *   DEVID  PERIOD  SENSOR
+ *   DEVID   设备id，随采样上报，最长15个字符
+ *   PERIOD  采样周期(s)，可以带小数，不能短于所选分辨率一次采样的最长转换时间(-r 11/11时为26ms)
+ *   SENSOR  传感器后端配置，见sensor.h，bus相同的器件由同一个线程采样
+ *           i2c多路复用器的每个通道在内核中是单独的/dev/i2c-N
+ */
+
+#ifndef __SAMPLER_H__
+#define __SAMPLER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "logger.h"
+#include "packinfo.h"
+#include "get_time.h"
+#include "i2c_sht20.h"
+#include "sample_queue.h"
+
+#define SAMPLER_MAX_SENSORS     32      // 传感器表最多的器件数
+#define SAMPLER_MAX_BUSES       8       // 最多的总线数，即采样线程数
+#define SAMPLER_SPEC_LEN        128     // 传感器后端配置的最大长度
+
+/***
+ * @name: sampler_sensor_t
+ * @description: 传感器表中的一个器件，打开后只由所在总线的采样线程访问
+ */
+typedef struct sampler_sensor_s
+{
+    char            devid[DEVID_LEN];           // 设备id
+    char            spec[SAMPLER_SPEC_LEN];     // 传感器后端配置
+    int             period_ms;                  // 采样周期(ms)
+    sensor_t        sensor;                     // 打开的传感器
+    sht2x_meas_t    meas;                       // 测量状态和总线错误计数
+    long long       next_ms;                    // 下一次采样的单调时钟时刻
+    uint64_t        samples;                    // 成功的采样数
+    uint64_t        failures;                   // 失败的采样数
+    uint64_t        skipped;                    // 总线忙不过来而跳过的周期数
+    long long       max_late_ms;                // 开始测量时比计划时刻晚的最大毫秒数
+} sampler_sensor_t;
+
+typedef struct sampler_s sampler_t;
+
+/***
+ * @name: sampler_bus_t
+ * @description: 一条总线和它的采样线程，采样经本总线的SPSC队列交给持久化线程
+ */
+typedef struct sampler_bus_s
+{
+    pthread_t       tid;                        // 线程id
+    char            bus[64];                    // i2c总线设备
+    int             sensors[SAMPLER_MAX_SENSORS];   // 本总线上的器件在传感器表中的下标
+    int             count;                      // 本总线上的器件数
+    sample_queue_t  queue;                      // 采样队列
+    sampler_t      *sampler;                    // 所属的采样器
+} sampler_bus_t;
+
+/***
+ * @name: sampler_t
+ * @description: 采样器，所有总线的采样汇入持久化线程，再按顺序交给网络线程
+ */
+struct sampler_s
+{
+    sampler_sensor_t sensors[SAMPLER_MAX_SENSORS];  // 传感器表
+    int             count;                      // 器件数
+    sampler_bus_t   buses[SAMPLER_MAX_BUSES];   // 总线
+    int             nbus;                       // 总线数
+    int             next_bus;                   // 下一次出队从哪条总线开始，各总线轮流
+    int             efd;                        // 有新采样时写入，持久化线程在poll中等待
+    int             stop_efd;                   // 写入后采样线程退出
+};
+
+int sampler_init(sampler_t *sampler);
+
+int sampler_add(sampler_t *sampler, const char *devid, const char *spec, int period_ms);
+
+int sampler_load(sampler_t *sampler, const char *path);
+
+int sampler_start(sampler_t *sampler, int mode, int resolution);
+
+int sampler_pop(sampler_t *sampler, packinfo_t *pack);
+
+uint64_t sampler_depth(sampler_t *sampler);
+
+void sampler_stop(sampler_t *sampler);
+
+void sampler_free(sampler_t *sampler);
+
+#endif
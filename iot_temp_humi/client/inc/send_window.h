@@ -0,0 +1,58 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:40:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:56:45
+ * @Description: 缓存数据的发送窗口，记录已发送但服务器还未确认的批量帧
+ */
+
+#ifndef __SEND_WINDOW_H__
+#define __SEND_WINDOW_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#define SEND_WINDOW_DEFAULT     4           // 默认最多在途的批量帧数
+#define SEND_WINDOW_MAX         16          // 最多在途的批量帧数上限
+#define SEND_ACK_TIMEOUT        10000       // 最早的在途批量帧等待确认的超时(ms)，超时后重连重发
+
+/***
+ * @name: send_inflight_t
+ * @description: 一个在途的批量帧
+ */
+typedef struct send_inflight_s
+{
+    uint32_t        seq;                    // 批量帧序号
+    int64_t         last_pos;               // 帧中最后一条记录在环形缓冲区中的位置，确认后释放到这一条
+    long long       sent_ms;                // 发送时间(ms)
+} send_inflight_t;
+
+/***
+ * @name: send_window_t
+ * @description: 发送窗口，在途的批量帧按序号递增排列，服务器的确认是累计的
+ *               cursor之前的记录都已发送，下一批从cursor之后读取
+ */
+typedef struct send_window_s
+{
+    int             size;                   // 最多在途的批量帧数
+    int             head;                   // 最早的在途批量帧下标
+    int             count;                  // 在途批量帧数
+    uint32_t        next_seq;               // 下一个批量帧序号
+    int64_t         cursor;                 // 已发送的最后一条记录的位置
+    send_inflight_t inflight[SEND_WINDOW_MAX];
+} send_window_t;
+
+int send_window_init(send_window_t *win, int size);
+
+void send_window_reset(send_window_t *win);
+
+int send_window_full(send_window_t *win);
+
+uint32_t send_window_push(send_window_t *win, int64_t last_pos);
+
+int64_t send_window_ack(send_window_t *win, uint32_t seq);
+
+int send_window_expired(send_window_t *win, int timeout_ms);
+
+#endif
@@ -0,0 +1,70 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 22:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:22:00
+ * @Description: 传感器总线抽象层，i2c_sht20.c的协议代码只通过sensor_write()/sensor_read()访问器件
+ *
+ *   启动时用配置字符串选择后端:
+ *   i2c-rdwr[,bus=PATH,addr=ADDR]    每次传输一条ioctl(I2C_RDWR)
+ *   i2c-rw[,bus=PATH,addr=ADDR]      ioctl(I2C_SLAVE)之后直接read()/write()
+ *   sim[,latency=MS,noise=SIGMA,fail=P,crc=P,seed=N]
+ *                                    模拟的SHT20，在没有传感器的主机上运行和压测客户端
+ */
+
+#ifndef __SENSOR_H__
+#define __SENSOR_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define SENSOR_DEFAULT      "i2c-rdwr"      // 默认后端
+#define SENSOR_I2C_BUS      "/dev/i2c-1"    // 默认i2c总线
+
+typedef struct sensor_s sensor_t;
+
+/***
+ * @name: sensor_ops_t
+ * @description: 后端实现，read/write失败时返回-1并设置errno，器件未应答(NACK)为ENXIO
+ */
+typedef struct sensor_ops_s
+{
+    const char     *name;                                               // 配置字符串中的后端名
+    int           (*init)(sensor_t *sensor);                            // 分配私有数据并设置默认值，可为NULL
+    int           (*option)(sensor_t *sensor, const char *key, const char *value);  // 解析后端选项，可为NULL
+    int           (*open)(sensor_t *sensor);                            // 选项解析完后打开器件
+    int           (*write)(sensor_t *sensor, const uint8_t *buf, int len);
+    int           (*read)(sensor_t *sensor, uint8_t *buf, int len);
+    int           (*transfer)(sensor_t *sensor, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen);  // 写后重复起始读，可为NULL
+    void          (*close)(sensor_t *sensor);
+} sensor_ops_t;
+
+/***
+ * @name: sensor_t
+ * @description: 打开的传感器
+ */
+struct sensor_s
+{
+    const sensor_ops_t *ops;            // 后端
+    char            bus[64];            // i2c总线设备
+    uint16_t        addr;               // 器件地址
+    int             fd;                 // 总线描述符
+    void           *priv;               // 后端私有数据
+};
+
+extern const sensor_ops_t sensor_sim_ops;
+
+int sensor_open(sensor_t *sensor, const char *spec, uint16_t addr);
+
+int sensor_write(sensor_t *sensor, const uint8_t *buf, int len);
+
+int sensor_read(sensor_t *sensor, uint8_t *buf, int len);
+
+int sensor_transfer(sensor_t *sensor, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen);
+
+void sensor_close(sensor_t *sensor);
+
+#endif
@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-04 17:37:02
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-10 16:50:09
+ * @LastEditTime: 2026-10-17 21:12:34
  * @Description: socket client 端代码
  */
 
@@ -23,16 +23,77 @@
 
 // #include <linux/tcp.h>
 #include <netinet/tcp.h>
+#include <poll.h>
+#include <math.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
 #include "iot_main.h"
+#include "proto.h"
 #include "packinfo.h"
 #include "logger.h"
 
+#define SEND_BATCH_MAX      PROTO_BATCH_MAX         // sendata_batch()一次最多发送的行数
+#define SEND_LINE_LEN       160                     // 一条文本帧的最大长度，两个%f最长各47字节
+#define CONNECT_TIMEOUT     3000                    // 非阻塞connect等待完成的超时(ms)
+#define CONNECT_BACKOFF_BASE 1000                   // 第一次重连的退避上限(ms)
+#define CONNECT_BACKOFF_CAP 60000                   // 默认的退避上限(ms)
+#define CONNECT_STABLE_MS   10000                   // 连接保持这么久后断开才重置退避(ms)
 
+/***
+ * @name: CONNECT_STATE
+ * @description: 非阻塞连接状态
+ */
+enum CONNECT_STATE
+{
+    CONNECT_IDLE = 0,                               // 未连接，等待退避到期
+    CONNECT_PENDING,                                // connect进行中，等待socket可写
+    CONNECT_HELLO,                                  // 已发送握手行，等待服务器应答
+    CONNECT_READY                                   // 已连接并选定协议版本
+};
+
+/***
+ * @name: socket_connect_t
+ * @description: 由主循环epoll驱动的非阻塞连接状态机
+ */
+typedef struct socket_connect_s
+{
+    int                 state;                      // enum CONNECT_STATE
+    int                 fd;                         // socket描述符，未连接时为-1
+    int                 epfd;                       // 主循环的epoll句柄
+    struct sockaddr_in  servaddr;                   // 服务器地址
+    int                 attempts;                   // 连续失败次数
+    int                 cap_ms;                     // 退避上限(ms)
+    long long           deadline_ms;                // 下一次连接的时间或当前步骤的超时，单调时钟(ms)
+    long long           ready_ms;                   // 连接完成的时间，单调时钟(ms)
+    unsigned int        seed;                       // 退避抖动的随机种子
+    char                line[32];                   // 握手应答
+    int                 len;                        // 已读取的握手应答长度
+    uint32_t            events;                     // epoll中关注的事件，0为不在epoll中
+} socket_connect_t;
+
+extern int proto_version;                           // 握手选定的协议版本，0为文本协议
+
+int socket_connect_init(socket_connect_t *sc, int epfd, char *serv_ip, int port, int cap_ms);
+
+int socket_connect_poll(socket_connect_t *sc, uint32_t events);
 
-int socket_client_init(char *serv_ip, int port);
+int socket_connect_timeout(socket_connect_t *sc);
+
+void socket_connect_close(socket_connect_t *sc);
 
 int sendata(int sockfd, packinfo_t pack_info);
 
+int sendata_batch(int sockfd, packinfo_t *pack_info, int count, uint32_t seq);
+
+int sendata_flush(int sockfd);
+
+int sendata_pending(int timeout_ms);
+
+int socket_connect_want_write(socket_connect_t *sc, int on);
+
+int socket_client_recv_ack(int sockfd, int timeout_ms, uint32_t *seq);
+
 int get_sock_status(int sockfd);
 
 #endif
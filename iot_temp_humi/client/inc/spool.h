@@ -0,0 +1,64 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:08:01
+ * @Description: 溢出缓存，内存环形缓冲区放不下的采样按队列存放，启动时选择SQLite或内存映射文件
+ */
+
+#ifndef __SPOOL_H__
+#define __SPOOL_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "database.h"
+#include "mmap_spool.h"
+
+#define SPOOL_DEFAULT       "sqlite"    // 默认缓存后端
+
+/***
+ * @name: SPOOL_TYPE
+ * @description: 缓存后端
+ */
+enum SPOOL_TYPE
+{
+    SPOOL_SQLITE = 0,                   // SQLite表，database_*()
+    SPOOL_MMAP                          // 内存映射的定长记录文件，mmap_spool_*()
+};
+
+/***
+ * @name: spool_t
+ * @description: 打开的溢出缓存
+ */
+typedef struct spool_s
+{
+    int             type;               // enum SPOOL_TYPE
+    char           *name;               // 数据库名或缓存文件名(不含扩展名)
+    char           *table;              // SQLite表名
+    sqlite3        *db;                 // 数据库句柄
+    db_batch_t      batch;              // 批量插入句柄
+    int64_t         head_rowid;         // 队首的rowid
+    int64_t         last_rowid;         // spool_read()读出的最后一行的rowid
+    mmap_spool_t    mm;                 // 内存映射文件
+    int             count;              // 缓存中的采样数，打开时统计一次，之后随追加和删除更新
+    int             last_count;         // spool_read()读出的条数
+} spool_t;
+
+int spool_open(spool_t *sp, const char *type, char *name, char *table, const db_profile_t *profile, int max_rows, int max_ms);
+
+int spool_append(spool_t *sp, packinfo_t *pack_info);
+
+int spool_poll(spool_t *sp);
+
+int spool_count(spool_t *sp);
+
+int spool_read(spool_t *sp, packinfo_t *pack_info, int max_rows);
+
+int spool_consume(spool_t *sp);
+
+void spool_close(spool_t *sp);
+
+#endif
@@ -2,20 +2,149 @@
  * @Author: RoxyKko
  * @Date: 2023-04-05 20:54:52
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-10 23:57:16
+ * @LastEditTime: 2026-10-17 21:04:02
  * @Description: 数据库sqlite的使用
  */
 
 #include "database.h"
 
+/*** 
+ * @description: 存储配置预设
+ *   durable    WAL + synchronous=FULL，每次提交都落盘，掉电不丢已提交的数据
+ *   throughput WAL + synchronous=NORMAL，只在检查点时fsync，掉电可能丢最后几个事务，但数据库不会损坏
+ */
+static const db_profile_t db_profile_presets[] =
+{
+    { "durable",    "WAL", "FULL",   0,                4096, -2000, 1000 },
+    { "throughput", "WAL", "NORMAL", 64 * 1024 * 1024, 4096, -8192, 4000 },
+};
+
 /**
- * @name: database_init(char *dbname)
+ * @name: int database_profile_parse(const char *str, db_profile_t *profile)
+ * @description: 解析存储配置字符串，格式为 预设名[,键=值...]，如 "throughput,mmap_size=0,synchronous=FULL"
+ *               可用的键: journal_mode synchronous mmap_size page_size cache_size wal_autocheckpoint
+ * @param {char} *str 配置字符串
+ * @param {db_profile_t} *profile 解析结果
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_profile_parse(const char *str, db_profile_t *profile)
+{
+    char    buf[256];
+    char   *token;
+    char   *saveptr = NULL;
+    char   *value;
+    int     i;
+
+    if ((str == NULL) || (profile == NULL) || (strlen(str) >= sizeof(buf)))
+    {
+        log_error("The database_profile_parse() argument incorrect!\n");
+        return -1;
+    }
+
+    strcpy(buf, str);
+    token = strtok_r(buf, ",", &saveptr);
+    for (i = 0; i < sizeof(db_profile_presets) / sizeof(db_profile_presets[0]); i++)
+    {
+        if (token && !strcasecmp(token, db_profile_presets[i].name))
+        {
+            *profile = db_profile_presets[i];
+            break;
+        }
+    }
+    if (i == sizeof(db_profile_presets) / sizeof(db_profile_presets[0]))
+    {
+        log_error("Unknown storage profile: %s\n", token ? token : "");
+        return -2;
+    }
+
+    while ((token = strtok_r(NULL, ",", &saveptr)) != NULL)
+    {
+        if ((value = strchr(token, '=')) == NULL)
+        {
+            log_error("Storage profile option '%s' is not key=value\n", token);
+            return -3;
+        }
+        *value++ = '\0';
+
+        if (!strcasecmp(token, "journal_mode"))
+        {
+            snprintf(profile->journal_mode, sizeof(profile->journal_mode), "%s", value);
+        }
+        else if (!strcasecmp(token, "synchronous"))
+        {
+            snprintf(profile->synchronous, sizeof(profile->synchronous), "%s", value);
+        }
+        else if (!strcasecmp(token, "mmap_size"))
+        {
+            profile->mmap_size = atoll(value);
+        }
+        else if (!strcasecmp(token, "page_size"))
+        {
+            profile->page_size = atoi(value);
+        }
+        else if (!strcasecmp(token, "cache_size"))
+        {
+            profile->cache_size = atoi(value);
+        }
+        else if (!strcasecmp(token, "wal_autocheckpoint"))
+        {
+            profile->wal_autocheckpoint = atoi(value);
+        }
+        else
+        {
+            log_error("Unknown storage profile option: %s\n", token);
+            return -4;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static int database_apply_profile(sqlite3 *db, const db_profile_t *profile)
+ * @description: 打开数据库后一次性设置存储相关的PRAGMA
+ *               page_size只对新建的数据库文件生效，必须在切换journal_mode之前设置
+ * @param {sqlite3} *db 数据库句柄
+ * @param {db_profile_t} *profile 存储配置
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int database_apply_profile(sqlite3 *db, const db_profile_t *profile)
+{
+    char    sql[512]    = {0};
+    char   *zErrMsg     = 0;
+
+    snprintf(sql, sizeof(sql),
+             "PRAGMA page_size=%d;"
+             "PRAGMA journal_mode=%s;"
+             "PRAGMA synchronous=%s;"
+             "PRAGMA mmap_size=%lld;"
+             "PRAGMA cache_size=%d;"
+             "PRAGMA wal_autocheckpoint=%d;",
+             profile->page_size, profile->journal_mode, profile->synchronous,
+             profile->mmap_size, profile->cache_size, profile->wal_autocheckpoint);
+
+    if (sqlite3_exec(db, sql, 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("Sqlite apply storage profile error:%s\n", zErrMsg);
+        sqlite3_free(zErrMsg);
+        return -1;
+    }
+
+    log_info("Storage profile %s: journal_mode=%s synchronous=%s mmap_size=%lld page_size=%d cache_size=%d wal_autocheckpoint=%d\n",
+             profile->name, profile->journal_mode, profile->synchronous, profile->mmap_size,
+             profile->page_size, profile->cache_size, profile->wal_autocheckpoint);
+    return 0;
+}
+
+/**
+ * @name: database_init(char *dbname, sqlite3 **db, const db_profile_t *profile)
  * @description: 数据库sqlite初始化
  * @param {char} *dbname database文件名
  * @param {sqlite3} *db 数据库指针
+ * @param {db_profile_t} *profile 存储配置，为NULL时使用sqlite默认配置
  * @return {int} 0为正常执行，非0则出现错误
  */
-int database_init(char *dbname, sqlite3 **db)
+int database_init(char *dbname, sqlite3 **db, const db_profile_t *profile)
 {
     
     int     rv          = -1;
@@ -35,11 +164,16 @@ int database_init(char *dbname, sqlite3 **db)
         log_error("Can't open database: %s\n", sqlite3_errmsg(*db));
         return -2;
     }
-    else
+
+    // WAL模式下读者不会阻塞写入
+    if (profile && database_apply_profile(*db, profile) < 0)
     {
-        log_info("Opened database successfully!\n");
-        return 0;
+        sqlite3_close(*db);
+        return -3;
     }
+
+    log_info("Opened database successfully!\n");
+    return 0;
 }
 
 /**
@@ -90,7 +224,7 @@ int database_close(char *dbname, sqlite3 **db)
  */
 int database_create_table(char *dbname, sqlite3 **db)
 {
-    char    sql[128]    = {0};
+    char    sql[256]    = {0};
     int     rv          = -1;
     char   *zErrMsg     = 0;
 
@@ -101,7 +235,7 @@ int database_create_table(char *dbname, sqlite3 **db)
     }
 
     memset(sql, 0, sizeof(sql));
-    sprintf(sql, "CREATE TABLE if not exists %s(SN CHAR(10),DATIME CHAR(50),TEMP CHAR(15), HUMI CHAR(15));",
+    sprintf(sql, "CREATE TABLE if not exists %s(SN CHAR(10),DATIME CHAR(50),TEMP CHAR(15), HUMI CHAR(15), TS INTEGER);",
             dbname);
 
     rv = sqlite3_exec(*db, sql, 0, 0, &zErrMsg);
@@ -112,6 +246,20 @@ int database_create_table(char *dbname, sqlite3 **db)
         return -2;
     }
 
+    // 旧版本建的表没有TS列，补上后旧行的TS为NULL，读出时按DATIME换算
+    sprintf(sql, "SELECT TS FROM %s LIMIT 0;", dbname);
+    if (sqlite3_exec(*db, sql, 0, 0, NULL) != SQLITE_OK)
+    {
+        sprintf(sql, "ALTER TABLE %s ADD COLUMN TS INTEGER;", dbname);
+        if (sqlite3_exec(*db, sql, 0, 0, &zErrMsg) != SQLITE_OK)
+        {
+            log_error("Sqlite_create_table add column error:%s\n", zErrMsg);
+            sqlite3_free(zErrMsg);
+            return -3;
+        }
+        log_info("database_create_table: added TS column to %s\n", dbname);
+    }
+
     log_info("database_create_table: %s.db created!\n", dbname);
     return 0;
 }
@@ -137,8 +285,8 @@ int database_insert_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
     }
 
     memset(sql, 0, sizeof(sql));
-    sprintf(sql, "INSERT INTO %s VALUES ('%s', '%s', '%f', '%f');",
-            dbname, pack_info->devid, pack_info->time, pack_info->temp, pack_info->humi);
+    sprintf(sql, "INSERT INTO %s(SN, DATIME, TEMP, HUMI, TS) VALUES ('%s', '%s', '%f', '%f', %lld);",
+            dbname, pack_info->devid, pack_info->time, pack_info->temp, pack_info->humi, (long long)pack_info->ts);
     log_debug("data insert sql: %s\n", sql);
 
     rv = sqlite3_exec(*db, sql, 0, 0, &zErrMsg);
@@ -154,21 +302,38 @@ int database_insert_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
     return 0;
 }
 
+/**
+ * @name: static int64_t database_column_ts(sqlite3_stmt *stmt, int col, const char *datime)
+ * @description: 读出采样时间，旧版本写入的行没有TS，按秒精度的DATIME换算
+ * @param {sqlite3_stmt} *stmt 查询语句
+ * @param {int} col TS列的下标
+ * @param {char} *datime 同一行的DATIME
+ * @return {int64_t} epoch毫秒
+ */
+static int64_t database_column_ts(sqlite3_stmt *stmt, int col, const char *datime)
+{
+    if (sqlite3_column_type(stmt, col) == SQLITE_NULL)
+    {
+        return get_time_parse(datime);
+    }
+
+    return sqlite3_column_int64(stmt, col);
+}
+
 /**
  * @name: database_select_data(char *dbname, sqlite3 *db, packinfo_t pack_info)
- * @description: 选择数据库文件并返回第一条数据到pack_info
+ * @description: 选择数据库文件并返回第一条数据到pack_info，逐行step预编译语句，不分配结果表
  * @param {char} *dbname database文件名
  * @param {sqlite3} *db 数据库指针
  * @param {packinfo_t} pack_info 数据结构体
- * @return {int} 返回剩余行数，负数则出现错误
+ * @return {int} 1为取到数据，0为表中没有数据，负数则出现错误
  */
 int database_select_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
 {
-    char    sql[128]    = {0};
-    int     rv          = -1;
-    char   *zErrMsg     = 0;  
-    char  **dbResult;                   // 二维数组，存放结果
-    int     nRow=0, nColumn=0;          // 行数和列数
+    char            sql[128]    = {0};
+    sqlite3_stmt   *stmt        = NULL;
+    const char     *text;
+    int             rv          = -1;
 
     if((dbname == NULL) || (db == NULL) || (pack_info == NULL))
     {
@@ -176,27 +341,39 @@ int database_select_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
         return -1;
     }
 
-    memset(sql, 0, sizeof(sql));
-    sprintf(sql, "SELECT * FROM %s LIMIT 1;", dbname);          // 选择第一条数据
-
-    rv = sqlite3_get_table(*db, sql, &dbResult, &nRow, &nColumn, &zErrMsg);
-    if (rv != SQLITE_OK)
+    snprintf(sql, sizeof(sql), "SELECT SN, DATIME, TEMP, HUMI, TS FROM %s ORDER BY rowid LIMIT 1;", dbname);  // 选择第一条数据
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
     {
-        log_error("Sqlite_select_data error:%s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
+        log_error("Sqlite_select_data error:%s\n", sqlite3_errmsg(*db));
         return -2;
     }
 
     memset(pack_info, 0, sizeof(packinfo_t));
-    // 0-3 四个存第一行的标签，4-7四个存第二行的数据
-    strcpy(pack_info->devid, dbResult[4]);
-    strcpy(pack_info->time, dbResult[5]);
-    pack_info->temp = atof(dbResult[6]);
-    pack_info->humi = atof(dbResult[7]);
-    log_info("Last data select table successfully: %s, %s, %f, %f\n",
-             pack_info->devid, pack_info->time, pack_info->temp, pack_info->humi);
+    if ((rv = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if ((text = (const char *)sqlite3_column_text(stmt, 0)) != NULL)
+        {
+            snprintf(pack_info->devid, sizeof(pack_info->devid), "%s", text);
+        }
+        if ((text = (const char *)sqlite3_column_text(stmt, 1)) != NULL)
+        {
+            snprintf(pack_info->time, sizeof(pack_info->time), "%s", text);
+        }
+        pack_info->temp = sqlite3_column_double(stmt, 2);
+        pack_info->humi = sqlite3_column_double(stmt, 3);
+        pack_info->ts   = database_column_ts(stmt, 4, pack_info->time);
+        log_info("Last data select table successfully: %s, %s, %f, %f\n",
+                 pack_info->devid, pack_info->time, pack_info->temp, pack_info->humi);
+    }
+    sqlite3_finalize(stmt);
 
-    return nRow;
+    if ((rv != SQLITE_ROW) && (rv != SQLITE_DONE))
+    {
+        log_error("Sqlite_select_data error:%s\n", sqlite3_errmsg(*db));
+        return -3;
+    }
+
+    return rv == SQLITE_ROW;
 }
 
 /**
@@ -234,13 +411,110 @@ int database_delete_data(char *dbname, sqlite3 **db)
     return 0;
 }
 
+/**
+ * @name: int database_select_batch(char *dbname, sqlite3 **db, int64_t after_rowid, packinfo_t *pack_info, int max_rows, int64_t *last_rowid)
+ * @description: 按rowid顺序一次取出after_rowid之后最早的max_rows条数据
+ * @param {char} *dbname 表名
+ * @param {sqlite3} **db 数据库指针
+ * @param {int64_t} after_rowid 只取rowid大于该值的行，跳过已发送未确认的行
+ * @param {packinfo_t} *pack_info 数据结构体数组，至少max_rows个元素
+ * @param {int} max_rows 最多取出的行数
+ * @param {int64_t} *last_rowid 取出的最后一行的rowid，交给database_delete_upto()删除
+ * @return {int} 取出的行数，负数则出现错误
+ */
+int database_select_batch(char *dbname, sqlite3 **db, int64_t after_rowid, packinfo_t *pack_info, int max_rows, int64_t *last_rowid)
+{
+    char            sql[256]    = {0};
+    sqlite3_stmt   *stmt        = NULL;
+    const char     *text;
+    int             rv          = -1;
+    int             n           = 0;
+
+    if ((dbname == NULL) || (db == NULL) || (pack_info == NULL) || (max_rows < 1) || (last_rowid == NULL))
+    {
+        log_error("The database_select_batch() argument incorrect!\n");
+        return -1;
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, SN, DATIME, TEMP, HUMI, TS FROM %s WHERE rowid > %lld ORDER BY rowid LIMIT %d;",
+             dbname, (long long)after_rowid, max_rows);
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("database_select_batch prepare error:%s\n", sqlite3_errmsg(*db));
+        return -2;
+    }
+
+    while ((rv = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        memset(&pack_info[n], 0, sizeof(packinfo_t));
+        *last_rowid = sqlite3_column_int64(stmt, 0);
+        if ((text = (const char *)sqlite3_column_text(stmt, 1)) != NULL)
+        {
+            snprintf(pack_info[n].devid, sizeof(pack_info[n].devid), "%s", text);
+        }
+        if ((text = (const char *)sqlite3_column_text(stmt, 2)) != NULL)
+        {
+            snprintf(pack_info[n].time, sizeof(pack_info[n].time), "%s", text);
+        }
+        pack_info[n].temp = sqlite3_column_double(stmt, 3);
+        pack_info[n].humi = sqlite3_column_double(stmt, 4);
+        pack_info[n].ts   = database_column_ts(stmt, 5, pack_info[n].time);
+        n++;
+    }
+    sqlite3_finalize(stmt);
+
+    if (rv != SQLITE_DONE)
+    {
+        log_error("database_select_batch step error:%s\n", sqlite3_errmsg(*db));
+        return -3;
+    }
+
+    log_debug("database_select_batch: %d rows, last rowid %lld\n", n, (long long)*last_rowid);
+    return n;
+}
+
+/**
+ * @name: int database_delete_upto(char *dbname, sqlite3 **db, int64_t last_rowid)
+ * @description: 用一条DELETE语句删除rowid不大于last_rowid的所有数据，在一个事务中完成
+ * @param {char} *dbname 表名
+ * @param {sqlite3} **db 数据库指针
+ * @param {int64_t} last_rowid 已发送的最后一行的rowid
+ * @return {int} 删除的行数，负数则出现错误
+ */
+int database_delete_upto(char *dbname, sqlite3 **db, int64_t last_rowid)
+{
+    char    sql[128]    = {0};
+    char   *zErrMsg     = 0;
+
+    if ((dbname == NULL) || (db == NULL))
+    {
+        log_error("The database_delete_upto() argument incorrect!\n");
+        return -1;
+    }
+
+    snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE rowid <= %lld;", dbname, (long long)last_rowid);
+    if (sqlite3_exec(*db, sql, 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("database_delete_upto error:%s\n", zErrMsg);
+        sqlite3_free(zErrMsg);
+        return -2;
+    }
+
+    return sqlite3_changes(*db);
+}
+
+/**
+ * @name: int database_check_data(char *dbname, sqlite3 **db)
+ * @description: 检查表中是否有数据，只step一次预编译语句，不分配结果表
+ * @param {char} *dbname 表名
+ * @param {sqlite3} **db 数据库指针
+ * @return {int} 1为有数据，0为没有数据，负数则出现错误
+ */
 int database_check_data(char *dbname, sqlite3 **db)
 {
-    char    sql[128];
-    int     rv;
-    char   *zErrMsg = 0;
-    char  **dbResult;
-    int     nRow=0, nColumn=0;
+    char            sql[128];
+    sqlite3_stmt   *stmt        = NULL;
+    int             rv;
 
     if((dbname == NULL) || (db == NULL))
     {
@@ -248,16 +522,248 @@ int database_check_data(char *dbname, sqlite3 **db)
         return -1;
     }
 
-    memset(sql, 0, sizeof(sql));
-    sprintf(sql, "SELECT * FROM %s LIMIT 1;", dbname);          // 选择第一条数据
+    snprintf(sql, sizeof(sql), "SELECT 1 FROM %s LIMIT 1;", dbname);
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Sqlite_check_data error:%s\n", sqlite3_errmsg(*db));
+        return -2;
+    }
+
+    rv = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if ((rv != SQLITE_ROW) && (rv != SQLITE_DONE))
+    {
+        log_error("Sqlite_check_data error:%s\n", sqlite3_errmsg(*db));
+        return -3;
+    }
+
+    return rv == SQLITE_ROW;
+}
 
-    rv = sqlite3_get_table(*db, sql, &dbResult, &nRow, &nColumn, &zErrMsg);
+/**
+ * @name: int database_rowid_range(char *dbname, sqlite3 **db, int64_t *min_rowid, int64_t *max_rowid)
+ * @description: 获取表中最小和最大的rowid，MIN/MAX(rowid)直接定位B树两端，不扫描表
+ * @param {char} *dbname 表名
+ * @param {sqlite3} **db 数据库指针
+ * @param {int64_t} *min_rowid 最小的rowid，空表为0
+ * @param {int64_t} *max_rowid 最大的rowid，空表为0
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_rowid_range(char *dbname, sqlite3 **db, int64_t *min_rowid, int64_t *max_rowid)
+{
+    char            sql[128];
+    sqlite3_stmt   *stmt        = NULL;
+    int             rv;
+
+    if ((dbname == NULL) || (db == NULL) || (min_rowid == NULL) || (max_rowid == NULL))
+    {
+        log_error("The database_rowid_range() argument incorrect!\n");
+        return -1;
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT MIN(rowid), MAX(rowid) FROM %s;", dbname);
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("database_rowid_range prepare error:%s\n", sqlite3_errmsg(*db));
+        return -2;
+    }
+
+    if ((rv = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        *min_rowid = sqlite3_column_int64(stmt, 0);
+        *max_rowid = sqlite3_column_int64(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    if (rv != SQLITE_ROW)
+    {
+        log_error("database_rowid_range error:%s\n", sqlite3_errmsg(*db));
+        return -3;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static long long database_now_ms(void)
+ * @description: 获取单调时钟毫秒数，用于计算事务持续时间
+ * @return {long long} 毫秒数
+ */
+static long long database_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: int database_batch_init(char *dbname, sqlite3 **db, db_batch_t *batch, int max_rows, int max_ms)
+ * @description: 初始化批量插入，预编译并缓存INSERT语句
+ * @param {char} *dbname 表名
+ * @param {sqlite3} **db 数据库指针
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @param {int} max_rows 每个事务最多插入的行数，达到后立即提交
+ * @param {int} max_ms 事务最长持续时间(ms)，超过后提交
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_init(char *dbname, sqlite3 **db, db_batch_t *batch, int max_rows, int max_ms)
+{
+    char    sql[128]    = {0};
+    int     rv          = -1;
+
+    if ((dbname == NULL) || (db == NULL) || (batch == NULL) || (max_rows < 1) || (max_ms < 0))
+    {
+        log_error("The database_batch_init() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(batch, 0, sizeof(db_batch_t));
+    batch->db       = *db;
+    batch->max_rows = max_rows;
+    batch->max_ms   = max_ms;
+
+    snprintf(sql, sizeof(sql), "INSERT INTO %s(SN, DATIME, TEMP, HUMI, TS) VALUES (?, ?, ?, ?, ?);", dbname);
+    rv = sqlite3_prepare_v2(batch->db, sql, -1, &batch->stmt, NULL);
     if (rv != SQLITE_OK)
     {
-        log_error("Sqlite_check_data error:%s\n", zErrMsg);
+        log_error("database_batch_init prepare error:%s\n", sqlite3_errmsg(batch->db));
+        return -2;
+    }
+
+    log_info("database_batch_init: %s commit every %d rows or %d ms\n", dbname, max_rows, max_ms);
+    return 0;
+}
+
+/**
+ * @name: int database_batch_commit(db_batch_t *batch)
+ * @description: 提交当前事务，没有未提交的行时直接返回
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_commit(db_batch_t *batch)
+{
+    char   *zErrMsg     = 0;
+
+    if ((batch == NULL) || (batch->pending == 0))
+    {
+        return 0;
+    }
+
+    if (sqlite3_exec(batch->db, "COMMIT;", 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("database_batch_commit error:%s\n", zErrMsg);
         sqlite3_free(zErrMsg);
+        sqlite3_exec(batch->db, "ROLLBACK;", 0, 0, 0);
+        batch->pending = 0;
         return -2;
     }
 
-    return nRow;
-}
\ No newline at end of file
+    log_debug("database_batch_commit: %d rows committed\n", batch->pending);
+    batch->rows    += batch->pending;
+    batch->commits++;
+    batch->pending  = 0;
+    return 0;
+}
+
+/**
+ * @name: int database_batch_insert(db_batch_t *batch, packinfo_t *pack_info)
+ * @description: 绑定参数插入一行，必要时开启新事务，满max_rows行或超过max_ms时提交
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_insert(db_batch_t *batch, packinfo_t *pack_info)
+{
+    char   *zErrMsg     = 0;
+    int     rv          = -1;
+
+    if ((batch == NULL) || (batch->stmt == NULL) || (pack_info == NULL))
+    {
+        log_error("The database_batch_insert() argument incorrect!\n");
+        return -1;
+    }
+
+    if (batch->pending == 0)
+    {
+        if (sqlite3_exec(batch->db, "BEGIN;", 0, 0, &zErrMsg) != SQLITE_OK)
+        {
+            log_error("database_batch_insert begin error:%s\n", zErrMsg);
+            sqlite3_free(zErrMsg);
+            return -2;
+        }
+        batch->begin_ms = database_now_ms();
+    }
+
+    sqlite3_bind_text(batch->stmt, 1, pack_info->devid, -1, SQLITE_STATIC);
+    sqlite3_bind_text(batch->stmt, 2, pack_info->time, -1, SQLITE_STATIC);
+    sqlite3_bind_double(batch->stmt, 3, pack_info->temp);
+    sqlite3_bind_double(batch->stmt, 4, pack_info->humi);
+    sqlite3_bind_int64(batch->stmt, 5, pack_info->ts);
+
+    rv = sqlite3_step(batch->stmt);
+    sqlite3_reset(batch->stmt);
+    sqlite3_clear_bindings(batch->stmt);
+    if (rv != SQLITE_DONE)
+    {
+        log_error("database_batch_insert step error:%s\n", sqlite3_errmsg(batch->db));
+        if (batch->pending == 0)
+        {
+            sqlite3_exec(batch->db, "ROLLBACK;", 0, 0, 0);
+        }
+        return -3;
+    }
+    batch->pending++;
+
+    if ((batch->pending >= batch->max_rows) || (database_now_ms() - batch->begin_ms >= batch->max_ms))
+    {
+        return database_batch_commit(batch);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int database_batch_poll(db_batch_t *batch)
+ * @description: 事务持续时间超过max_ms时提交
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @return {int} 距下一次提交的毫秒数，没有未提交的行时返回-1，提交失败返回-2
+ */
+int database_batch_poll(db_batch_t *batch)
+{
+    long long   elapsed;
+
+    if ((batch == NULL) || (batch->pending == 0))
+    {
+        return -1;
+    }
+
+    elapsed = database_now_ms() - batch->begin_ms;
+    if (elapsed < batch->max_ms)
+    {
+        return (int)(batch->max_ms - elapsed);
+    }
+
+    return database_batch_commit(batch) < 0 ? -2 : -1;
+}
+
+/**
+ * @name: int database_batch_close(db_batch_t *batch)
+ * @description: 提交剩余的行并释放缓存的语句
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_close(db_batch_t *batch)
+{
+    int     rv;
+
+    if (batch == NULL)
+    {
+        return -1;
+    }
+
+    rv = database_batch_commit(batch);
+    sqlite3_finalize(batch->stmt);
+    batch->stmt = NULL;
+
+    return rv;
+}
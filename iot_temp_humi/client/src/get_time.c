@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-04 17:04:15
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-04 17:26:45
+ * @LastEditTime: 2026-10-17 21:04:02
  * @Description: 获取时间
  */
 
@@ -13,15 +13,16 @@
 double get_time(char *datime)
 {
     struct          timeval       tv;
-    struct          tm           *st;
-    static double   last_time  =  0;
+    struct          tm            tm_now;
+    struct          tm           *st = &tm_now;
+    double          last_time  =  0;
 
     // 获取时间
     gettimeofday(&tv, NULL);
     // 报错获取的秒数
     last_time = tv.tv_sec;
-    // 将获取到的秒数转换为本地时间
-    st        = localtime(&tv.tv_sec);
+    // 将获取到的秒数转换为本地时间，各总线的采样线程并发调用，使用可重入的localtime_r
+    localtime_r(&tv.tv_sec, st);
 
     if( datime != NULL )
     {
@@ -32,4 +33,56 @@ double get_time(char *datime)
     // 返回时间
     return last_time;
 
-}
\ No newline at end of file
+}
+
+/**
+ * @name: int64_t get_time_ms(char *datime)
+ * @description: 获取epoch毫秒，同时把同一时刻按get_time()的格式写入datime
+ *               datime只精确到秒，供显示和文本协议使用，采样时间以返回值为准
+ * @param {char} *datime 时间字符串，至少20字节，NULL为不需要
+ * @return {int64_t} epoch毫秒
+ */
+int64_t get_time_ms(char *datime)
+{
+    struct timespec ts;
+    struct tm       tm_now;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    if (datime != NULL)
+    {
+        localtime_r(&ts.tv_sec, &tm_now);
+        sprintf(datime, dateFormat, tm_now.tm_year + 1900, tm_now.tm_mon + 1, tm_now.tm_mday,
+                tm_now.tm_hour, tm_now.tm_min, tm_now.tm_sec);
+    }
+
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: int64_t get_time_parse(const char *datime)
+ * @description: 把get_time()输出的本地时间字符串转换为epoch毫秒
+ * @param {char} *datime 时间字符串
+ * @return {int64_t} epoch毫秒，负数则格式错误
+ */
+int64_t get_time_parse(const char *datime)
+{
+    struct tm   tm;
+    time_t      sec;
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(datime, dateFormat, &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+    {
+        return -1;
+    }
+
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    tm.tm_isdst = -1;
+    if ((sec = mktime(&tm)) == (time_t)-1)
+    {
+        return -2;
+    }
+
+    return (int64_t)sec * 1000;
+}
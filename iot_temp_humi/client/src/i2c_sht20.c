@@ -2,11 +2,52 @@
  * @Author: RoxyKko
  * @Date: 2023-03-24 18:50:49
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-04 17:35:27
- * @Description: sht20驱动
+ * @LastEditTime: 2026-10-17 21:04:02
+ * @Description: sht20驱动，命令和换算公式与总线后端无关
  */
 #include <i2c_sht20.h>
 
+/***
+ * @name: sht2x_timing
+ * @description: 数据手册各分辨率的最长转换时间(ms)，按enum SHT2X_RESOLUTION排列
+ */
+static const struct
+{
+    const char     *name;                           // 温度位数/湿度位数
+    int             temp_delay;                     // 温度转换最长时间
+    int             humi_delay;                     // 湿度转换最长时间
+} sht2x_timing[] =
+{
+    {"14/12", 85, 29},                              // typ 66/22
+    {"12/8",  22,  4},                              // typ 17/3
+    {"13/10", 43,  9},                              // typ 33/7
+    {"11/11", 11, 15},                              // typ 9/12
+};
+
+/***
+ * @name: sht2x_crc_table
+ * @description: CRC-8查找表，多项式x^8+x^5+x^4+1(0x31)，sht2x_crc_table[i]为字节i的余数
+ */
+static const uint8_t sht2x_crc_table[256] =
+{
+    0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+    0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+    0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+    0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+    0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+    0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+    0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+    0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+    0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+    0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+    0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+    0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+    0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+    0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+    0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+    0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC,
+};
+
 /**
  * @name: static inline void msleep(unsigned long ms)
  * @description: 休眠函数
@@ -64,182 +105,500 @@ static inline void dump_buf(const char *prompt, uint8_t *buf, int size)
 }
 
 /**
- * @name: int sht2x_init(void)
- * @description: 初始化sht20
- * @return fd 返回文件描述符
+ * @name: int sht2x_init(sensor_t *sensor, const char *spec)
+ * @description: 按配置打开传感器后端并软复位sht20
+ * @param {sensor_t} *sensor 传感器
+ * @param {char} *spec 后端配置，见sensor.h
+ * @return {int} 0为正常执行，-1为配置错误，其他负数为初始化失败
  */
-int sht2x_init(void)
+int sht2x_init(sensor_t *sensor, const char *spec)
 {
-    int fd;
+    int rv;
 
-    if ((fd = open("/dev/i2c-1", O_RDWR)) < 0)
+    if ((rv = sensor_open(sensor, spec, SHT20_ADDR)) < 0)
     {
-        printf("i2c device open failed: %s\n", strerror(errno));
-        return -1;
+        printf("sensor %s open failed\n", spec);
+        return rv;
     }
 
-    if (sht2x_softReset(fd) < 0)
+    if (sht2x_softReset(sensor) < 0)
     {
         printf("sht2x softReset failed!\n");
-        return -2;
+        sensor_close(sensor);
+        return -4;
     }
 
-    return fd;
+    return 0;
 }
 
 /**
- * @name: int sht2x_softReset(int fd)
+ * @name: int sht2x_softReset(sensor_t *sensor)
  * @description: sht20软件复位
- * @param {int} fd
+ * @param {sensor_t} *sensor 传感器
  * @return {*}
  */
-int sht2x_softReset(int fd)
+int sht2x_softReset(sensor_t *sensor)
 {
-    struct i2c_msg msg;
-    struct i2c_rdwr_ioctl_data sht2x_data;
-    uint8_t buf[2];
+    uint8_t buf[1] = {CMD_SOFT_RESET};
 
-    if (fd < 0)
+    if (!sensor || !sensor->ops)
     {
         printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
         return -1;
     }
 
-    msg.addr = 0x40;
-    msg.flags = 0; // write
-    msg.len = 1;
-    msg.buf = buf;
-    msg.buf[0] = CMD_SOFT_RESET;
+    if (sensor_write(sensor, buf, 1) < 0)
+    {
+        printf("%s() write failure: %s\n", __func__, strerror(errno));
+        return -2;
+    }
+
+    msleep(SHT20_RESET_DELAY);
+    return 0;
+}
+
+/**
+ * @name: int sht2x_mode_parse(const char *str)
+ * @description: 解析采集方式 delay|poll|hold
+ * @param {char} *str 采集方式
+ * @return {int} enum SHT2X_MODE，-1为无法识别
+ */
+int sht2x_mode_parse(const char *str)
+{
+    static const char *names[] = {"delay", "poll", "hold"};
+    int i;
+
+    for (i = 0; str && (i < sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (!strcmp(str, names[i]))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
 
-    sht2x_data.nmsgs = 1;
-    sht2x_data.msgs = &msg;
+/**
+ * @name: int sht2x_resolution_parse(const char *str)
+ * @description: 解析分辨率 14/12|12/8|13/10|11/11
+ * @param {char} *str 温度位数/湿度位数
+ * @return {int} enum SHT2X_RESOLUTION，-1为无法识别
+ */
+int sht2x_resolution_parse(const char *str)
+{
+    int i;
 
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+    for (i = 0; str && (i < sizeof(sht2x_timing) / sizeof(sht2x_timing[0])); i++)
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
+        if (!strcmp(str, sht2x_timing[i].name))
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/**
+ * @name: int sht2x_meas_time(int resolution)
+ * @description: 一次采样(温度和湿度各转换一次)的最长转换时间，采样周期不能比它更短
+ * @param {int} resolution enum SHT2X_RESOLUTION
+ * @return {int} 毫秒数，-1为分辨率无效
+ */
+int sht2x_meas_time(int resolution)
+{
+    if ((resolution < 0) || (resolution >= (int)(sizeof(sht2x_timing) / sizeof(sht2x_timing[0]))))
+    {
+        return -1;
+    }
+
+    return sht2x_timing[resolution].temp_delay + sht2x_timing[resolution].humi_delay;
+}
+
+/**
+ * @name: int sht2x_set_resolution(sensor_t *sensor, int resolution)
+ * @description: 读-改-写用户寄存器设置分辨率，保留其他位(加热器、OTP重载等)，写完读回校验
+ *               软复位会恢复默认分辨率，需要在sht2x_init()之后调用
+ * @param {sensor_t} *sensor 传感器
+ * @param {int} resolution enum SHT2X_RESOLUTION
+ * @return {int} 0为正常执行，负数则出现错误
+ */
+int sht2x_set_resolution(sensor_t *sensor, int resolution)
+{
+    uint8_t cmd = CMD_READ_USER_REG;
+    uint8_t reg;
+    uint8_t buf[2];
+
+    if (!sensor || !sensor->ops || (resolution < 0)
+        || (resolution >= (int)(sizeof(sht2x_timing) / sizeof(sht2x_timing[0]))))
+    {
+        printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
+        return -1;
+    }
+
+    if (sensor_transfer(sensor, &cmd, 1, &reg, 1) < 0)
+    {
+        printf("%s() read user register failure: %s\n", __func__, strerror(errno));
         return -2;
     }
 
-    msleep(50);
+    // 分辨率在bit7和bit0
+    buf[0] = CMD_WRITE_USER_REG;
+    buf[1] = (reg & ~SHT20_USER_REG_RES) | ((resolution & 0x2) << 6) | (resolution & 0x1);
+    if (sensor_write(sensor, buf, 2) < 0)
+    {
+        printf("%s() write user register failure: %s\n", __func__, strerror(errno));
+        return -3;
+    }
+
+    if ((sensor_transfer(sensor, &cmd, 1, &reg, 1) < 0) || ((reg & SHT20_USER_REG_RES) != (buf[1] & SHT20_USER_REG_RES)))
+    {
+        printf("%s() user register readback 0x%02x mismatch\n", __func__, reg);
+        return -4;
+    }
+
     return 0;
 }
 
 /**
- * @name: int sht2x_get_temp_humidity(int fd, float *temp, float *rh)
- * @description: 从sht20获取温度和湿度并打印
- * @param {int} fd  文件描述符
- * @param {float} *temp 温度参数
- * @param {float} *rh   湿度参数
- * @return {*}
+ * @name: static long long sht2x_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
  */
-int sht2x_get_temp_humidity(int fd, float *temp, float *rh)
+static long long sht2x_now_ms(void)
 {
-    struct i2c_msg msg;
-    struct i2c_rdwr_ioctl_data sht2x_data;
-    uint8_t buf[4];
+    struct timespec ts;
 
-    if (fd < 0)
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static int sht2x_retry(sht2x_meas_t *meas)
+ * @description: 从本次采样的重试预算中扣除一次
+ * @param {sht2x_meas_t} *meas 测量状态
+ * @return {int} 0为可以重试，-1为预算已用完
+ */
+static int sht2x_retry(sht2x_meas_t *meas)
+{
+    if (meas->attempts >= SHT20_RETRY_MAX)
     {
-        printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
         return -1;
     }
 
-    /*+------------------------------------------+
-     *| measure and get temperature |
-     *+------------------------------------------+*/
+    meas->attempts++;
+    meas->retries++;
+    return 0;
+}
 
-    msg.addr = 0x40;
-    msg.flags = 0; // write
-    msg.len = 1;
-    msg.buf = buf;
-    msg.buf[0] = CMD_TRIGGER_TEMP_NOHOLD; /* trigger temperature without hold I2C bus */
+/**
+ * @name: static int sht2x_start(sensor_t *sensor, sht2x_meas_t *meas, uint8_t cmd, int delay)
+ * @description: 以不保持主机模式触发一次转换，总线随即释放，写失败时在重试次数内立即重写
+ * @param {sensor_t} *sensor 传感器
+ * @param {sht2x_meas_t} *meas 测量状态
+ * @param {uint8_t} cmd 测量命令
+ * @param {int} delay 数据手册的最长转换时间(ms)
+ * @return {int} 距第一次读取的毫秒数，负数则出现错误
+ */
+static int sht2x_start(sensor_t *sensor, sht2x_meas_t *meas, uint8_t cmd, int delay)
+{
+    while (sensor_write(sensor, &cmd, 1) < 0)
+    {
+        printf("%s() write command 0x%02x failure: %s\n", __func__, cmd, strerror(errno));
+        if (sht2x_retry(meas) < 0)
+        {
+            return -1;
+        }
+    }
 
-    sht2x_data.nmsgs = 1;
-    sht2x_data.msgs = &msg;
+    // 轮询到最长转换时间的两倍仍未完成则放弃
+    meas->deadline_ms = sht2x_now_ms() + 2 * delay;
+    return meas->mode == SHT2X_MODE_POLL ? SHT20_POLL_INTERVAL : delay;
+}
 
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+/**
+ * @name: static uint8_t sht2x_crc8(const uint8_t *buf, int len)
+ * @description: 查表计算SHT2x的CRC-8，初值0
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {uint8_t} 校验值
+ */
+static uint8_t sht2x_crc8(const uint8_t *buf, int len)
+{
+    uint8_t crc = 0;
+    int     i;
+
+    for (i = 0; i < len; i++)
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
-        return -2;
+        crc = sht2x_crc_table[crc ^ buf[i]];
     }
 
-    msleep(85);
+    return crc;
+}
+
+/**
+ * @name: static int sht2x_decode(sht2x_meas_t *meas, const uint8_t *buf, uint8_t cmd, uint16_t *raw)
+ * @description: 校验CRC和LSB的bit1测量类型(温度为0，湿度为1)，取出清除了低两位状态位的原始值
+ * @param {sht2x_meas_t} *meas 测量状态，校验失败时累计crc_errors
+ * @param {uint8_t} *buf MSB、LSB、CRC
+ * @param {uint8_t} cmd 测量命令
+ * @param {uint16_t} *raw 原始值
+ * @return {int} 0为正常执行，-1为校验失败，errno为EBADMSG
+ */
+static int sht2x_decode(sht2x_meas_t *meas, const uint8_t *buf, uint8_t cmd, uint16_t *raw)
+{
+    int humidity = (cmd == CMD_TRIGGER_HUMI_HOLD) || (cmd == CMD_TRIGGER_HUMI_NOHOLD);
+
+    if ((sht2x_crc8(buf, 2) != buf[2]) || (((buf[1] & 0x02) != 0) != humidity))
+    {
+        printf("%s() bad measurement %02x %02x %02x\n", __func__, buf[0], buf[1], buf[2]);
+        meas->crc_errors++;
+        errno = EBADMSG;
+        return -1;
+    }
+
+    // 原始值占两个字节，i2c先传高字节，再传低字节
+    *raw = ((((uint16_t)buf[0]) << 8) + buf[1]) & 0xFFFC;
+    return 0;
+}
+
+/**
+ * @name: static int sht2x_fetch(sensor_t *sensor, sht2x_meas_t *meas, uint8_t cmd, uint16_t *raw)
+ * @description: 读出转换结果MSB、LSB和CRC并校验，轮询方式下器件NACK说明转换还没有完成
+ * @param {sensor_t} *sensor 传感器
+ * @param {sht2x_meas_t} *meas 测量状态
+ * @param {uint8_t} cmd 测量命令
+ * @param {uint16_t} *raw 原始值
+ * @return {int} 0为正常执行，1为转换未完成需要再读，负数则出现错误
+ */
+static int sht2x_fetch(sensor_t *sensor, sht2x_meas_t *meas, uint8_t cmd, uint16_t *raw)
+{
+    uint8_t buf[3];
 
     memset(buf, 0, sizeof(buf));
-    msg.addr = 0x40;
-    msg.flags = I2C_M_RD; // write
-    msg.len = 3;
-    msg.buf = buf;
+    if (sensor_read(sensor, buf, 3) < 0)
+    {
+        // 不同的i2c控制器驱动对NACK返回ENXIO或EREMOTEIO，轮询期间的其他总线错误只计数，期限内照常再读
+        if ((meas->mode == SHT2X_MODE_POLL) && (sht2x_now_ms() < meas->deadline_ms))
+        {
+            if ((errno != ENXIO) && (errno != EREMOTEIO))
+            {
+                meas->retries++;
+            }
+            return 1;
+        }
+        printf("%s() read failure: %s\n", __func__, strerror(errno));
+        return -1;
+    }
 
-    sht2x_data.nmsgs = 1;
-    sht2x_data.msgs = &msg;
+    return sht2x_decode(meas, buf, cmd, raw);
+}
+
+/**
+ * @name: static int sht2x_hold(sensor_t *sensor, sht2x_meas_t *meas, uint8_t cmd, uint16_t *raw)
+ * @description: 保持主机模式，写命令和读结果在一次传输中完成，转换期间器件拉低SCL
+ *               传输失败或校验失败时在重试次数内立即重新测量
+ * @param {sensor_t} *sensor 传感器
+ * @param {sht2x_meas_t} *meas 测量状态
+ * @param {uint8_t} cmd 测量命令
+ * @param {uint16_t} *raw 原始值
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int sht2x_hold(sensor_t *sensor, sht2x_meas_t *meas, uint8_t cmd, uint16_t *raw)
+{
+    uint8_t buf[3];
+
+    do
+    {
+        memset(buf, 0, sizeof(buf));
+        if (sensor_transfer(sensor, &cmd, 1, buf, 3) < 0)
+        {
+            printf("%s() transfer command 0x%02x failure: %s\n", __func__, cmd, strerror(errno));
+        }
+        else if (sht2x_decode(meas, buf, cmd, raw) == 0)
+        {
+            return 0;
+        }
+    } while (sht2x_retry(meas) == 0);
+
+    return -1;
+}
+
+/**
+ * @name: int sht2x_trigger(sensor_t *sensor, sht2x_meas_t *meas)
+ * @description: 开始一次异步测量，调用者在返回的时间之后调用sht2x_collect()
+ *               不保持主机时先触发温度转换，保持主机时不访问总线，两次测量都在sht2x_collect()中完成
+ * @param {sensor_t} *sensor 传感器
+ * @param {sht2x_meas_t} *meas 测量状态，mode由调用者设置
+ * @return {int} 距读取结果的毫秒数，负数则出现错误
+ */
+int sht2x_trigger(sensor_t *sensor, sht2x_meas_t *meas)
+{
+    int rv;
+
+    if (!sensor || !sensor->ops || !meas
+        || (meas->resolution < 0) || (meas->resolution >= (int)(sizeof(sht2x_timing) / sizeof(sht2x_timing[0]))))
+    {
+        printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
+        return -1;
+    }
+
+    meas->state    = SHT2X_IDLE;
+    meas->attempts = 0;
+    if (meas->mode == SHT2X_MODE_HOLD)
+    {
+        meas->state = SHT2X_TEMP;
+        return 0;
+    }
 
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+    if ((rv = sht2x_start(sensor, meas, CMD_TRIGGER_TEMP_NOHOLD, sht2x_timing[meas->resolution].temp_delay)) < 0)
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
         return -2;
     }
 
-    // dump_buf("Temperature sample data: ", buf, 3);
-    *temp = 175.72 * (((((int)buf[0]) << 8) + buf[1]) / 65536.0) - 46.85;
+    meas->state = SHT2X_TEMP;
+    return rv;
+}
 
-    /*+------------------------------------------+
-     *| measure and get relative humidity |
-     *+------------------------------------------+*/
+/**
+ * @name: int sht2x_collect(sensor_t *sensor, sht2x_meas_t *meas)
+ * @description: 读出已完成的转换，温度读完后接着触发湿度转换
+ *               轮询方式下转换未完成时返回轮询间隔，读失败或校验失败时在SHT20_RETRY_MAX次内重新触发
+ *               重试用完后测量状态回到空闲，本次测量作废
+ * @param {sensor_t} *sensor 传感器
+ * @param {sht2x_meas_t} *meas 测量状态
+ * @return {int} 0为温湿度都已读出，大于0为距下一次读取的毫秒数，负数则出现错误
+ */
+int sht2x_collect(sensor_t *sensor, sht2x_meas_t *meas)
+{
+    uint16_t raw;
+    uint8_t  cmd;
+    int      delay;
+    int      state;
+    int      rv;
 
-    msg.addr = 0x40;
-    msg.flags = 0; // write
-    msg.len = 1;
-    msg.buf = buf;
-    msg.buf[0] = CMD_TRIGGER_HUMI_NOHOLD; /* trigger humidity without hold I2C bus */
+    if (!sensor || !sensor->ops || !meas || (meas->state == SHT2X_IDLE))
+    {
+        printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
+        return -1;
+    }
 
-    sht2x_data.nmsgs = 1;
-    sht2x_data.msgs = &msg;
+    state       = meas->state;
+    meas->state = SHT2X_IDLE;
 
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+    if (meas->mode == SHT2X_MODE_HOLD)
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
-        return -2;
+        if (sht2x_hold(sensor, meas, CMD_TRIGGER_TEMP_HOLD, &raw) < 0)
+        {
+            return -2;
+        }
+        meas->temp = 175.72 * (raw / 65536.0) - 46.85;
+
+        if (sht2x_hold(sensor, meas, CMD_TRIGGER_HUMI_HOLD, &raw) < 0)
+        {
+            return -3;
+        }
+        meas->rh = 125 * (raw / 65536.0) - 6;
+        return 0;
     }
 
-    msleep(29);
+    cmd   = state == SHT2X_TEMP ? CMD_TRIGGER_TEMP_NOHOLD : CMD_TRIGGER_HUMI_NOHOLD;
+    delay = state == SHT2X_TEMP ? sht2x_timing[meas->resolution].temp_delay : sht2x_timing[meas->resolution].humi_delay;
+    if ((rv = sht2x_fetch(sensor, meas, cmd, &raw)) > 0)
+    {
+        meas->state = state;
+        return SHT20_POLL_INTERVAL;
+    }
+    else if (rv < 0)
+    {
+        if (sht2x_retry(meas) < 0)
+        {
+            return -2;
+        }
+
+        // 总线错误时器件仍保留结果，隔一个轮询间隔再读
+        // 校验失败说明结果已经读走，超时仍NACK说明转换丢失，这两种情况重新触发这一项转换
+        meas->state = state;
+        if ((errno != EBADMSG) && (errno != ENXIO) && (errno != EREMOTEIO))
+        {
+            return SHT20_POLL_INTERVAL;
+        }
+        if ((rv = sht2x_start(sensor, meas, cmd, delay)) < 0)
+        {
+            meas->state = SHT2X_IDLE;
+            return -3;
+        }
+        return rv;
+    }
 
-    memset(buf, 0, sizeof(buf));
-    msg.addr = 0x40;
-    msg.flags = I2C_M_RD; // write
-    msg.len = 3;
-    msg.buf = buf;
+    if (state == SHT2X_TEMP)
+    {
+        // 温度计算公式 T= -46.85 + 175.72 * ST/2^16
+        meas->temp = 175.72 * (raw / 65536.0) - 46.85;
+
+        if ((rv = sht2x_start(sensor, meas, CMD_TRIGGER_HUMI_NOHOLD, sht2x_timing[meas->resolution].humi_delay)) < 0)
+        {
+            return -3;
+        }
+        meas->state = SHT2X_HUMI;
+        return rv;
+    }
 
-    sht2x_data.nmsgs = 1;
-    sht2x_data.msgs = &msg;
+    // 湿度计算公式 RH= -6 + 125 * SRH/2^16
+    meas->rh = 125 * (raw / 65536.0) - 6;
+    return 0;
+}
 
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+/**
+ * @name: int sht2x_get_temp_humidity(sensor_t *sensor, float *temp, float *rh)
+ * @description: 以默认采集方式从sht20获取温度和湿度，阻塞等待转换完成
+ * @param {sensor_t} *sensor 传感器
+ * @param {float} *temp 温度参数
+ * @param {float} *rh   湿度参数
+ * @return {*}
+ */
+int sht2x_get_temp_humidity(sensor_t *sensor, float *temp, float *rh)
+{
+    sht2x_meas_t meas;
+    int          rv;
+
+    if (!temp || !rh)
+    {
+        printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
+        return -1;
+    }
+
+    memset(&meas, 0, sizeof(meas));
+    meas.mode = sht2x_mode_parse(SHT20_MODE_DEFAULT);
+    for (rv = sht2x_trigger(sensor, &meas); (rv >= 0) && (meas.state != SHT2X_IDLE); rv = sht2x_collect(sensor, &meas))
+    {
+        msleep(rv);
+    }
+    if (rv < 0)
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
         return -2;
     }
-    // dump_buf("Relative humidity sample data: ", buf, 3);
 
-    *rh = 125 * (((((int)buf[0]) << 8) + buf[1]) / 65536.0) - 6;
+    *temp = meas.temp;
+    *rh   = meas.rh;
     return 0;
 }
 
 /**
- * @name: int sht2x_get_serialNumber(int fd, uint8_t *serialNumber, int size)
+ * @name: int sht2x_get_serialNumber(sensor_t *sensor, uint8_t *serialNumber, int size)
  * @description: SHT20获取序列号函数
- * @param {int} fd  文件描述符
+ * @param {sensor_t} *sensor 传感器
  * @param {uint8_t} *serialNumber 序列号参数
  * @param {int} size 序列号长度
  * @return {*}
  */
-int sht2x_get_serialNumber(int fd, uint8_t *serialnumber, int size)
+int sht2x_get_serialNumber(sensor_t *sensor, uint8_t *serialnumber, int size)
 {
-    struct i2c_msg msgs[2];
-    struct i2c_rdwr_ioctl_data sht2x_data;
     uint8_t sbuf[2];
     uint8_t rbuf[4];
 
-    if (fd < 0)
+    if (!sensor || !sensor->ops || !serialnumber || size != 8)
     {
         printf("%s line [%d] %s() get invalid input arguments\n", __FILE__, __LINE__, __func__);
         return -1;
@@ -249,25 +608,12 @@ int sht2x_get_serialNumber(int fd, uint8_t *serialnumber, int size)
      *| Read SerialNumber from Location 1 |
      *+------------------------------------------+*/
 
-    msgs[0].addr = 0x40;
-    msgs[0].flags = 0; // write
-    msgs[0].len = 2;
-    msgs[0].buf = sbuf;
-
-    msgs[0].buf[0] = 0xfa; /* command for readout on-chip memory */
-    msgs[0].buf[1] = 0x0f; /* on-chip memory address */
-
-    msgs[1].addr = 0x40;
-    msgs[1].flags = I2C_M_RD; // write
-    msgs[1].len = 4;
-    msgs[1].buf = rbuf;
+    sbuf[0] = 0xfa; /* command for readout on-chip memory */
+    sbuf[1] = 0x0f; /* on-chip memory address */
 
-    sht2x_data.nmsgs = 2;
-    sht2x_data.msgs = msgs;
-
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+    if ((sensor_write(sensor, sbuf, 2) < 0) || (sensor_read(sensor, rbuf, 4) < 0))
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
+        printf("%s() transfer failure: %s\n", __func__, strerror(errno));
         return -2;
     }
 
@@ -280,25 +626,12 @@ int sht2x_get_serialNumber(int fd, uint8_t *serialnumber, int size)
      *| Read SerialNumber from Location 2 |
      *+------------------------------------------+*/
 
-    msgs[0].addr = 0x40;
-    msgs[0].flags = 0; // write
-    msgs[0].len = 2;
-    msgs[0].buf = sbuf;
-
-    msgs[0].buf[0] = 0xfc; /* command for readout on-chip memory */
-    msgs[0].buf[1] = 0xc9; /* on-chip memory address */
-
-    msgs[1].addr = 0x40;
-    msgs[1].flags = I2C_M_RD; // write
-    msgs[1].len = 4;
-    msgs[1].buf = rbuf;
+    sbuf[0] = 0xfc; /* command for readout on-chip memory */
+    sbuf[1] = 0xc9; /* on-chip memory address */
 
-    sht2x_data.nmsgs = 2;
-    sht2x_data.msgs = msgs;
-
-    if (ioctl(fd, I2C_RDWR, &sht2x_data) < 0)
+    if ((sensor_write(sensor, sbuf, 2) < 0) || (sensor_read(sensor, rbuf, 4) < 0))
     {
-        printf("%s() ioctl failure: %s\n", __func__, strerror(errno));
+        printf("%s() transfer failure: %s\n", __func__, strerror(errno));
         return -2;
     }
 
@@ -309,4 +642,4 @@ int sht2x_get_serialNumber(int fd, uint8_t *serialnumber, int size)
 
     dump_buf("SHT2x Serial number: ", serialnumber, 8);
     return 0;
-}
\ No newline at end of file
+}
@@ -2,44 +2,84 @@
  * @Author: RoxyKko
  * @Date: 2023-03-26 11:22:00
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 21:19:28
+ * @LastEditTime: 2026-10-17 21:12:34
  * @Description: iot项目-温湿度检测
  */
 #include "iot_main.h"
+#include "spool.h"
+#include "persist.h"
 
-#define I2C_BUS "/dev/i2c-1"           // 设备总线地址
-#define SHT20_ADDR 0x40                // i2c设备物理地址
 #define Vision 1.5                     // 版本号
 #define lastEdit "2023-04-06 17:57:49" // 最后编辑时间
 #define TABLE_NAME "RPI4B"             // 数据库表名
 #define DATABASE_NAME "sht20"          // 数据库名
+#define BATCH_ROWS 1                   // 默认每个事务最多提交的行数，1为每个采样立即落盘
+#define BATCH_MS 1000                  // 默认事务最长持续时间(ms)
+#define DRAIN_ROWS 128                 // 每个批量帧最多包含的缓存行数，不超过SEND_BATCH_MAX
+#define EPOLL_EVENTS 4                 // 持久化线程的eventfd、积压检查定时器、socket
 
 int g_sigstop = 0; // 停止信号
 
 static inline void print_usage(char *progname);
 static inline void print_vision(char *progname);
+static int timer_open(int epfd, int period_ms);
+static uint64_t timer_expirations(int tfd);
+static void client_disconnect(socket_connect_t *conn, bool *socket_connected, send_window_t *window);
+static void sig_stop(int signum);
+static int ring_spill(spool_t *spool, sample_ring_t *ring, packinfo_t *rows);
+static int pipeline_pull(persist_t *persist, sample_ring_t *ring);
+static void pipeline_report(sampler_t *sampler, persist_t *persist, sample_ring_t *ring);
+static void pipeline_abort(sampler_t *sampler, persist_t *persist, spool_t *spool);
 
 int main(int argc, char **argv)
 {
     int opt;                            // 命令行选项
-    int i2c_fd = -1;                    // i2c设备文件描述符
+    static sampler_t sampler;           // 各总线的采样线程，流水线第一级
+    static persist_t persist;           // 持久化线程，流水线第二级，主线程为第三级的网络线程
+    char *sensor_opt = SENSOR_DEFAULT;  // 传感器后端
+    char *table_opt = NULL;             // 传感器表文件
+    char *mode_opt = SHT20_MODE_DEFAULT; // 采集方式
+    char *res_opt = SHT20_RESOLUTION_DEFAULT; // 测量分辨率
     int daemon_run = 0;                 // 后台运行标志
     char *progname = NULL;              // 程序名
     int error = -1;                     // 报错提示符
-    float temp, rh = 0;                 // 温度、湿度
+    int mode;                           // 采集方式
+    int resolution;                     // 测量分辨率
     char *servip = NULL;                // 服务器ip
     int port = 0;                       // 链接端口号
     char buf[1024];                     // 数据暂存区
-    int socket_fd = -1;                 // socket描述符
+    socket_connect_t conn;              // 与服务器的非阻塞连接
+    int retry_cap = CONNECT_BACKOFF_CAP / 1000; // 重连退避上限(s)
     bool socket_connected = false;      // socket链接状态指示符
     packinfo_t packinfo;                // 数据包结构体
     int interval = 4;                   // 采样间隔，默认设为4s
     int socket_interval = 1;            // 采样间隔，默认设为4s
-    sqlite3 *db;                        // 数据库句柄
-    static double current_time = 0;     // 当前时间
-    static double latest_time = 0;      // 获取温湿度的上一次时间
-    static double get_sockstattime = 0; // 获取socket状态的上一次时间
-    char datime[128];                   // 日期时间字符串
+    spool_t spool;                      // 溢出缓存
+    char *spool_opt = SPOOL_DEFAULT;    // 溢出缓存后端
+    int batch_rows = BATCH_ROWS;        // 每个事务最多提交的行数
+    int batch_ms = BATCH_MS;            // 事务最长持续时间(ms)
+    char *p;
+    char *storage_opt = DB_PROFILE_DEFAULT; // 存储配置
+    db_profile_t profile;               // 解析后的存储配置
+    static packinfo_t drain[DRAIN_ROWS]; // 每轮补发的积压数据
+    int drain_rows = 0;                 // 本轮取出的积压行数
+    int64_t drain_pos = 0;              // 本轮取出的最后一条记录的位置
+    int backlog = 0;                    // 可能还有未发送的数据
+    sample_ring_t ring;                 // 内存中未确认的采样
+    int ring_size = SAMPLE_RING_DEFAULT; // 环形缓冲区容量
+    send_window_t window;               // 已发送未确认的批量帧
+    int window_size = SEND_WINDOW_DEFAULT; // 最多在途的批量帧数
+    uint32_t ack_seq;                   // 服务器确认的批量帧序号
+    int rv;
+    int epfd = -1;                      // epoll句柄
+    int tick_tfd = -1;                  // 积压检查和重连定时器
+    struct epoll_event event;           // 加入epoll的事件
+    struct epoll_event events[EPOLL_EVENTS];
+    int nfds, i;
+    int timeout;                        // epoll_wait超时(ms)
+    uint32_t sock_events;               // 本轮连接socket的epoll事件
+    int64_t pending_pos = -1;           // 不支持确认时等待写完才释放的记录位置，-1为没有
+    struct sigaction sigact;            // 信号处理
 
     struct option long_options[] = {
         {"help", no_argument, NULL, 'h'},
@@ -50,6 +90,16 @@ int main(int argc, char **argv)
         {"deamon", no_argument, NULL, 'b'},
         {"ipaddr", required_argument, NULL, 'i'},
         {"port", required_argument, NULL, 'p'},
+        {"batch", required_argument, NULL, 'B'},
+        {"storage", required_argument, NULL, 'S'},
+        {"window", required_argument, NULL, 'W'},
+        {"retry", required_argument, NULL, 'R'},
+        {"memory", required_argument, NULL, 'M'},
+        {"spool", required_argument, NULL, 'Q'},
+        {"device", required_argument, NULL, 'D'},
+        {"acquire", required_argument, NULL, 'A'},
+        {"resolution", required_argument, NULL, 'r'},
+        {"sensors", required_argument, NULL, 'T'},
         {0, 0, 0, 0}};
 
     // 获取程序名
@@ -72,7 +122,7 @@ int main(int argc, char **argv)
     log_info("============================================================\n");
 
     // 命令行选项解析
-    while ((opt = getopt_long(argc, argv, "hvtHsbp:i:", long_options, NULL)) != -1)
+    while ((opt = getopt_long(argc, argv, "hvtHsbp:i:B:S:W:R:M:Q:D:A:r:T:", long_options, NULL)) != -1)
     {
         switch (opt)
         {
@@ -105,6 +155,50 @@ int main(int argc, char **argv)
             // 获取端口号
             port = atoi(optarg);
             break;
+        case 'B':
+            // 获取批量提交参数 ROWS[,MS]
+            batch_rows = atoi(optarg);
+            if ((p = strchr(optarg, ',')) != NULL)
+            {
+                batch_ms = atoi(p + 1);
+            }
+            break;
+        case 'S':
+            // 获取存储配置
+            storage_opt = optarg;
+            break;
+        case 'W':
+            // 获取发送窗口大小
+            window_size = atoi(optarg);
+            break;
+        case 'R':
+            // 获取重连退避上限
+            retry_cap = atoi(optarg);
+            break;
+        case 'M':
+            // 获取内存缓冲的采样条数
+            ring_size = atoi(optarg);
+            break;
+        case 'Q':
+            // 获取溢出缓存后端
+            spool_opt = optarg;
+            break;
+        case 'D':
+            // 获取传感器后端
+            sensor_opt = optarg;
+            break;
+        case 'A':
+            // 获取采集方式
+            mode_opt = optarg;
+            break;
+        case 'r':
+            // 获取测量分辨率
+            res_opt = optarg;
+            break;
+        case 'T':
+            // 获取传感器表
+            table_opt = optarg;
+            break;
         default:
             log_error("Invalid argument\n");
             break;
@@ -112,7 +206,11 @@ int main(int argc, char **argv)
     }
 
     // 检查IP和端口号
-    if (!servip || !port)
+    if (!servip || !port || database_profile_parse(storage_opt, &profile) < 0
+        || send_window_init(&window, window_size) < 0 || sample_ring_init(&ring, ring_size) < 0
+        || (mode = sht2x_mode_parse(mode_opt)) < 0 || (resolution = sht2x_resolution_parse(res_opt)) < 0
+        || sampler_init(&sampler) < 0
+        || (table_opt ? sampler_load(&sampler, table_opt) : sampler_add(&sampler, TABLE_NAME, sensor_opt, interval * 1000)) < 0)
     {
         print_usage(argv[0]);
         return 0;
@@ -125,173 +223,276 @@ int main(int argc, char **argv)
         daemon(0, 0);
     }
 
-    // 初始化sht20
-    i2c_fd = sht2x_init();
-    if (i2c_fd < 0)
+    // 打开传感器表中的所有sht20，每条总线启动一个采样线程，没有传感器表时只有-D指定的一个器件
+    if ((rv = sampler_start(&sampler, mode, resolution)) < 0)
     {
         log_error("sht2x initialize failed!\n");
         printf("sht2x initialize failed!\n");
+        if (rv == -1)
+        {
+            print_usage(argv[0]);
+        }
         return -1;
     }
-    log_info("sht2x initialize success!\n");
-
-    // sht20软件复位
-    if (sht2x_softReset(i2c_fd) < 0)
-    {
-        log_error("sht2x softReset failed!\n");
-        printf("sht2x softReset failed!\n");
-        return -2;
-    }
-    log_info("sht2x softReset success!\n");
+    log_info("sht2x initialize success, acquire mode %s, resolution %s\n", mode_opt, res_opt);
 
     // 安装信号处理函数，忽略 SIGINT 信号，以便在使用 Ctrl+C 组合键时不会终止进程
     // signal(SIGINT, SIG_IGN);
+    // 收到SIGTERM/SIGINT时退出主循环，把内存中未确认的采样写入数据库
+    // 不设SA_RESTART，阻塞中的系统调用返回EINTR，主循环能及时看到g_sigstop
+    memset(&sigact, 0, sizeof(sigact));
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_handler = sig_stop;
+    sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGINT, &sigact, NULL);
+    // 服务器断开后写socket返回EPIPE按连接异常处理，不因SIGPIPE丢失内存中的采样
+    sigact.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sigact, NULL);
+
+    // 打开溢出缓存，断网时内存放不下的采样按批落盘
+    if ((rv = spool_open(&spool, spool_opt, DATABASE_NAME, TABLE_NAME, &profile, batch_rows, batch_ms)) < 0)
+    {
+        log_error("spool %s open failed!\n", spool_opt);
+        printf("spool %s open failed!\n", spool_opt);
+        if (rv == -1)
+        {
+            print_usage(argv[0]);
+        }
+        pipeline_abort(&sampler, NULL, NULL);
+        return -3;
+    }
 
-    // 初始化数据库
-    if (database_init(DATABASE_NAME, &db) < 0)
+    // 溢出缓存交给持久化线程，慢速的写入和fsync不阻塞发送
+    if (persist_start(&persist, &spool, &sampler) < 0)
     {
-        log_error("database init failed!\n");
-        printf("database init failed!\n");
+        log_error("persist thread start failed!\n");
+        pipeline_abort(&sampler, NULL, &spool);
         return -3;
     }
 
-    // 若数据库中不存在表，则创建表
-    if (database_create_table(TABLE_NAME, &db) < 0)
+    // 持久化线程的eventfd、积压检查的CLOCK_MONOTONIC定时器和服务器socket放在同一个epoll中，空闲时进程睡眠
+    event.events  = EPOLLIN;
+    event.data.fd = persist.out_efd;
+    if (((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+        || (epoll_ctl(epfd, EPOLL_CTL_ADD, persist.out_efd, &event) < 0)
+        || ((tick_tfd = timer_open(epfd, socket_interval * 1000)) < 0))
+    {
+        log_error("create epoll and timers failed: %s\n", strerror(errno));
+        pipeline_abort(&sampler, &persist, &spool);
+        return -8;
+    }
+
+    // 连接在主循环中异步进行，connect和握手都不会推迟采样
+    if (socket_connect_init(&conn, epfd, servip, port, retry_cap * 1000) < 0)
     {
-        database_close(DATABASE_NAME, &db);
-        return -4;
+        log_error("invalid server address %s or retry cap %d s\n", servip, retry_cap);
+        print_usage(argv[0]);
+        pipeline_abort(&sampler, &persist, &spool);
+        close(tick_tfd);
+        close(epfd);
+        return -9;
     }
 
-    current_time = 0;
+    // 上次运行溢出到数据库的采样先于之后的采样发送
+    backlog = __atomic_load_n(&persist.spooled, __ATOMIC_ACQUIRE) > 0;
 
     while (!g_sigstop)
     {
-        // 获取当前时间
-        latest_time = get_time(NULL);
-        // 若当前时间与上一次时间的差值大于等于采样间隔，则进行温湿度采样
-        if ((latest_time - current_time) >= interval)
+        // 有待发送的缓存且窗口未满时不等待，否则睡到定时器到期、新采样、服务器确认到达、socket可写或下一次连接
+        timeout = -1;
+        if (socket_connected && backlog && !send_window_full(&window) && (sendata_pending(SEND_ACK_TIMEOUT) == 0))
         {
-            // 获取进行温湿度采样的时间
-            current_time = get_time(datime);
+            timeout = 0;
+        }
+        else if (!socket_connected && backlog && ((rv = socket_connect_timeout(&conn)) >= 0)
+                 && ((timeout < 0) || (rv < timeout)))
+        {
+            timeout = rv;
+        }
 
-            // 温湿度采样
-            if (sht2x_get_temp_humidity(i2c_fd, &temp, &rh) < 0)
-            {
-                log_error("sht2x get temp and humidity failed!\n");
-                printf("sht2x get temp and humidity failed!\n");
-                return -5;
-            }
-            log_info("sht2x get temp and humidity success!\n");
-
-            // 将温湿度数据存入packinfo结构体
-            memset(&packinfo, 0, sizeof(packinfo));
-            strcpy(packinfo.devid, TABLE_NAME);
-            strcpy(packinfo.time, datime);
-            packinfo.temp = temp;
-            packinfo.humi = rh;
-            log_debug("packinfo: devid=%s, time=%s, temp=%.2f, humi=%.2f\n", packinfo.devid, packinfo.time, packinfo.temp, packinfo.humi);
-
-            // 获取socket状态
-            if (get_sock_status(socket_fd) == 0)
+        if ((nfds = epoll_wait(epfd, events, EPOLL_EVENTS, timeout < 0 ? -1 : timeout)) < 0)
+        {
+            if (errno == EINTR)
             {
-                socket_connected = false;
+                continue;
             }
+            log_error("epoll_wait failure: %s\n", strerror(errno));
+            break;
+        }
 
-            if (socket_connected)
+        sock_events = 0;
+        for (i = 0; i < nfds; i++)
+        {
+            // 持久化线程送来采样，测量和落盘都在其他线程中进行，发送再慢也不会推迟采样时刻
+            if (events[i].data.fd == persist.out_efd)
             {
-                // 将温湿度数据发送给服务器
-                if (sendata(socket_fd, packinfo) < 0)
+                timer_expirations(persist.out_efd);
+                if (__atomic_load_n(&persist.error, __ATOMIC_ACQUIRE) < 0)
                 {
-                    log_error("socket client send failed!\n");
-                    printf("socket client send failed!\n");
-                    if (database_insert_data(TABLE_NAME, &db, &packinfo) < 0)
-                    {
-                        log_error("database insert data failed!\n");
-                        printf("database insert data failed!\n");
-                        return -6;
-                    }
-                    socket_connected = false;
-                    close(socket_fd);
+                    printf("spool append data failed!\n");
+                    g_sigstop = 1;
+                    break;
+                }
+
+                // 获取socket状态
+                if (socket_connected && get_sock_status(conn.fd) == 0)
+                {
+                    client_disconnect(&conn, &socket_connected, &window);
                 }
+
+                pipeline_pull(&persist, &ring);
+                backlog = 1;
+                pipeline_report(&sampler, &persist, &ring);
             }
-            else
+
+            // 每socket_interval秒检查一次积压数据，需要时重新连接
+            else if (events[i].data.fd == tick_tfd)
             {
-                // 若socket未链接，则存入数据库
-                if (database_insert_data(TABLE_NAME, &db, &packinfo) < 0)
+                if ((timer_expirations(tick_tfd) == 0) || ((__atomic_load_n(&persist.spooled, __ATOMIC_ACQUIRE) == 0)
+                    && (sample_queue_depth(&persist.out) == 0) && (sample_ring_count(&ring) == 0)))
                 {
-                    log_error("database insert data failed!\n");
-                    printf("database insert data failed!\n");
-                    return -6;
+                    continue;
+                }
+                backlog = 1;
+
+                // 获取socket状态
+                if (socket_connected && get_sock_status(conn.fd) == 0)
+                {
+                    client_disconnect(&conn, &socket_connected, &window);
                 }
-                log_info("database insert data success!\n");
-                close(socket_fd);
             }
-        } // end if ((latest_time - current_time) >= interval)
 
-        else if ((latest_time - get_sockstattime) >= socket_interval)
+            // 连接过程中的可写、握手应答，已连接时服务器的确认或发送缓冲区腾出空间
+            else if (events[i].data.fd == conn.fd)
+            {
+                sock_events = events[i].events;
+            }
+        }
+
+        // 有数据要发送时推进连接状态机，连接成功后补发数据表中的数据
+        if (!socket_connected && backlog && socket_connect_poll(&conn, sock_events))
         {
-            // 获取socket状态的时间
-            get_sockstattime = get_time(datime);
+            socket_connected = true;
+            send_window_reset(&window);
+            sock_events = 0;
+        }
 
-            // 检查表是否为空
-            if (database_check_data(TABLE_NAME, &db) > 0)
+        // 内存中的采样每轮取出一批一次发出，补发速度只受带宽限制，数据库中溢出的采样按批读回内存
+        // 服务器支持确认时最多window_size个批量帧在途，收到确认后才释放已确认的采样
+        // 不支持确认时写入成功就释放
+        // socket为非阻塞，发送缓冲区满时没写完的部分等EPOLLOUT再写，写完之前不发新的批量帧
+        if (socket_connected && (backlog || window.count > 0 || sock_events))
+        {
+            if (sendata_pending(SEND_ACK_TIMEOUT) != 0)
             {
-                // 获取socket状态
-                if (get_sock_status(socket_fd) == 0)
+                rv = (sock_events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) ? sendata_flush(conn.fd) : sendata_pending(SEND_ACK_TIMEOUT);
+                if ((rv < 0) || ((rv > 0) && (sendata_pending(SEND_ACK_TIMEOUT) < 0)))
                 {
-                    socket_connected = false;
+                    // 连接异常或服务器长期不读，没写完的采样留在内存中，重连后重发
+                    log_error("socket client flush failed!\n");
+                    client_disconnect(&conn, &socket_connected, &window);
+                    pending_pos = -1;
+                    continue;
                 }
 
-                // 若socket未连接，则连接socket
-                if (!socket_connected)
+                if (rv == 0)
                 {
-                    socket_fd = socket_client_init(servip, port);
-                    socket_connected = true;
-                    if (socket_fd < 0)
+                    socket_connect_want_write(&conn, 0);
+                    if (pending_pos >= 0)
                     {
-                        close(socket_fd);
-                        socket_connected = false;
+                        sample_ring_release(&ring, pending_pos);
+                        pending_pos = -1;
                     }
                 }
-                // 若socket已连接，则发送数据表中的数据
+            }
+
+            if (proto_version >= PROTO_VERSION_ACK)
+            {
+                rv = socket_client_recv_ack(conn.fd, 0, &ack_seq);
+                if ((rv < 0) || send_window_expired(&window, SEND_ACK_TIMEOUT))
+                {
+                    // 连接异常或确认超时，未确认的采样留在内存中，重连后重发
+                    log_error("socket client wait ack failed!\n");
+                    client_disconnect(&conn, &socket_connected, &window);
+                    pending_pos = -1;
+                    continue;
+                }
+
+                if ((rv > 0) && ((drain_pos = send_window_ack(&window, ack_seq)) >= 0))
+                {
+                    sample_ring_release(&ring, drain_pos);
+                    backlog |= pipeline_pull(&persist, &ring) > 0;
+                }
+            }
+
+            if (backlog && !send_window_full(&window) && (sendata_pending(SEND_ACK_TIMEOUT) == 0))
+            {
+                pipeline_pull(&persist, &ring);
+                if ((drain_rows = sample_ring_peek(&ring, window.cursor, drain, DRAIN_ROWS, &drain_pos)) == 0)
+                {
+                    // 缓存数据已全部发送，持久化线程送来新采样或确认后腾出空间时再取
+                    backlog = 0;
+                }
+                else if ((rv = sendata_batch(conn.fd, drain, drain_rows, window.next_seq)) < 0)
+                {
+                    // 发送失败，等待重新连接
+                    log_error("socket client send failed!\n");
+                    printf("socket client send failed!\n");
+                    client_disconnect(&conn, &socket_connected, &window);
+                }
                 else
                 {
-                    // 从表中第一个数据幅值给packinfo
-                    if (database_select_data(TABLE_NAME, &db, &packinfo) < 0)
+                    // 没写完时等socket可写，支持确认的帧照常进入窗口，服务器长期不读时由确认超时断开
+                    if ((rv > 0) && (socket_connect_want_write(&conn, 1) < 0))
                     {
-                        log_error("database select data failed!\n");
-                        printf("database select data failed!\n");
-                        return -7;
+                        client_disconnect(&conn, &socket_connected, &window);
+                        continue;
                     }
 
-                    // 将温湿度数据发送给服务器
-                    if (sendata(socket_fd, packinfo) < 0)
+                    if (proto_version >= PROTO_VERSION_ACK)
+                    {
+                        send_window_push(&window, drain_pos);
+                    }
+                    else if (rv > 0)
                     {
-                        // 发送失败，退出循环
-                        log_error("socket client send failed!\n");
-                        printf("socket client send failed!\n");
-                        socket_connected = false;
-                        close(socket_fd);
+                        pending_pos = drain_pos;
                     }
                     else
                     {
-                        // 发送成功则删除表中第一个的数据
-                        if (database_delete_data(TABLE_NAME, &db) == 0)
-                        {
-                            log_info("database delete data success!\n");
-                        }
-                        else
-                        {
-                            log_error("database delete data failed!\n");
-                            printf("database delete data failed!\n");
-                            return -7;
-                        }
+                        sample_ring_release(&ring, drain_pos);
                     }
                 }
-
-            } // end else if(database_check_data(TABLE_NAME, &db) > 0)
+            }
         }
     } // end while(!g_sigstop)
+
+    // 按流水线顺序退出，采样线程队列中剩余的采样由持久化线程写入，之后溢出缓存回到主线程
+    sampler_stop(&sampler);
+    persist_stop(&persist);
+    pipeline_report(&sampler, &persist, &ring);
+
+    // 内存中和发送队列中未确认的采样写入溢出缓存，下次启动后重发
+    client_disconnect(&conn, &socket_connected, &window);
+    if (ring_spill(&spool, &ring, drain) < 0)
+    {
+        log_error("spool spill data failed!\n");
+        printf("spool spill data failed!\n");
+    }
+    while (sample_queue_pop(&persist.out, &packinfo))
+    {
+        if (spool_append(&spool, &packinfo) < 0)
+        {
+            log_error("spool append data failed!\n");
+            break;
+        }
+    }
+    persist_free(&persist);
+    sampler_free(&sampler);
+    sample_ring_free(&ring);
+    close(tick_tfd);
+    close(epfd);
+    spool_close(&spool);
+    return 0;
 }
 
 /**
@@ -315,6 +516,18 @@ static inline void print_usage(char *progname)
     printf(" -t[temp   ] Display now temp\n");
     printf(" -H[humi   ] Display now humi\n");
     printf(" -v[vision ] Display prog vision\n");
+    printf(" -S[storage] Storage profile durable|throughput[,key=value...] (default %s)\n", DB_PROFILE_DEFAULT);
+    printf(" -W[window ] Spooled batches in flight waiting for server ack (default %d, max %d)\n", SEND_WINDOW_DEFAULT, SEND_WINDOW_MAX);
+    printf(" -R[retry  ] Maximum reconnect backoff in seconds, retries are jittered (default %d)\n", CONNECT_BACKOFF_CAP / 1000);
+    printf(" -M[memory ] Samples kept in RAM before spilling to the database (default %d, max %d)\n", SAMPLE_RING_DEFAULT, SAMPLE_RING_MAX);
+    printf(" -Q[spool  ] Overflow spool sqlite|mmap[,RECORDS] (default %s, mmap keeps %d records)\n", SPOOL_DEFAULT, MMAP_SPOOL_DEFAULT);
+    printf(" -B[batch  ] Commit spooled samples every ROWS[,MS] rows or milliseconds (default %d,%d)\n", BATCH_ROWS, BATCH_MS);
+    printf(" -D[device ] Sensor backend i2c-rdwr|i2c-rw[,bus=PATH,addr=ADDR] or\n");
+    printf("             sim[,latency=MS,noise=SIGMA,fail=P,crc=P,seed=N] (default %s)\n", SENSOR_DEFAULT);
+    printf(" -A[acquire] Measurement mode delay|poll|hold (default %s), hold blocks the loop during conversion\n", SHT20_MODE_DEFAULT);
+    printf(" -T[sensors] Sensor table file, one \"DEVID PERIOD SENSOR\" per line, one sampling thread per bus\n");
+    printf("             (default one sensor from -D, devid %s, every 4 s)\n", TABLE_NAME);
+    printf(" -r[resol  ] Temperature/humidity bits 14/12|12/8|13/10|11/11 (default %s), fewer bits convert faster\n", SHT20_RESOLUTION_DEFAULT);
 
     printf("\nExample: %s -b -p 8900 -i 127.0.0.1\n", progname);
 
@@ -335,3 +548,191 @@ static inline void print_vision(char *progname)
     log_debug("Print vision success, the program exits");
     return;
 }
+
+/**
+ * @name: static int timer_open(int epfd, int period_ms)
+ * @description: 创建CLOCK_MONOTONIC周期定时器并加入epoll，首次立即到期，之后按绝对时间周期到期
+ *               内核按固定周期计算到期时间，处理耗时不会累积成采样漂移，也不受系统时间调整影响
+ * @param {int} epfd epoll句柄
+ * @param {int} period_ms 周期(ms)
+ * @return {int} timerfd，负数则出现错误
+ */
+static int timer_open(int epfd, int period_ms)
+{
+    struct itimerspec   its;
+    struct epoll_event  event;
+    int                 tfd;
+
+    if ((tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+    {
+        return -1;
+    }
+
+    memset(&its, 0, sizeof(its));
+    if (period_ms > 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &its.it_value);
+    }
+    its.it_interval.tv_sec  = period_ms / 1000;
+    its.it_interval.tv_nsec = (period_ms % 1000) * 1000000L;
+
+    event.events  = EPOLLIN;
+    event.data.fd = tfd;
+    if ((timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) || (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &event) < 0))
+    {
+        close(tfd);
+        return -2;
+    }
+
+    return tfd;
+}
+
+/**
+ * @name: static uint64_t timer_expirations(int tfd)
+ * @description: 读取并清零定时器的到期次数，也用于读取eventfd的计数
+ * @param {int} tfd timerfd或eventfd
+ * @return {uint64_t} 上次读取以来的到期次数，0为未到期
+ */
+static uint64_t timer_expirations(int tfd)
+{
+    uint64_t    expirations = 0;
+
+    if (read(tfd, &expirations, sizeof(expirations)) != sizeof(expirations))
+    {
+        return 0;
+    }
+
+    return expirations;
+}
+
+/**
+ * @name: static void client_disconnect(socket_connect_t *conn, bool *socket_connected, send_window_t *window)
+ * @description: 关闭与服务器的连接并按退避时间安排重连，未确认的缓存行留在数据库中，重连后重发
+ * @param {socket_connect_t} *conn 与服务器的连接
+ * @param {bool} *socket_connected socket链接状态指示符
+ * @param {send_window_t} *window 发送窗口
+ * @return {*}
+ */
+static void client_disconnect(socket_connect_t *conn, bool *socket_connected, send_window_t *window)
+{
+    socket_connect_close(conn);
+    *socket_connected = false;
+    send_window_reset(window);
+}
+
+/**
+ * @name: static void sig_stop(int signum)
+ * @description: 停止信号处理函数，epoll_wait被中断后主循环退出
+ * @param {int} signum 信号
+ * @return {*}
+ */
+static void sig_stop(int signum)
+{
+    g_sigstop = 1;
+}
+
+/**
+ * @name: static int ring_spill(spool_t *spool, sample_ring_t *ring, packinfo_t *rows)
+ * @description: 退出前把内存中未确认的采样写入溢出缓存，下次启动后重发
+ * @param {spool_t} *spool 溢出缓存
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @param {packinfo_t} *rows 至少DRAIN_ROWS条的临时数组
+ * @return {int} 写入的条数，负数则出现错误
+ */
+static int ring_spill(spool_t *spool, sample_ring_t *ring, packinfo_t *rows)
+{
+    int64_t         last;
+    int             total = 0;
+    int             count;
+    int             i;
+
+    while ((count = sample_ring_peek(ring, 0, rows, DRAIN_ROWS, &last)) > 0)
+    {
+        for (i = 0; i < count; i++)
+        {
+            if (spool_append(spool, &rows[i]) < 0)
+            {
+                return -1;
+            }
+        }
+        sample_ring_release(ring, last);
+        total += count;
+    }
+
+    log_info("spill %d sample(s) from memory to spool\n", total);
+    return total;
+}
+
+/**
+ * @name: static int pipeline_pull(persist_t *persist, sample_ring_t *ring)
+ * @description: 从持久化线程的队列取出采样放入内存缓冲区，直到缓冲区满，取走后唤醒持久化线程继续读回积压
+ * @param {persist_t} *persist 持久化线程
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @return {int} 取出的条数
+ */
+static int pipeline_pull(persist_t *persist, sample_ring_t *ring)
+{
+    packinfo_t      pack_info;
+    int             count = 0;
+
+    while ((sample_ring_space(ring) > 0) && sample_queue_pop(&persist->out, &pack_info))
+    {
+        sample_ring_push(ring, &pack_info);
+        count++;
+    }
+
+    if (count > 0)
+    {
+        persist_kick(persist);
+    }
+
+    return count;
+}
+
+/**
+ * @name: static void pipeline_report(sampler_t *sampler, persist_t *persist, sample_ring_t *ring)
+ * @description: 在日志中输出流水线各级的队列深度
+ * @param {sampler_t} *sampler 采样器
+ * @param {persist_t} *persist 持久化线程
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @return {*}
+ */
+static void pipeline_report(sampler_t *sampler, persist_t *persist, sample_ring_t *ring)
+{
+    log_info("backlog: %llu sample(s) queued at samplers, %llu queued for network, %d in memory, %d spooled\n",
+             (unsigned long long)sampler_depth(sampler), (unsigned long long)sample_queue_depth(&persist->out),
+             sample_ring_count(ring), __atomic_load_n(&persist->spooled, __ATOMIC_ACQUIRE));
+}
+
+/**
+ * @name: static void pipeline_abort(sampler_t *sampler, persist_t *persist, spool_t *spool)
+ * @description: 启动中途失败时按流水线顺序停止已启动的线程，队列中已有的采样写入溢出缓存后关闭
+ * @param {sampler_t} *sampler 已启动的采样器
+ * @param {persist_t} *persist 已启动的持久化线程，NULL为还未启动
+ * @param {spool_t} *spool 已打开的溢出缓存，NULL为还未打开
+ * @return {*}
+ */
+static void pipeline_abort(sampler_t *sampler, persist_t *persist, spool_t *spool)
+{
+    packinfo_t      pack_info;
+
+    sampler_stop(sampler);
+    if (persist)
+    {
+        persist_stop(persist);
+        while (sample_queue_pop(&persist->out, &pack_info) && (spool_append(spool, &pack_info) == 0))
+            ;
+        persist_free(persist);
+    }
+    else if (spool)
+    {
+        while (sampler_pop(sampler, &pack_info) && (spool_append(spool, &pack_info) == 0))
+            ;
+    }
+
+    if (spool)
+    {
+        spool_close(spool);
+    }
+    sampler_free(sampler);
+}
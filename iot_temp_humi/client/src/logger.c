@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-04 17:53:48
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 16:40:43
+ * @LastEditTime: 2026-10-17 20:35:14
  * @Description: 日志系统
  */
 
@@ -70,12 +70,14 @@ int logger_init(char *filename, int loglevel)
 static void log_generic(const int level, const char *format, va_list args)
 {
     char        buf[256];
-    struct tm  *tm;
+    struct tm   tm_now;
+    struct tm  *tm = &tm_now;
     time_t      time_now;
 
-    vsprintf(buf, format, args);
+    // 采样线程并发写日志，使用可重入的vsnprintf/localtime_r
+    vsnprintf(buf, sizeof(buf), format, args);
     time(&time_now);
-    tm = localtime(&time_now);
+    localtime_r(&time_now, tm);
 
     int res = fprintf(g_logger.fp, 
     "%s : %02d-%02d-%02d %02d:%02d:%02d [%s]: %s\n"
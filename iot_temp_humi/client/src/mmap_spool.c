@@ -0,0 +1,449 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:50:00
+ * @Description: 基于内存映射的追加式缓存文件
+ */
+
+#include <stddef.h>
+#include "mmap_spool.h"
+
+/**
+ * @name: static long long mmap_spool_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
+ */
+static long long mmap_spool_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static mmap_spool_rec_t *mmap_spool_slot(mmap_spool_t *sp, uint64_t seq)
+ * @description: 序号对应的记录位置
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {uint64_t} seq 记录序号
+ * @return {mmap_spool_rec_t *} 记录
+ */
+static mmap_spool_rec_t *mmap_spool_slot(mmap_spool_t *sp, uint64_t seq)
+{
+    return &sp->recs[seq % sp->capacity];
+}
+
+/**
+ * @name: static int mmap_spool_valid(mmap_spool_t *sp, uint64_t seq)
+ * @description: 检查序号对应位置上是否是该序号的完整记录，断电时写了一半的记录CRC不对
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {uint64_t} seq 记录序号
+ * @return {int} 1为有效，0为无效
+ */
+static int mmap_spool_valid(mmap_spool_t *sp, uint64_t seq)
+{
+    mmap_spool_rec_t *rec = mmap_spool_slot(sp, seq);
+
+    return (rec->seq == seq) && (rec->crc == proto_crc16((const uint8_t *)rec, offsetof(mmap_spool_rec_t, crc)));
+}
+
+/**
+ * @name: static void mmap_spool_store_hdr(mmap_spool_t *sp, uint64_t head, uint64_t tail)
+ * @description: 更新文件头，只修改映射内存，由内核回写或在关闭时同步
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {uint64_t} head 最早一条记录的序号
+ * @param {uint64_t} tail 下一条记录的序号
+ * @return {*}
+ */
+static void mmap_spool_store_hdr(mmap_spool_t *sp, uint64_t head, uint64_t tail)
+{
+    sp->hdr->head = head;
+    sp->hdr->tail = tail;
+    sp->hdr->crc  = proto_crc16((const uint8_t *)sp->hdr, offsetof(mmap_spool_hdr_t, crc));
+}
+
+/**
+ * @name: static void mmap_spool_recover(mmap_spool_t *sp)
+ * @description: 打开已有文件时恢复head和tail
+ *               文件头有效时从其中的tail向后找回还没来得及回写文件头的记录
+ *               文件头损坏时扫描全部记录，从最大的有效序号向前找连续的记录
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @return {*}
+ */
+static void mmap_spool_recover(mmap_spool_t *sp)
+{
+    mmap_spool_hdr_t   *hdr  = sp->hdr;
+    uint64_t            head = 0;
+    uint64_t            tail = 0;
+    uint32_t            i;
+    int                 found = 0;
+
+    if ((hdr->crc == proto_crc16((const uint8_t *)hdr, offsetof(mmap_spool_hdr_t, crc)))
+        && (hdr->head <= hdr->tail) && (hdr->tail - hdr->head <= sp->capacity))
+    {
+        head = hdr->head;
+        tail = hdr->tail;
+    }
+    else
+    {
+        log_warn("mmap spool header corrupted, scan %u records\n", sp->capacity);
+        for (i = 0; i < sp->capacity; i++)
+        {
+            if ((sp->recs[i].seq % sp->capacity == i) && mmap_spool_valid(sp, sp->recs[i].seq)
+                && (!found || (sp->recs[i].seq >= tail)))
+            {
+                tail  = sp->recs[i].seq + 1;
+                found = 1;
+            }
+        }
+
+        head = tail;
+        while ((head > 0) && (tail - head < sp->capacity) && mmap_spool_valid(sp, head - 1))
+        {
+            head--;
+        }
+    }
+
+    while ((tail - head < sp->capacity) && mmap_spool_valid(sp, tail))
+    {
+        tail++;
+    }
+
+    // 文件满时覆盖了最早的记录，而回写的文件头中的head还是旧的
+    while ((head < tail) && !mmap_spool_valid(sp, head))
+    {
+        head++;
+    }
+
+    mmap_spool_store_hdr(sp, head, tail);
+    sp->synced = tail;
+}
+
+/**
+ * @name: int mmap_spool_open(mmap_spool_t *sp, const char *path, uint32_t capacity, int max_rows, int max_ms)
+ * @description: 打开或创建缓存文件，新文件一次性分配空间，之后追加不再修改文件大小和块分配
+ *               已有文件沿用创建时的容量
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {char} *path 文件路径
+ * @param {uint32_t} capacity 新文件的记录条数
+ * @param {int} max_rows 每同步一次最多追加的记录数，1为每条记录立即落盘
+ * @param {int} max_ms 未同步记录最长等待时间(ms)
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int mmap_spool_open(mmap_spool_t *sp, const char *path, uint32_t capacity, int max_rows, int max_ms)
+{
+    mmap_spool_hdr_t    hdr;
+    struct stat         st;
+    int                 created = 0;
+    int                 rv;
+
+    if ((sp == NULL) || (path == NULL) || (capacity < 1) || (capacity > MMAP_SPOOL_MAX) || (max_rows < 1) || (max_ms < 0))
+    {
+        log_error("The mmap_spool_open() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(sp, 0, sizeof(*sp));
+    sp->max_rows = max_rows;
+    sp->max_ms   = max_ms;
+
+    if (((sp->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0) || (fstat(sp->fd, &st) < 0))
+    {
+        log_error("Open mmap spool %s failure: %s\n", path, strerror(errno));
+        if (sp->fd >= 0)
+        {
+            close(sp->fd);
+        }
+        return -2;
+    }
+
+    if (st.st_size == 0)
+    {
+        sp->size = MMAP_SPOOL_HDR_SIZE + (size_t)capacity * MMAP_SPOOL_REC_SIZE;
+        if ((rv = posix_fallocate(sp->fd, 0, sp->size)) != 0)
+        {
+            log_error("Allocate mmap spool %s failure: %s\n", path, strerror(rv));
+            close(sp->fd);
+            return -3;
+        }
+        created = 1;
+    }
+    else
+    {
+        if ((pread(sp->fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) || (hdr.magic != MMAP_SPOOL_MAGIC)
+            || (hdr.rec_size != MMAP_SPOOL_REC_SIZE) || (hdr.capacity < 1) || (hdr.capacity > MMAP_SPOOL_MAX)
+            || (st.st_size != MMAP_SPOOL_HDR_SIZE + (off_t)hdr.capacity * MMAP_SPOOL_REC_SIZE))
+        {
+            log_error("%s is not a mmap spool file\n", path);
+            close(sp->fd);
+            return -4;
+        }
+
+        if (hdr.capacity != capacity)
+        {
+            log_warn("mmap spool %s keeps its capacity %u\n", path, hdr.capacity);
+        }
+        capacity = hdr.capacity;
+        sp->size = st.st_size;
+    }
+
+    if ((sp->base = mmap(NULL, sp->size, PROT_READ | PROT_WRITE, MAP_SHARED, sp->fd, 0)) == MAP_FAILED)
+    {
+        log_error("Map mmap spool %s failure: %s\n", path, strerror(errno));
+        close(sp->fd);
+        return -5;
+    }
+
+    sp->hdr      = (mmap_spool_hdr_t *)sp->base;
+    sp->recs     = (mmap_spool_rec_t *)(sp->base + MMAP_SPOOL_HDR_SIZE);
+    sp->capacity = capacity;
+
+    if (created)
+    {
+        sp->hdr->magic    = MMAP_SPOOL_MAGIC;
+        sp->hdr->rec_size = MMAP_SPOOL_REC_SIZE;
+        sp->hdr->capacity = capacity;
+        mmap_spool_store_hdr(sp, 0, 0);
+        msync(sp->base, MMAP_SPOOL_HDR_SIZE, MS_SYNC);
+    }
+    else
+    {
+        mmap_spool_recover(sp);
+    }
+
+    log_info("Opened mmap spool %s, %u records, %d pending\n", path, capacity, mmap_spool_count(sp));
+    return 0;
+}
+
+/**
+ * @name: static int mmap_spool_msync(mmap_spool_t *sp, uint32_t first, uint32_t last)
+ * @description: 同步下标first到last的记录所在的页
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {uint32_t} first 第一条记录的下标
+ * @param {uint32_t} last 最后一条记录的下标
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int mmap_spool_msync(mmap_spool_t *sp, uint32_t first, uint32_t last)
+{
+    static long     page_size = 0;
+    size_t          start     = MMAP_SPOOL_HDR_SIZE + (size_t)first * MMAP_SPOOL_REC_SIZE;
+    size_t          end       = MMAP_SPOOL_HDR_SIZE + (size_t)(last + 1) * MMAP_SPOOL_REC_SIZE;
+
+    if (page_size == 0)
+    {
+        page_size = sysconf(_SC_PAGESIZE);
+    }
+
+    // msync()要求起始地址按页对齐
+    start -= start % page_size;
+    return msync(sp->base + start, end - start, MS_SYNC);
+}
+
+/**
+ * @name: int mmap_spool_sync(mmap_spool_t *sp)
+ * @description: 把未同步的记录写入存储，绕回文件开头时分两段同步
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int mmap_spool_sync(mmap_spool_t *sp)
+{
+    uint64_t        tail  = sp->hdr->tail;
+    uint32_t        first = sp->synced % sp->capacity;
+    uint32_t        last  = (tail - 1) % sp->capacity;
+    int             rv;
+
+    if (sp->synced == tail)
+    {
+        return 0;
+    }
+
+    if (tail - sp->synced >= sp->capacity)
+    {
+        rv = mmap_spool_msync(sp, 0, sp->capacity - 1);
+    }
+    else if (first <= last)
+    {
+        rv = mmap_spool_msync(sp, first, last);
+    }
+    else
+    {
+        rv = mmap_spool_msync(sp, first, sp->capacity - 1) | mmap_spool_msync(sp, 0, last);
+    }
+
+    if (rv < 0)
+    {
+        log_error("mmap_spool_sync failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    sp->synced = tail;
+    return 0;
+}
+
+/**
+ * @name: int mmap_spool_append(mmap_spool_t *sp, const packinfo_t *pack_info)
+ * @description: 在末尾追加一条记录，文件满时覆盖最早的记录，满max_rows条或超过max_ms时同步
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int mmap_spool_append(mmap_spool_t *sp, const packinfo_t *pack_info)
+{
+    mmap_spool_rec_t   *rec;
+    uint64_t            head = sp->hdr->head;
+    uint64_t            tail = sp->hdr->tail;
+
+    if (tail - head == sp->capacity)
+    {
+        if (sp->dropped++ == 0)
+        {
+            log_warn("mmap spool full, overwrite the oldest records\n");
+        }
+        head++;
+    }
+
+    rec = mmap_spool_slot(sp, tail);
+    memset(rec, 0, sizeof(*rec));
+    rec->seq  = tail;
+    rec->ts   = pack_info->ts;
+    rec->temp = pack_info->temp;
+    rec->humi = pack_info->humi;
+    memcpy(rec->devid, pack_info->devid, strnlen(pack_info->devid, sizeof(rec->devid) - 1));
+    memcpy(rec->time, pack_info->time, strnlen(pack_info->time, sizeof(rec->time) - 1));
+    rec->crc  = proto_crc16((const uint8_t *)rec, offsetof(mmap_spool_rec_t, crc));
+
+    if (sp->synced == tail)
+    {
+        sp->first_ms = mmap_spool_now_ms();
+    }
+    mmap_spool_store_hdr(sp, head, tail + 1);
+
+    if ((tail + 1 - sp->synced >= sp->max_rows) || (mmap_spool_now_ms() - sp->first_ms >= sp->max_ms))
+    {
+        return mmap_spool_sync(sp);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int mmap_spool_poll(mmap_spool_t *sp)
+ * @description: 未同步的记录等待超过max_ms时同步
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @return {int} 距下一次同步的毫秒数，没有未同步的记录时返回-1，同步失败返回-2
+ */
+int mmap_spool_poll(mmap_spool_t *sp)
+{
+    long long       elapsed;
+
+    if (sp->synced == sp->hdr->tail)
+    {
+        return -1;
+    }
+
+    elapsed = mmap_spool_now_ms() - sp->first_ms;
+    if (elapsed < sp->max_ms)
+    {
+        return (int)(sp->max_ms - elapsed);
+    }
+
+    return mmap_spool_sync(sp) < 0 ? -2 : -1;
+}
+
+/**
+ * @name: int mmap_spool_count(mmap_spool_t *sp)
+ * @description: 文件中的记录数
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @return {int} 记录数
+ */
+int mmap_spool_count(mmap_spool_t *sp)
+{
+    return (int)(sp->hdr->tail - sp->hdr->head);
+}
+
+/**
+ * @name: int mmap_spool_read(mmap_spool_t *sp, packinfo_t *pack_info, int max_rows)
+ * @description: 从最早一条开始读取最多max_rows条记录，记录留在文件中直到mmap_spool_consume()
+ *               CRC错误的记录跳过，只可能出现在存储介质损坏时，跳过的记录在mmap_spool_consume()时一并丢弃
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {packinfo_t} *pack_info 数据结构体数组，至少max_rows个元素
+ * @param {int} max_rows 最多读取的条数
+ * @return {int} 读取的条数，0为文件中已没有有效记录
+ */
+int mmap_spool_read(mmap_spool_t *sp, packinfo_t *pack_info, int max_rows)
+{
+    mmap_spool_rec_t   *rec;
+    uint64_t            seq = sp->hdr->head;
+    int                 n   = 0;
+
+    for (; (n < max_rows) && (seq < sp->hdr->tail); seq++)
+    {
+        if (!mmap_spool_valid(sp, seq))
+        {
+            log_error("mmap spool record %llu corrupted, skip it\n", (unsigned long long)seq);
+            continue;
+        }
+
+        rec = mmap_spool_slot(sp, seq);
+        memset(&pack_info[n], 0, sizeof(packinfo_t));
+        memcpy(pack_info[n].devid, rec->devid, sizeof(rec->devid) - 1);
+        memcpy(pack_info[n].time, rec->time, sizeof(rec->time) - 1);
+        pack_info[n].ts   = rec->ts;
+        pack_info[n].temp = rec->temp;
+        pack_info[n].humi = rec->humi;
+        n++;
+    }
+
+    sp->skipped = (int)(seq - sp->hdr->head) - n;
+    return n;
+}
+
+/**
+ * @name: void mmap_spool_consume(mmap_spool_t *sp, int count)
+ * @description: 丢弃最早的count条记录，只修改文件头，不同步
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @param {int} count 上一次mmap_spool_read()返回的条数
+ * @return {*}
+ */
+void mmap_spool_consume(mmap_spool_t *sp, int count)
+{
+    uint64_t        head = sp->hdr->head + count + sp->skipped;
+
+    if (head > sp->hdr->tail)
+    {
+        head = sp->hdr->tail;
+    }
+
+    sp->skipped = 0;
+    mmap_spool_store_hdr(sp, head, sp->hdr->tail);
+}
+
+/**
+ * @name: int mmap_spool_close(mmap_spool_t *sp)
+ * @description: 同步剩余的记录和文件头，解除映射
+ * @param {mmap_spool_t} *sp 缓存文件
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int mmap_spool_close(mmap_spool_t *sp)
+{
+    int             rv;
+
+    if (sp->base == NULL)
+    {
+        return 0;
+    }
+
+    rv = mmap_spool_sync(sp);
+    if (msync(sp->base, MMAP_SPOOL_HDR_SIZE, MS_SYNC) < 0)
+    {
+        rv = -1;
+    }
+
+    munmap(sp->base, sp->size);
+    close(sp->fd);
+    sp->base = NULL;
+    sp->fd   = -1;
+
+    return rv;
+}
@@ -0,0 +1,303 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:43:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:43:00
+ * @Description: 持久化线程，采样流水线的第二级
+ */
+
+#include "persist.h"
+
+/**
+ * @name: static long long persist_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
+ */
+static long long persist_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static void persist_notify(int efd)
+ * @description: 写eventfd唤醒等待的线程
+ * @param {int} efd eventfd
+ * @return {*}
+ */
+static void persist_notify(int efd)
+{
+    uint64_t    one = 1;
+
+    if ((write(efd, &one, sizeof(one)) < 0) && (errno != EAGAIN))
+    {
+        log_error("persist_notify() write eventfd failure: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * @name: static int persist_refill(persist_t *persist)
+ * @description: 网络线程的队列有空间时按顺序从溢出缓存读回，溢出缓存中的采样早于之后的新采样
+ * @param {persist_t} *persist 持久化线程
+ * @return {int} 读回的条数，负数则出现错误
+ */
+static int persist_refill(persist_t *persist)
+{
+    uint64_t    space;
+    int         total = 0;
+    int         count;
+    int         i;
+
+    while ((spool_count(persist->spool) > 0) && ((space = sample_queue_space(&persist->out)) > 0))
+    {
+        if ((count = spool_read(persist->spool, persist->rows, space < PERSIST_REFILL_ROWS ? space : PERSIST_REFILL_ROWS)) < 0)
+        {
+            return -1;
+        }
+
+        for (i = 0; i < count; i++)
+        {
+            sample_queue_push(&persist->out, &persist->rows[i]);
+        }
+
+        // 没有读到采样时也要调用，丢弃读取时跳过的损坏记录
+        if (spool_consume(persist->spool) < 0)
+        {
+            return -2;
+        }
+
+        total += count;
+        if (count == 0)
+        {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * @name: static int persist_drain(persist_t *persist)
+ * @description: 取出采样线程送来的新采样，溢出缓存为空且网络线程的队列有空间时直接交给网络线程，否则写入溢出缓存
+ * @param {persist_t} *persist 持久化线程
+ * @return {int} 交给网络线程的条数，负数则写入溢出缓存失败
+ */
+static int persist_drain(persist_t *persist)
+{
+    packinfo_t  pack_info;
+    int         total = 0;
+
+    while (sampler_pop(persist->sampler, &pack_info))
+    {
+        log_debug("packinfo: devid=%s, time=%s, temp=%.2f, humi=%.2f\n", pack_info.devid, pack_info.time, pack_info.temp, pack_info.humi);
+        if ((spool_count(persist->spool) == 0) && (sample_queue_space(&persist->out) > 0))
+        {
+            sample_queue_push(&persist->out, &pack_info);
+            total++;
+            continue;
+        }
+
+        if (spool_append(persist->spool, &pack_info) < 0)
+        {
+            return -1;
+        }
+        persist->spilled++;
+    }
+
+    return total;
+}
+
+/**
+ * @name: static void *persist_thread(void *arg)
+ * @description: 持久化线程主循环，等待新采样、网络线程取走采样或事务到期
+ * @param {void} *arg 持久化线程
+ * @return {*}
+ */
+static void *persist_thread(void *arg)
+{
+    persist_t      *persist = (persist_t *)arg;
+    struct pollfd   pfds[2];
+    sigset_t        sigmask;
+    uint64_t        val;
+    long long       begin;
+    int             moved;
+    int             rv;
+    int             timeout;
+
+    // 停止信号只由主线程处理
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, SIGINT);
+    sigaddset(&sigmask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+
+    log_info("persist thread running, %d sample(s) spooled\n", spool_count(persist->spool));
+
+    pfds[0].fd     = persist->sampler->efd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd     = persist->wake_efd;
+    pfds[1].events = POLLIN;
+
+    while (1)
+    {
+        begin = persist_now_ms();
+        moved = 0;
+
+        // 退出时不再读回，网络线程手里的采样也要写回溢出缓存
+        if (!__atomic_load_n(&persist->stop, __ATOMIC_ACQUIRE))
+        {
+            if ((rv = persist_refill(persist)) < 0)
+            {
+                log_error("spool refill data failed!\n");
+                __atomic_store_n(&persist->error, rv, __ATOMIC_RELEASE);
+                break;
+            }
+            persist->refilled += rv;
+            moved += rv;
+        }
+
+        if ((rv = persist_drain(persist)) < 0)
+        {
+            log_error("spool append data failed!\n");
+            __atomic_store_n(&persist->error, rv, __ATOMIC_RELEASE);
+            break;
+        }
+        moved += rv;
+
+        // 批量提交，事务到期前最多等到到期时刻
+        if ((timeout = spool_poll(persist->spool)) == -2)
+        {
+            log_error("spool commit failed!\n");
+        }
+        __atomic_store_n(&persist->spooled, spool_count(persist->spool), __ATOMIC_RELEASE);
+
+        // 一轮只通知一次网络线程，读回大量积压时不会每条采样一次系统调用
+        if (moved > 0)
+        {
+            persist_notify(persist->out_efd);
+        }
+        if (persist_now_ms() - begin > persist->max_busy_ms)
+        {
+            persist->max_busy_ms = persist_now_ms() - begin;
+        }
+
+        // 采样线程已全部退出且队列已取空
+        if (__atomic_load_n(&persist->stop, __ATOMIC_ACQUIRE) && (sampler_depth(persist->sampler) == 0))
+        {
+            break;
+        }
+
+        if ((timeout < 0) || (timeout > PERSIST_WAIT_TIMEOUT))
+        {
+            timeout = PERSIST_WAIT_TIMEOUT;
+        }
+        if (poll(pfds, 2, timeout) > 0)
+        {
+            while (read(persist->sampler->efd, &val, sizeof(val)) > 0)
+                ;
+            while (read(persist->wake_efd, &val, sizeof(val)) > 0)
+                ;
+        }
+    }
+
+    // 唤醒网络线程，让它看到退出或错误
+    persist_notify(persist->out_efd);
+    log_info("persist thread exit, %llu sample(s) spilled, %llu refilled, max busy %lld ms\n",
+             (unsigned long long)persist->spilled, (unsigned long long)persist->refilled, persist->max_busy_ms);
+    return NULL;
+}
+
+/**
+ * @name: int persist_start(persist_t *persist, spool_t *spool, sampler_t *sampler)
+ * @description: 创建交给网络线程的队列并启动持久化线程
+ * @param {persist_t} *persist 持久化线程
+ * @param {spool_t} *spool 已打开的溢出缓存
+ * @param {sampler_t} *sampler 已启动的采样器
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int persist_start(persist_t *persist, spool_t *spool, sampler_t *sampler)
+{
+    if (!persist || !spool || !sampler)
+    {
+        log_error("The persist_start() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(persist, 0, sizeof(*persist));
+    persist->spool    = spool;
+    persist->sampler  = sampler;
+    persist->spooled  = spool_count(spool);
+    persist->wake_efd = -1;
+    if (((persist->out_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        || ((persist->wake_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0))
+    {
+        log_error("persist_start() eventfd failure: %s\n", strerror(errno));
+        if (persist->out_efd >= 0)
+        {
+            close(persist->out_efd);
+        }
+        return -2;
+    }
+
+    // 入队时不逐条通知，由持久化线程每轮通知一次
+    if (sample_queue_init(&persist->out, PERSIST_QUEUE_SIZE, -1) < 0)
+    {
+        close(persist->out_efd);
+        close(persist->wake_efd);
+        return -3;
+    }
+
+    if (pthread_create(&persist->tid, NULL, persist_thread, persist) != 0)
+    {
+        log_error("create persist thread failure\n");
+        persist_free(persist);
+        return -4;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: void persist_kick(persist_t *persist)
+ * @description: 网络线程取走采样后调用，溢出缓存中还有积压时唤醒持久化线程读回
+ * @param {persist_t} *persist 持久化线程
+ * @return {*}
+ */
+void persist_kick(persist_t *persist)
+{
+    if (__atomic_load_n(&persist->spooled, __ATOMIC_ACQUIRE) > 0)
+    {
+        persist_notify(persist->wake_efd);
+    }
+}
+
+/**
+ * @name: void persist_stop(persist_t *persist)
+ * @description: 在采样线程退出后调用，持久化线程取完采样队列后退出，溢出缓存交还给调用者
+ *               交给网络线程的队列中剩余的采样仍可以出队
+ * @param {persist_t} *persist 持久化线程
+ * @return {*}
+ */
+void persist_stop(persist_t *persist)
+{
+    __atomic_store_n(&persist->stop, 1, __ATOMIC_RELEASE);
+    persist_notify(persist->wake_efd);
+    pthread_join(persist->tid, NULL);
+
+    log_info("sample queue to network: high water %llu, %llu dropped\n",
+             (unsigned long long)persist->out.high_water, (unsigned long long)persist->out.drops);
+}
+
+/**
+ * @name: void persist_free(persist_t *persist)
+ * @description: 释放队列和eventfd，在persist_stop()之后调用
+ * @param {persist_t} *persist 持久化线程
+ * @return {*}
+ */
+void persist_free(persist_t *persist)
+{
+    sample_queue_destroy(&persist->out);
+    close(persist->out_efd);
+    close(persist->wake_efd);
+}
@@ -0,0 +1,402 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:45:43
+ * @Description: 客户端与服务器之间的二进制传输协议
+ */
+
+#include "proto.h"
+
+/*** 
+ * @description: CRC-16/CCITT-FALSE查表(多项式0x1021)
+ */
+static const uint16_t proto_crc_table[256] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+    0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+    0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+    0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+    0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+    0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+    0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+    0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+    0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+    0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+    0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+    0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+    0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+    0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+    0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+    0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+    0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+    0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+    0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+    0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+    0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+    0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+/**
+ * @name: uint16_t proto_crc16(const uint8_t *buf, size_t len)
+ * @description: 计算CRC-16/CCITT-FALSE，初值0xFFFF
+ * @param {uint8_t} *buf 数据
+ * @param {size_t} len 数据长度
+ * @return {uint16_t} crc
+ */
+uint16_t proto_crc16(const uint8_t *buf, size_t len)
+{
+    uint16_t    crc = 0xFFFF;
+
+    while (len--)
+    {
+        crc = (crc << 8) ^ proto_crc_table[((crc >> 8) ^ *buf++) & 0xFF];
+    }
+
+    return crc;
+}
+
+/*** 
+ * @description: 多字节字段按小端逐字节读写，不依赖主机字节序和对齐
+ */
+static inline void proto_put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline uint16_t proto_get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void proto_put_u32(uint8_t *p, uint32_t v)
+{
+    proto_put_u16(p, v & 0xFFFF);
+    proto_put_u16(p + 2, v >> 16);
+}
+
+static inline uint32_t proto_get_u32(const uint8_t *p)
+{
+    return proto_get_u16(p) | ((uint32_t)proto_get_u16(p + 2) << 16);
+}
+
+static inline void proto_put_u64(uint8_t *p, uint64_t v)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+    {
+        p[i] = (v >> (i * 8)) & 0xFF;
+    }
+}
+
+static inline uint64_t proto_get_u64(const uint8_t *p)
+{
+    uint64_t    v = 0;
+    int         i;
+
+    for (i = 7; i >= 0; i--)
+    {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+/**
+ * @name: static void proto_put_record(uint8_t *p, const proto_record_t *rec)
+ * @description: 写入一条14字节的采样记录
+ * @param {uint8_t} *p 输出位置
+ * @param {proto_record_t} *rec 采样记录
+ * @return {*}
+ */
+static void proto_put_record(uint8_t *p, const proto_record_t *rec)
+{
+    proto_put_u16(p, rec->dev);
+    proto_put_u64(p + 2, (uint64_t)rec->ts);
+    proto_put_u16(p + 10, (uint16_t)rec->temp);
+    proto_put_u16(p + 12, rec->humi);
+}
+
+/**
+ * @name: static int proto_seal(uint8_t *buf, int type, size_t plen)
+ * @description: 在已写好负载的缓冲区上填写帧头和crc
+ * @param {uint8_t} *buf 帧缓冲区，负载位于buf + PROTO_HDR_LEN
+ * @param {int} type 帧类型
+ * @param {size_t} plen 负载长度
+ * @return {int} 帧长度
+ */
+static int proto_seal(uint8_t *buf, int type, size_t plen)
+{
+    buf[0] = PROTO_MAGIC;
+    buf[1] = type;
+    proto_put_u16(buf + 2, plen);
+    proto_put_u16(buf + PROTO_HDR_LEN + plen, proto_crc16(buf + 1, PROTO_HDR_LEN - 1 + plen));
+
+    return PROTO_HDR_LEN + plen + PROTO_CRC_LEN;
+}
+
+/**
+ * @name: int proto_encode_device(uint8_t *buf, size_t size, uint16_t dev, const char *name)
+ * @description: 编码设备注册帧
+ * @param {uint8_t} *buf 输出缓冲区
+ * @param {size_t} size 输出缓冲区大小
+ * @param {uint16_t} dev 设备号
+ * @param {char} *name 设备名
+ * @return {int} 帧长度，负数则缓冲区不足或设备名过长
+ */
+int proto_encode_device(uint8_t *buf, size_t size, uint16_t dev, const char *name)
+{
+    size_t      nlen = strlen(name);
+    size_t      plen = 2 + nlen;
+
+    if ((plen > PROTO_MAX_PAYLOAD) || (size < PROTO_HDR_LEN + plen + PROTO_CRC_LEN))
+    {
+        return -1;
+    }
+
+    proto_put_u16(buf + PROTO_HDR_LEN, dev);
+    memcpy(buf + PROTO_HDR_LEN + 2, name, nlen);
+
+    return proto_seal(buf, PROTO_TYPE_DEVICE, plen);
+}
+
+/**
+ * @name: int proto_encode_record(uint8_t *buf, size_t size, const proto_record_t *rec)
+ * @description: 编码采样记录帧
+ * @param {uint8_t} *buf 输出缓冲区
+ * @param {size_t} size 输出缓冲区大小
+ * @param {proto_record_t} *rec 采样记录
+ * @return {int} 帧长度，负数则缓冲区不足
+ */
+int proto_encode_record(uint8_t *buf, size_t size, const proto_record_t *rec)
+{
+    if (size < PROTO_HDR_LEN + PROTO_RECORD_LEN + PROTO_CRC_LEN)
+    {
+        return -1;
+    }
+
+    proto_put_record(buf + PROTO_HDR_LEN, rec);
+
+    return proto_seal(buf, PROTO_TYPE_RECORD, PROTO_RECORD_LEN);
+}
+
+/**
+ * @name: int proto_encode_batch(uint8_t *buf, size_t size, uint32_t seq, const proto_record_t *recs, int count)
+ * @description: 把多条采样记录编码为一个批量帧
+ * @param {uint8_t} *buf 输出缓冲区
+ * @param {size_t} size 输出缓冲区大小
+ * @param {uint32_t} seq 批量帧序号，服务器提交后以ACK帧返回
+ * @param {proto_record_t} *recs 采样记录
+ * @param {int} count 记录数，不超过PROTO_BATCH_MAX
+ * @return {int} 帧长度，负数则缓冲区不足或记录数超出范围
+ */
+int proto_encode_batch(uint8_t *buf, size_t size, uint32_t seq, const proto_record_t *recs, int count)
+{
+    size_t      plen = PROTO_BATCH_HDR_LEN + (size_t)count * PROTO_RECORD_LEN;
+    int         i;
+
+    if ((count < 1) || (count > PROTO_BATCH_MAX) || (size < PROTO_HDR_LEN + plen + PROTO_CRC_LEN))
+    {
+        return -1;
+    }
+
+    proto_put_u32(buf + PROTO_HDR_LEN, seq);
+    proto_put_u16(buf + PROTO_HDR_LEN + 4, count);
+    for (i = 0; i < count; i++)
+    {
+        proto_put_record(buf + PROTO_HDR_LEN + PROTO_BATCH_HDR_LEN + i * PROTO_RECORD_LEN, &recs[i]);
+    }
+
+    return proto_seal(buf, PROTO_TYPE_BATCH, plen);
+}
+
+/**
+ * @name: int proto_encode_ack(uint8_t *buf, size_t size, uint32_t seq)
+ * @description: 编码确认帧，表示序号不大于seq的批量帧都已提交到数据库
+ * @param {uint8_t} *buf 输出缓冲区
+ * @param {size_t} size 输出缓冲区大小
+ * @param {uint32_t} seq 已提交的最后一个批量帧序号
+ * @return {int} 帧长度，负数则缓冲区不足
+ */
+int proto_encode_ack(uint8_t *buf, size_t size, uint32_t seq)
+{
+    if (size < PROTO_ACK_FRAME_LEN)
+    {
+        return -1;
+    }
+
+    proto_put_u32(buf + PROTO_HDR_LEN, seq);
+
+    return proto_seal(buf, PROTO_TYPE_ACK, 4);
+}
+
+/**
+ * @name: int proto_decode(const uint8_t *buf, size_t len, int *type, const uint8_t **payload, size_t *plen)
+ * @description: 从字节流中解出一个完整的二进制帧并校验crc
+ * @param {uint8_t} *buf 字节流
+ * @param {size_t} len 字节流长度
+ * @param {int} *type 帧类型
+ * @param {uint8_t} **payload 负载起始地址，指向buf内部
+ * @param {size_t} *plen 负载长度
+ * @return {int} 大于0为整帧长度，0为数据不足一帧，负数为帧头或crc错误
+ */
+int proto_decode(const uint8_t *buf, size_t len, int *type, const uint8_t **payload, size_t *plen)
+{
+    size_t      n;
+
+    if (len < PROTO_HDR_LEN)
+    {
+        return 0;
+    }
+
+    if (buf[0] != PROTO_MAGIC)
+    {
+        return -1;
+    }
+
+    if ((n = proto_get_u16(buf + 2)) > PROTO_MAX_PAYLOAD)
+    {
+        return -2;
+    }
+
+    if (len < PROTO_HDR_LEN + n + PROTO_CRC_LEN)
+    {
+        return 0;
+    }
+
+    if (proto_get_u16(buf + PROTO_HDR_LEN + n) != proto_crc16(buf + 1, PROTO_HDR_LEN - 1 + n))
+    {
+        return -3;
+    }
+
+    *type    = buf[1];
+    *payload = buf + PROTO_HDR_LEN;
+    *plen    = n;
+
+    return PROTO_HDR_LEN + n + PROTO_CRC_LEN;
+}
+
+/**
+ * @name: int proto_parse_device(const uint8_t *payload, size_t plen, uint16_t *dev, char *name, size_t size)
+ * @description: 解析设备注册帧负载
+ * @param {uint8_t} *payload 负载
+ * @param {size_t} plen 负载长度
+ * @param {uint16_t} *dev 设备号
+ * @param {char} *name 设备名输出缓冲区
+ * @param {size_t} size 设备名缓冲区大小
+ * @return {int} 0为正常执行，非0则负载格式错误
+ */
+int proto_parse_device(const uint8_t *payload, size_t plen, uint16_t *dev, char *name, size_t size)
+{
+    if ((plen <= 2) || (plen - 2 >= size) || memchr(payload + 2, '\0', plen - 2))
+    {
+        return -1;
+    }
+
+    *dev = proto_get_u16(payload);
+    memcpy(name, payload + 2, plen - 2);
+    name[plen - 2] = '\0';
+
+    return 0;
+}
+
+/**
+ * @name: int proto_parse_record(const uint8_t *payload, size_t plen, proto_record_t *rec)
+ * @description: 解析采样记录帧负载
+ * @param {uint8_t} *payload 负载
+ * @param {size_t} plen 负载长度
+ * @param {proto_record_t} *rec 采样记录
+ * @return {int} 0为正常执行，非0则负载格式错误
+ */
+int proto_parse_record(const uint8_t *payload, size_t plen, proto_record_t *rec)
+{
+    if (plen != PROTO_RECORD_LEN)
+    {
+        return -1;
+    }
+
+    rec->dev  = proto_get_u16(payload);
+    rec->ts   = (int64_t)proto_get_u64(payload + 2);
+    rec->temp = (int16_t)proto_get_u16(payload + 10);
+    rec->humi = proto_get_u16(payload + 12);
+
+    return 0;
+}
+
+/**
+ * @name: int proto_batch_count(const uint8_t *payload, size_t plen, uint32_t *seq)
+ * @description: 校验批量帧负载并返回记录数，第i条记录位于payload + PROTO_BATCH_HDR_LEN + i * PROTO_RECORD_LEN
+ * @param {uint8_t} *payload 负载
+ * @param {size_t} plen 负载长度
+ * @param {uint32_t} *seq 批量帧序号
+ * @return {int} 记录数，负数则负载格式错误
+ */
+int proto_batch_count(const uint8_t *payload, size_t plen, uint32_t *seq)
+{
+    int         count;
+
+    if (plen < PROTO_BATCH_HDR_LEN)
+    {
+        return -1;
+    }
+
+    *seq  = proto_get_u32(payload);
+    count = proto_get_u16(payload + 4);
+    if ((count < 1) || (plen != PROTO_BATCH_HDR_LEN + (size_t)count * PROTO_RECORD_LEN))
+    {
+        return -2;
+    }
+
+    return count;
+}
+
+/**
+ * @name: int proto_parse_ack(const uint8_t *payload, size_t plen, uint32_t *seq)
+ * @description: 解析确认帧负载
+ * @param {uint8_t} *payload 负载
+ * @param {size_t} plen 负载长度
+ * @param {uint32_t} *seq 已提交的最后一个批量帧序号
+ * @return {int} 0为正常执行，非0则负载格式错误
+ */
+int proto_parse_ack(const uint8_t *payload, size_t plen, uint32_t *seq)
+{
+    if (plen != 4)
+    {
+        return -1;
+    }
+
+    *seq = proto_get_u32(payload);
+
+    return 0;
+}
+
+/**
+ * @name: int proto_parse_hello(const char *line)
+ * @description: 解析握手行 "HELLO <版本>"
+ * @param {char} *line 去掉结束符的握手行
+ * @return {int} 版本号，负数则不是握手行
+ */
+int proto_parse_hello(const char *line)
+{
+    size_t      n = strlen(PROTO_HELLO);
+    int         version;
+
+    if (strncmp(line, PROTO_HELLO, n) || (line[n] != ' ') || (sscanf(line + n + 1, "%d", &version) != 1) || (version < 0))
+    {
+        return -1;
+    }
+
+    return version;
+}
@@ -0,0 +1,138 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:35:14
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:04:02
+ * @Description: 线程之间传递采样的有界无锁单生产者单消费者队列
+ */
+
+#include "sample_queue.h"
+
+/**
+ * @name: int sample_queue_init(sample_queue_t *queue, uint64_t capacity, int efd)
+ * @description: 初始化队列
+ * @param {sample_queue_t} *queue 队列
+ * @param {uint64_t} capacity 容量，必须为2的幂
+ * @param {int} efd 入队后写入的eventfd，-1为不通知，由生产者成批入队后自行通知
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int sample_queue_init(sample_queue_t *queue, uint64_t capacity, int efd)
+{
+    if (!queue || capacity < 2 || (capacity & (capacity - 1)))
+    {
+        log_error("The sample_queue_init() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(queue, 0, sizeof(*queue));
+    if ((queue->slots = calloc(capacity, sizeof(packinfo_t))) == NULL)
+    {
+        log_error("sample_queue_init() calloc failure: %s\n", strerror(errno));
+        return -2;
+    }
+
+    queue->mask = capacity - 1;
+    queue->efd  = efd;
+
+    return 0;
+}
+
+/**
+ * @name: void sample_queue_destroy(sample_queue_t *queue)
+ * @description: 释放队列，eventfd由调用者关闭
+ * @param {sample_queue_t} *queue 队列
+ * @return {*}
+ */
+void sample_queue_destroy(sample_queue_t *queue)
+{
+    if (!queue)
+    {
+        return;
+    }
+
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+/**
+ * @name: int sample_queue_push(sample_queue_t *queue, const packinfo_t *pack)
+ * @description: 入队，只能由生产者线程调用
+ * @param {sample_queue_t} *queue 队列
+ * @param {packinfo_t} *pack 采样
+ * @return {int} 0为入队成功，-1为队列已满，采样被丢弃
+ */
+int sample_queue_push(sample_queue_t *queue, const packinfo_t *pack)
+{
+    uint64_t    tail  = queue->tail;
+    uint64_t    head  = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    uint64_t    one   = 1;
+
+    if (tail - head > queue->mask)
+    {
+        __atomic_store_n(&queue->drops, queue->drops + 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    queue->slots[tail & queue->mask] = *pack;
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (tail + 1 - head > queue->high_water)
+    {
+        __atomic_store_n(&queue->high_water, tail + 1 - head, __ATOMIC_RELAXED);
+    }
+
+    // 采样间隔不短于一次转换时间(几十毫秒)，每次入队一次系统调用的开销可以忽略
+    if ((queue->efd >= 0) && (write(queue->efd, &one, sizeof(one)) < 0) && (errno != EAGAIN))
+    {
+        log_error("sample_queue_push() write eventfd failure: %s\n", strerror(errno));
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int sample_queue_pop(sample_queue_t *queue, packinfo_t *pack)
+ * @description: 出队，只能由消费者线程调用
+ * @param {sample_queue_t} *queue 队列
+ * @param {packinfo_t} *pack 采样
+ * @return {int} 1为取到数据，0为队列为空
+ */
+int sample_queue_pop(sample_queue_t *queue, packinfo_t *pack)
+{
+    uint64_t    head = queue->head;
+
+    if (__atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) == head)
+    {
+        return 0;
+    }
+
+    *pack = queue->slots[head & queue->mask];
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/**
+ * @name: uint64_t sample_queue_depth(sample_queue_t *queue)
+ * @description: 当前队列深度(近似值)，任何线程都可以调用
+ * @param {sample_queue_t} *queue 队列
+ * @return {uint64_t} 队列中的采样数
+ */
+uint64_t sample_queue_depth(sample_queue_t *queue)
+{
+    uint64_t    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    uint64_t    tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    return tail > head ? tail - head : 0;
+}
+
+/**
+ * @name: uint64_t sample_queue_space(sample_queue_t *queue)
+ * @description: 剩余空间，生产者据此决定是否入队，消费者并发出队时只会变大
+ * @param {sample_queue_t} *queue 队列
+ * @return {uint64_t} 还能入队的采样数
+ */
+uint64_t sample_queue_space(sample_queue_t *queue)
+{
+    return queue->mask + 1 - sample_queue_depth(queue);
+}
@@ -0,0 +1,132 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:20:00
+ * @Description: 内存中的采样环形缓冲区
+ */
+
+#include "sample_ring.h"
+
+/**
+ * @name: int sample_ring_init(sample_ring_t *ring, int size)
+ * @description: 分配环形缓冲区
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @param {int} size 容量(条)
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int sample_ring_init(sample_ring_t *ring, int size)
+{
+    if ((ring == NULL) || (size < 1) || (size > SAMPLE_RING_MAX))
+    {
+        return -1;
+    }
+
+    if ((ring->slots = calloc(size, sizeof(packinfo_t))) == NULL)
+    {
+        return -2;
+    }
+
+    ring->size = size;
+    ring->head = 1;
+    ring->tail = 1;
+    return 0;
+}
+
+/**
+ * @name: void sample_ring_free(sample_ring_t *ring)
+ * @description: 释放环形缓冲区
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @return {*}
+ */
+void sample_ring_free(sample_ring_t *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+    ring->head  = ring->tail;
+}
+
+/**
+ * @name: int sample_ring_count(sample_ring_t *ring)
+ * @description: 缓冲区中的记录数
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @return {int} 记录数
+ */
+int sample_ring_count(sample_ring_t *ring)
+{
+    return (int)(ring->tail - ring->head);
+}
+
+/**
+ * @name: int sample_ring_space(sample_ring_t *ring)
+ * @description: 缓冲区的空闲条数
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @return {int} 空闲条数
+ */
+int sample_ring_space(sample_ring_t *ring)
+{
+    return ring->size - sample_ring_count(ring);
+}
+
+/**
+ * @name: int sample_ring_push(sample_ring_t *ring, const packinfo_t *pack_info)
+ * @description: 在末尾追加一条记录
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @param {packinfo_t} *pack_info 记录
+ * @return {int} 0为正常执行，-1为缓冲区已满
+ */
+int sample_ring_push(sample_ring_t *ring, const packinfo_t *pack_info)
+{
+    if (sample_ring_space(ring) == 0)
+    {
+        return -1;
+    }
+
+    ring->slots[ring->tail % ring->size] = *pack_info;
+    ring->tail++;
+    return 0;
+}
+
+/**
+ * @name: int sample_ring_peek(sample_ring_t *ring, int64_t after, packinfo_t *pack_info, int max_rows, int64_t *last)
+ * @description: 复制位置大于after的最多max_rows条记录，记录仍留在缓冲区中直到被确认
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @param {int64_t} after 已发送的最后一条记录的位置，0为从最早一条开始
+ * @param {packinfo_t} *pack_info 记录数组
+ * @param {int} max_rows 最多复制的条数
+ * @param {int64_t} *last 复制的最后一条记录的位置
+ * @return {int} 复制的条数
+ */
+int sample_ring_peek(sample_ring_t *ring, int64_t after, packinfo_t *pack_info, int max_rows, int64_t *last)
+{
+    int64_t         pos = after + 1 > ring->head ? after + 1 : ring->head;
+    int             rows = 0;
+
+    for (; (pos < ring->tail) && (rows < max_rows); pos++, rows++)
+    {
+        pack_info[rows] = ring->slots[pos % ring->size];
+    }
+
+    *last = pos - 1;
+    return rows;
+}
+
+/**
+ * @name: void sample_ring_release(sample_ring_t *ring, int64_t upto)
+ * @description: 丢弃位置不大于upto的记录
+ * @param {sample_ring_t} *ring 环形缓冲区
+ * @param {int64_t} upto 已送达的最后一条记录的位置
+ * @return {*}
+ */
+void sample_ring_release(sample_ring_t *ring, int64_t upto)
+{
+    if (upto >= ring->tail)
+    {
+        upto = ring->tail - 1;
+    }
+
+    if (upto >= ring->head)
+    {
+        ring->head = upto + 1;
+    }
+}
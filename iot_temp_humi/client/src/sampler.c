@@ -0,0 +1,534 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:35:14
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:04:02
+ * @Description: 多传感器采样，每条i2c总线一个采样线程，各总线并行，同一总线上的器件依次测量
+ */
+
+#include "sampler.h"
+
+/**
+ * @name: static long long sampler_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
+ */
+static long long sampler_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static int sampler_wait(sampler_t *sampler, long long ms)
+ * @description: 采样线程等待ms毫秒，期间收到停止通知时提前返回
+ * @param {sampler_t} *sampler 采样器
+ * @param {long long} ms 等待时间，小于等于0时只检查停止通知
+ * @return {int} 1为需要退出，0为等待结束
+ */
+static int sampler_wait(sampler_t *sampler, long long ms)
+{
+    struct pollfd   pfd;
+
+    pfd.fd     = sampler->stop_efd;
+    pfd.events = POLLIN;
+
+    // 停止通知的eventfd不会被读走，写入后所有线程都能看到
+    while (poll(&pfd, 1, ms > 0 ? (int)ms : 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return 1;
+        }
+    }
+
+    return (pfd.revents & POLLIN) ? 1 : 0;
+}
+
+/**
+ * @name: static void sampler_measure(sampler_bus_t *bus, sampler_sensor_t *s)
+ * @description: 测量一个器件，成功时把采样放入本总线的队列，转换期间线程睡眠，总线上没有其他传输
+ *               下游的落盘和发送再慢也只会让队列变满，不会推迟采样时刻
+ * @param {sampler_bus_t} *bus 总线
+ * @param {sampler_sensor_t} *s 器件
+ * @return {*}
+ */
+static void sampler_measure(sampler_bus_t *bus, sampler_sensor_t *s)
+{
+    packinfo_t      pack_info;
+    char            datime[128];
+    int64_t         ts;
+    int             rv;
+
+    // 采样时间取触发转换的时刻，精确到毫秒，周期小于1秒时同一设备的采样也不会重复
+    ts = get_time_ms(datime);
+
+    for (rv = sht2x_trigger(&s->sensor, &s->meas); (rv >= 0) && (s->meas.state != SHT2X_IDLE); rv = sht2x_collect(&s->sensor, &s->meas))
+    {
+        if (sampler_wait(bus->sampler, rv))
+        {
+            s->meas.state = SHT2X_IDLE;
+            return;
+        }
+    }
+
+    if (rv < 0)
+    {
+        s->failures++;
+        log_error("%s sht2x get temp and humidity failed: %s (%u CRC error(s), %u retries so far)\n",
+                  s->devid, strerror(errno), s->meas.crc_errors, s->meas.retries);
+        return;
+    }
+    if (s->meas.attempts > 0)
+    {
+        log_warn("%s sample recovered after %d retries (%u CRC error(s), %u retries so far)\n",
+                 s->devid, s->meas.attempts, s->meas.crc_errors, s->meas.retries);
+    }
+
+    memset(&pack_info, 0, sizeof(pack_info));
+    snprintf(pack_info.devid, sizeof(pack_info.devid), "%s", s->devid);
+    snprintf(pack_info.time, sizeof(pack_info.time), "%.*s", (int)sizeof(pack_info.time) - 1, datime);
+    pack_info.ts   = ts;
+    pack_info.temp = s->meas.temp;
+    pack_info.humi = s->meas.rh;
+    s->samples++;
+
+    if (sample_queue_push(&bus->queue, &pack_info) < 0)
+    {
+        log_error("%s sample queue of %s full, sample dropped\n", s->devid, bus->bus);
+    }
+}
+
+/**
+ * @name: static void *sampler_thread(void *arg)
+ * @description: 采样线程主循环，按各器件的周期依次测量本总线上到期的器件
+ * @param {void} *arg 总线
+ * @return {*}
+ */
+static void *sampler_thread(void *arg)
+{
+    sampler_bus_t      *bus     = (sampler_bus_t *)arg;
+    sampler_t          *sampler = bus->sampler;
+    sampler_sensor_t   *s;
+    sampler_sensor_t   *due;
+    sigset_t            sigmask;
+    long long           now;
+    long long           behind;
+    int                 i;
+
+    // 停止信号只由主线程处理
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, SIGINT);
+    sigaddset(&sigmask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+
+    log_info("sampler thread of %s running, %d sensor(s)\n", bus->bus, bus->count);
+
+    // 启动后立即采样一次
+    now = sampler_now_ms();
+    for (i = 0; i < bus->count; i++)
+    {
+        sampler->sensors[bus->sensors[i]].next_ms = now;
+    }
+
+    while (1)
+    {
+        // 取最早到期的器件，绝对时刻的周期不随测量耗时漂移
+        due = &sampler->sensors[bus->sensors[0]];
+        for (i = 1; i < bus->count; i++)
+        {
+            s = &sampler->sensors[bus->sensors[i]];
+            if (s->next_ms < due->next_ms)
+            {
+                due = s;
+            }
+        }
+
+        if (sampler_wait(sampler, due->next_ms - sampler_now_ms()))
+        {
+            break;
+        }
+        if (sampler_now_ms() < due->next_ms)
+        {
+            continue;
+        }
+
+        if ((now = sampler_now_ms() - due->next_ms) > due->max_late_ms)
+        {
+            due->max_late_ms = now;
+        }
+        sampler_measure(bus, due);
+
+        // 同一总线上的器件太多或周期太短时跳过已经错过的周期
+        due->next_ms += due->period_ms;
+        if ((behind = sampler_now_ms() - due->next_ms) >= 0)
+        {
+            behind = behind / due->period_ms + 1;
+            due->next_ms += behind * due->period_ms;
+            due->skipped += behind;
+            log_warn("%s sampling on %s fell behind, %lld period(s) skipped\n", due->devid, bus->bus, behind);
+        }
+    }
+
+    log_info("sampler thread of %s exit\n", bus->bus);
+    return NULL;
+}
+
+/**
+ * @name: int sampler_init(sampler_t *sampler)
+ * @description: 初始化采样器，传感器表为空
+ * @param {sampler_t} *sampler 采样器
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int sampler_init(sampler_t *sampler)
+{
+    if (!sampler)
+    {
+        log_error("The sampler_init() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->stop_efd = -1;
+    if (((sampler->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+        || ((sampler->stop_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0))
+    {
+        log_error("sampler_init() eventfd failure: %s\n", strerror(errno));
+        if (sampler->efd >= 0)
+        {
+            close(sampler->efd);
+        }
+        return -2;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int sampler_add(sampler_t *sampler, const char *devid, const char *spec, int period_ms)
+ * @description: 向传感器表添加一个器件，sampler_start()时才打开
+ * @param {sampler_t} *sampler 采样器
+ * @param {char} *devid 设备id
+ * @param {char} *spec 传感器后端配置
+ * @param {int} period_ms 采样周期(ms)，不能短于一次采样的转换时间，sampler_start()时检查
+ * @return {int} 0为正常执行，-1为参数错误或表已满
+ */
+int sampler_add(sampler_t *sampler, const char *devid, const char *spec, int period_ms)
+{
+    sampler_sensor_t   *s;
+
+    if (!sampler || !devid || !spec || (period_ms <= 0) || (strlen(devid) >= DEVID_LEN)
+        || (strlen(spec) >= SAMPLER_SPEC_LEN) || (sampler->count >= SAMPLER_MAX_SENSORS))
+    {
+        log_error("Invalid sensor %s: %s period %d ms\n", devid ? devid : "", spec ? spec : "", period_ms);
+        return -1;
+    }
+
+    s = &sampler->sensors[sampler->count++];
+    memset(s, 0, sizeof(*s));
+    strcpy(s->devid, devid);
+    strcpy(s->spec, spec);
+    s->period_ms = period_ms;
+
+    return 0;
+}
+
+/**
+ * @name: int sampler_load(sampler_t *sampler, const char *path)
+ * @description: 读取传感器表，格式见sampler.h
+ * @param {sampler_t} *sampler 采样器
+ * @param {char} *path 传感器表文件
+ * @return {int} 0为正常执行，-1为文件格式错误，-2为打开文件失败
+ */
+int sampler_load(sampler_t *sampler, const char *path)
+{
+    FILE   *fp;
+    char    line[256];
+    char    devid[64];
+    char    spec[SAMPLER_SPEC_LEN * 2];
+    double  period;
+    int     lineno = 0;
+    int     rv     = 0;
+
+    if ((fp = fopen(path, "r")) == NULL)
+    {
+        log_error("open sensor table %s failed: %s\n", path, strerror(errno));
+        return -2;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        if ((sscanf(line, " %63s", devid) != 1) || (devid[0] == '#'))
+        {
+            continue;
+        }
+
+        if ((sscanf(line, " %63s %lf %255s", devid, &period, spec) != 3)
+            || (sampler_add(sampler, devid, spec, (int)(period * 1000)) < 0))
+        {
+            log_error("sensor table %s line %d invalid: %s\n", path, lineno, line);
+            rv = -1;
+            break;
+        }
+    }
+    fclose(fp);
+
+    if ((rv == 0) && (sampler->count == 0))
+    {
+        log_error("sensor table %s is empty\n", path);
+        rv = -1;
+    }
+
+    return rv;
+}
+
+/**
+ * @name: static int sampler_bus(sampler_t *sampler, const char *name)
+ * @description: 找到器件所在的总线，没有时新建
+ * @param {sampler_t} *sampler 采样器
+ * @param {char} *name i2c总线设备
+ * @return {int} 总线下标，-1为总线数超过上限
+ */
+static int sampler_bus(sampler_t *sampler, const char *name)
+{
+    int     i;
+
+    for (i = 0; i < sampler->nbus; i++)
+    {
+        if (!strcmp(sampler->buses[i].bus, name))
+        {
+            return i;
+        }
+    }
+
+    if (sampler->nbus >= SAMPLER_MAX_BUSES)
+    {
+        log_error("too many i2c buses, at most %d\n", SAMPLER_MAX_BUSES);
+        return -1;
+    }
+
+    snprintf(sampler->buses[i].bus, sizeof(sampler->buses[i].bus), "%s", name);
+    sampler->buses[i].count   = 0;
+    sampler->buses[i].sampler = sampler;
+    return sampler->nbus++;
+}
+
+/**
+ * @name: int sampler_start(sampler_t *sampler, int mode, int resolution)
+ * @description: 打开传感器表中的所有器件，按总线分组，每条总线启动一个采样线程
+ * @param {sampler_t} *sampler 采样器
+ * @param {int} mode enum SHT2X_MODE
+ * @param {int} resolution enum SHT2X_RESOLUTION
+ * @return {int} 0为正常执行，-1为传感器配置错误，其他负数为打开器件或启动线程失败
+ */
+int sampler_start(sampler_t *sampler, int mode, int resolution)
+{
+    sampler_sensor_t   *s;
+    sampler_bus_t      *bus;
+    uint64_t            one     = 1;
+    int                 opened  = 0;
+    int                 started = 0;
+    int                 rv      = 0;
+    int                 i;
+
+    // 周期短于一次采样的最长转换时间时每个周期都会被跳过，按配置错误处理
+    for (i = 0; i < sampler->count; i++)
+    {
+        if (sampler->sensors[i].period_ms < sht2x_meas_time(resolution))
+        {
+            log_error("%s period %d ms is shorter than the %d ms conversion time\n",
+                      sampler->sensors[i].devid, sampler->sensors[i].period_ms, sht2x_meas_time(resolution));
+            return -1;
+        }
+    }
+
+    for (opened = 0; (rv == 0) && (opened < sampler->count); opened++)
+    {
+        s = &sampler->sensors[opened];
+        s->meas.mode       = mode;
+        s->meas.resolution = resolution;
+
+        // 软复位后用户寄存器回到默认分辨率，非默认时再写入
+        if ((rv = sht2x_init(&s->sensor, s->spec)) < 0)
+        {
+            log_error("%s sht2x initialize failed!\n", s->devid);
+            break;
+        }
+        if ((resolution != SHT2X_RES_14_12) && (sht2x_set_resolution(&s->sensor, resolution) < 0))
+        {
+            log_error("%s sht2x set resolution failed!\n", s->devid);
+            sensor_close(&s->sensor);
+            rv = -5;
+            break;
+        }
+
+        if ((i = sampler_bus(sampler, s->sensor.bus)) < 0)
+        {
+            sensor_close(&s->sensor);
+            rv = -6;
+            break;
+        }
+        bus = &sampler->buses[i];
+        bus->sensors[bus->count++] = opened;
+    }
+
+    for (i = 0; (rv == 0) && (i < sampler->nbus); i++)
+    {
+        if (sample_queue_init(&sampler->buses[i].queue, SAMPLE_QUEUE_SIZE, sampler->efd) < 0)
+        {
+            rv = -7;
+        }
+    }
+
+    for (started = 0; (rv == 0) && (started < sampler->nbus); started++)
+    {
+        if (pthread_create(&sampler->buses[started].tid, NULL, sampler_thread, &sampler->buses[started]) != 0)
+        {
+            log_error("create sampler thread failure\n");
+            rv = -8;
+            break;
+        }
+    }
+
+    if (rv < 0)
+    {
+        // 回收已经启动的线程、已经打开的器件和队列
+        if (write(sampler->stop_efd, &one, sizeof(one)) < 0)
+        {
+            log_error("sampler_start() write eventfd failure: %s\n", strerror(errno));
+        }
+        for (i = 0; i < started; i++)
+        {
+            pthread_join(sampler->buses[i].tid, NULL);
+            sampler->buses[i].tid = 0;
+        }
+        for (i = 0; i < opened; i++)
+        {
+            sensor_close(&sampler->sensors[i].sensor);
+        }
+        for (i = 0; i < sampler->nbus; i++)
+        {
+            sample_queue_destroy(&sampler->buses[i].queue);
+            sampler->buses[i].count = 0;
+        }
+        return rv;
+    }
+
+    log_info("sampler started, %d sensor(s) on %d bus(es)\n", sampler->count, sampler->nbus);
+    return 0;
+}
+
+/**
+ * @name: int sampler_pop(sampler_t *sampler, packinfo_t *pack)
+ * @description: 消费者线程取出一条采样，各总线的队列轮流出队
+ * @param {sampler_t} *sampler 采样器
+ * @param {packinfo_t} *pack 采样
+ * @return {int} 1为取到数据，0为所有队列为空
+ */
+int sampler_pop(sampler_t *sampler, packinfo_t *pack)
+{
+    int     i;
+    int     n;
+
+    for (i = 0; i < sampler->nbus; i++)
+    {
+        n = (sampler->next_bus + i) % sampler->nbus;
+        if (sampler->buses[n].queue.slots && sample_queue_pop(&sampler->buses[n].queue, pack))
+        {
+            sampler->next_bus = (n + 1) % sampler->nbus;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @name: uint64_t sampler_depth(sampler_t *sampler)
+ * @description: 所有总线队列中等待取出的采样数(近似值)，任何线程都可以调用
+ * @param {sampler_t} *sampler 采样器
+ * @return {uint64_t} 采样数
+ */
+uint64_t sampler_depth(sampler_t *sampler)
+{
+    uint64_t    depth = 0;
+    int         i;
+
+    for (i = 0; i < sampler->nbus; i++)
+    {
+        if (sampler->buses[i].queue.slots)
+        {
+            depth += sample_queue_depth(&sampler->buses[i].queue);
+        }
+    }
+
+    return depth;
+}
+
+/**
+ * @name: void sampler_stop(sampler_t *sampler)
+ * @description: 通知采样线程退出并等待，关闭器件，在日志中输出每个器件和每条总线的统计
+ *               队列中剩余的采样仍可以用sampler_pop()取出
+ * @param {sampler_t} *sampler 采样器
+ * @return {*}
+ */
+void sampler_stop(sampler_t *sampler)
+{
+    sampler_sensor_t   *s;
+    sampler_bus_t      *bus;
+    uint64_t            one = 1;
+    int                 i, j;
+
+    if (write(sampler->stop_efd, &one, sizeof(one)) < 0)
+    {
+        log_error("sampler_stop() write eventfd failure: %s\n", strerror(errno));
+    }
+
+    for (i = 0; i < sampler->nbus; i++)
+    {
+        bus = &sampler->buses[i];
+        if (bus->tid)
+        {
+            pthread_join(bus->tid, NULL);
+            bus->tid = 0;
+        }
+
+        for (j = 0; j < bus->count; j++)
+        {
+            s = &sampler->sensors[bus->sensors[j]];
+            log_info("%s on %s: %llu sample(s), %llu failure(s), %llu skipped period(s), max %lld ms late, %u CRC error(s), %u retries\n",
+                     s->devid, bus->bus, (unsigned long long)s->samples, (unsigned long long)s->failures,
+                     (unsigned long long)s->skipped, s->max_late_ms, s->meas.crc_errors, s->meas.retries);
+            sensor_close(&s->sensor);
+        }
+        bus->count = 0;
+
+        if (bus->queue.slots)
+        {
+            log_info("sample queue of %s: high water %llu, %llu dropped\n", bus->bus,
+                     (unsigned long long)bus->queue.high_water, (unsigned long long)bus->queue.drops);
+        }
+    }
+}
+
+/**
+ * @name: void sampler_free(sampler_t *sampler)
+ * @description: 释放队列和eventfd，在sampler_stop()之后调用
+ * @param {sampler_t} *sampler 采样器
+ * @return {*}
+ */
+void sampler_free(sampler_t *sampler)
+{
+    int     i;
+
+    for (i = 0; i < sampler->nbus; i++)
+    {
+        sample_queue_destroy(&sampler->buses[i].queue);
+    }
+    close(sampler->efd);
+    close(sampler->stop_efd);
+}
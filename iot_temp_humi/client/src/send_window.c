@@ -0,0 +1,137 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:40:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:56:45
+ * @Description: 缓存数据的发送窗口
+ */
+
+#include "send_window.h"
+
+/**
+ * @name: static long long send_window_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
+ */
+static long long send_window_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: int send_window_init(send_window_t *win, int size)
+ * @description: 初始化发送窗口
+ * @param {send_window_t} *win 发送窗口
+ * @param {int} size 最多在途的批量帧数，1为发一帧等一次确认
+ * @return {int} 0为正常执行，非0则参数错误
+ */
+int send_window_init(send_window_t *win, int size)
+{
+    if ((win == NULL) || (size < 1) || (size > SEND_WINDOW_MAX))
+    {
+        return -1;
+    }
+
+    win->size = size;
+    send_window_reset(win);
+    return 0;
+}
+
+/**
+ * @name: void send_window_reset(send_window_t *win)
+ * @description: 清空窗口，连接断开后未确认的行仍在数据库中，新连接从头重发，序号从1开始
+ * @param {send_window_t} *win 发送窗口
+ * @return {*}
+ */
+void send_window_reset(send_window_t *win)
+{
+    win->head     = 0;
+    win->count    = 0;
+    win->next_seq = 1;
+    win->cursor   = 0;
+}
+
+/**
+ * @name: int send_window_full(send_window_t *win)
+ * @description: 在途的批量帧是否已达到窗口大小
+ * @param {send_window_t} *win 发送窗口
+ * @return {int} 1为已满，0为还可以发送
+ */
+int send_window_full(send_window_t *win)
+{
+    return win->count >= win->size;
+}
+
+/**
+ * @name: uint32_t send_window_push(send_window_t *win, int64_t last_pos)
+ * @description: 记录一个已发送的批量帧，调用前确认窗口未满
+ * @param {send_window_t} *win 发送窗口
+ * @param {int64_t} last_pos 帧中最后一条记录的位置
+ * @return {uint32_t} 该帧使用的序号
+ */
+uint32_t send_window_push(send_window_t *win, int64_t last_pos)
+{
+    send_inflight_t *slot = &win->inflight[(win->head + win->count) % SEND_WINDOW_MAX];
+
+    slot->seq        = win->next_seq++;
+    slot->last_pos   = last_pos;
+    slot->sent_ms    = send_window_now_ms();
+    win->count++;
+    win->cursor      = last_pos;
+
+    return slot->seq;
+}
+
+/**
+ * @name: int64_t send_window_ack(send_window_t *win, uint32_t seq)
+ * @description: 处理累计确认，移出序号不大于seq的批量帧
+ *               窗口清空时已发送的记录都已确认并释放，cursor归零，之后从最早一条未确认的记录读取
+ * @param {send_window_t} *win 发送窗口
+ * @param {uint32_t} seq 确认的序号
+ * @return {int64_t} 可以释放到的位置，-1为没有新确认的帧
+ */
+int64_t send_window_ack(send_window_t *win, uint32_t seq)
+{
+    send_inflight_t *slot;
+    int64_t          pos = -1;
+
+    while (win->count > 0)
+    {
+        slot = &win->inflight[win->head];
+        if ((int32_t)(seq - slot->seq) < 0)
+        {
+            break;
+        }
+
+        pos       = slot->last_pos;
+        win->head = (win->head + 1) % SEND_WINDOW_MAX;
+        win->count--;
+    }
+
+    if (win->count == 0)
+    {
+        win->cursor = 0;
+    }
+
+    return pos;
+}
+
+/**
+ * @name: int send_window_expired(send_window_t *win, int timeout_ms)
+ * @description: 最早的在途批量帧是否等待确认超时
+ * @param {send_window_t} *win 发送窗口
+ * @param {int} timeout_ms 超时(ms)
+ * @return {int} 1为已超时，0为未超时或没有在途的帧
+ */
+int send_window_expired(send_window_t *win, int timeout_ms)
+{
+    if (win->count == 0)
+    {
+        return 0;
+    }
+
+    return send_window_now_ms() - win->inflight[win->head].sent_ms >= timeout_ms;
+}
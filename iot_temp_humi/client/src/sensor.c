@@ -0,0 +1,367 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 22:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:22:00
+ * @Description: 传感器总线抽象层和两种i2c用户空间驱动后端(I2C_RDWR ioctl、read/write)
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "sensor.h"
+#include "logger.h"
+
+/**
+ * @name: static int sensor_i2c_open(sensor_t *sensor)
+ * @description: 打开i2c总线设备
+ * @param {sensor_t} *sensor 传感器
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int sensor_i2c_open(sensor_t *sensor)
+{
+    if ((sensor->fd = open(sensor->bus, O_RDWR | O_CLOEXEC)) < 0)
+    {
+        log_error("i2c device %s open failed: %s\n", sensor->bus, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static void sensor_i2c_close(sensor_t *sensor)
+ * @description: 关闭i2c总线设备
+ * @param {sensor_t} *sensor 传感器
+ * @return {*}
+ */
+static void sensor_i2c_close(sensor_t *sensor)
+{
+    if (sensor->fd >= 0)
+    {
+        close(sensor->fd);
+        sensor->fd = -1;
+    }
+}
+
+/**
+ * @name: static int sensor_rdwr_transfer(sensor_t *sensor, uint16_t flags, uint8_t *buf, int len)
+ * @description: 用一条ioctl(I2C_RDWR)完成一次读或写
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint16_t} flags 0为写，I2C_M_RD为读
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 传输的字节数，-1则出现错误
+ */
+static int sensor_rdwr_transfer(sensor_t *sensor, uint16_t flags, uint8_t *buf, int len)
+{
+    struct i2c_msg              msg;
+    struct i2c_rdwr_ioctl_data  data;
+
+    msg.addr  = sensor->addr;
+    msg.flags = flags;
+    msg.len   = len;
+    msg.buf   = buf;
+
+    data.msgs  = &msg;
+    data.nmsgs = 1;
+
+    return ioctl(sensor->fd, I2C_RDWR, &data) < 0 ? -1 : len;
+}
+
+/**
+ * @name: static int sensor_rdwr_write(sensor_t *sensor, const uint8_t *buf, int len)
+ * @description: I2C_RDWR写
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 写入的字节数，-1则出现错误
+ */
+static int sensor_rdwr_write(sensor_t *sensor, const uint8_t *buf, int len)
+{
+    return sensor_rdwr_transfer(sensor, 0, (uint8_t *)buf, len);
+}
+
+/**
+ * @name: static int sensor_rdwr_read(sensor_t *sensor, uint8_t *buf, int len)
+ * @description: I2C_RDWR读
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 读取的字节数，-1则出现错误
+ */
+static int sensor_rdwr_read(sensor_t *sensor, uint8_t *buf, int len)
+{
+    return sensor_rdwr_transfer(sensor, I2C_M_RD, buf, len);
+}
+
+/**
+ * @name: static int sensor_rdwr_combined(sensor_t *sensor, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen)
+ * @description: 写和读放在同一条ioctl(I2C_RDWR)中，中间是重复起始条件，器件拉低SCL时内核一直等待
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *wbuf 写入的数据
+ * @param {int} wlen 写入长度
+ * @param {uint8_t} *rbuf 读出的数据
+ * @param {int} rlen 读出长度
+ * @return {int} 读取的字节数，-1则出现错误
+ */
+static int sensor_rdwr_combined(sensor_t *sensor, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen)
+{
+    struct i2c_msg              msgs[2];
+    struct i2c_rdwr_ioctl_data  data;
+
+    msgs[0].addr  = sensor->addr;
+    msgs[0].flags = 0;
+    msgs[0].len   = wlen;
+    msgs[0].buf   = (uint8_t *)wbuf;
+
+    msgs[1].addr  = sensor->addr;
+    msgs[1].flags = I2C_M_RD;
+    msgs[1].len   = rlen;
+    msgs[1].buf   = rbuf;
+
+    data.msgs  = msgs;
+    data.nmsgs = 2;
+
+    return ioctl(sensor->fd, I2C_RDWR, &data) < 0 ? -1 : rlen;
+}
+
+/**
+ * @name: static int sensor_rw_open(sensor_t *sensor)
+ * @description: 打开i2c总线设备，设置7位地址和从机地址，之后直接read()/write()
+ * @param {sensor_t} *sensor 传感器
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int sensor_rw_open(sensor_t *sensor)
+{
+    if (sensor_i2c_open(sensor) < 0)
+    {
+        return -1;
+    }
+
+    if ((ioctl(sensor->fd, I2C_TENBIT, 0) < 0) || (ioctl(sensor->fd, I2C_SLAVE, sensor->addr) < 0))
+    {
+        log_error("i2c device %s set slave address 0x%02x failed: %s\n", sensor->bus, sensor->addr, strerror(errno));
+        sensor_i2c_close(sensor);
+        return -2;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static int sensor_rw_write(sensor_t *sensor, const uint8_t *buf, int len)
+ * @description: write()写
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 写入的字节数，-1则出现错误
+ */
+static int sensor_rw_write(sensor_t *sensor, const uint8_t *buf, int len)
+{
+    return write(sensor->fd, buf, len) == len ? len : -1;
+}
+
+/**
+ * @name: static int sensor_rw_read(sensor_t *sensor, uint8_t *buf, int len)
+ * @description: read()读
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 读取的字节数，-1则出现错误
+ */
+static int sensor_rw_read(sensor_t *sensor, uint8_t *buf, int len)
+{
+    return read(sensor->fd, buf, len) == len ? len : -1;
+}
+
+static const sensor_ops_t sensor_rdwr_ops =
+{
+    .name       = "i2c-rdwr",
+    .open       = sensor_i2c_open,
+    .write      = sensor_rdwr_write,
+    .read       = sensor_rdwr_read,
+    .transfer   = sensor_rdwr_combined,
+    .close      = sensor_i2c_close,
+};
+
+static const sensor_ops_t sensor_rw_ops =
+{
+    .name       = "i2c-rw",
+    .open       = sensor_rw_open,
+    .write      = sensor_rw_write,
+    .read       = sensor_rw_read,
+    .close      = sensor_i2c_close,
+};
+
+static const sensor_ops_t *sensor_backends[] =
+{
+    &sensor_rdwr_ops,
+    &sensor_rw_ops,
+    &sensor_sim_ops,
+};
+
+/**
+ * @name: int sensor_open(sensor_t *sensor, const char *spec, uint16_t addr)
+ * @description: 解析后端配置并打开传感器，格式为 后端名[,key=value...]
+ *               所有后端都接受bus和addr，其余的键交给后端解析
+ * @param {sensor_t} *sensor 传感器
+ * @param {char} *spec 配置字符串
+ * @param {uint16_t} addr 默认器件地址
+ * @return {int} 0为正常执行，-1为配置错误，其他负数为打开失败
+ */
+int sensor_open(sensor_t *sensor, const char *spec, uint16_t addr)
+{
+    char            buf[256];
+    char           *token;
+    char           *saveptr = NULL;
+    char           *value;
+    char           *end;
+    int             i;
+
+    memset(sensor, 0, sizeof(*sensor));
+    sensor->fd   = -1;
+    sensor->addr = addr;
+    snprintf(sensor->bus, sizeof(sensor->bus), "%s", SENSOR_I2C_BUS);
+
+    if ((spec == NULL) || (strlen(spec) >= sizeof(buf)))
+    {
+        log_error("The sensor_open() argument incorrect!\n");
+        return -1;
+    }
+
+    strcpy(buf, spec);
+    token = strtok_r(buf, ",", &saveptr);
+    for (i = 0; i < sizeof(sensor_backends) / sizeof(sensor_backends[0]); i++)
+    {
+        if (token && !strcasecmp(token, sensor_backends[i]->name))
+        {
+            sensor->ops = sensor_backends[i];
+            break;
+        }
+    }
+    if (sensor->ops == NULL)
+    {
+        log_error("Unknown sensor backend: %s\n", token ? token : "");
+        return -1;
+    }
+
+    if (sensor->ops->init && (sensor->ops->init(sensor) < 0))
+    {
+        return -2;
+    }
+
+    while ((token = strtok_r(NULL, ",", &saveptr)) != NULL)
+    {
+        if ((value = strchr(token, '=')) == NULL)
+        {
+            log_error("Sensor option '%s' is not key=value\n", token);
+            sensor_close(sensor);
+            return -1;
+        }
+        *value++ = '\0';
+
+        if (!strcasecmp(token, "bus"))
+        {
+            snprintf(sensor->bus, sizeof(sensor->bus), "%s", value);
+        }
+        else if (!strcasecmp(token, "addr"))
+        {
+            sensor->addr = strtol(value, &end, 0);
+            if ((*end != '\0') || (sensor->addr > 0x7F))
+            {
+                log_error("Invalid sensor address: %s\n", value);
+                sensor_close(sensor);
+                return -1;
+            }
+        }
+        else if (!sensor->ops->option || (sensor->ops->option(sensor, token, value) < 0))
+        {
+            log_error("Unknown sensor option: %s=%s\n", token, value);
+            sensor_close(sensor);
+            return -1;
+        }
+    }
+
+    if (sensor->ops->open(sensor) < 0)
+    {
+        sensor_close(sensor);
+        return -3;
+    }
+
+    log_info("Opened sensor %s on %s address 0x%02x\n", sensor->ops->name, sensor->bus, sensor->addr);
+    return 0;
+}
+
+/**
+ * @name: int sensor_write(sensor_t *sensor, const uint8_t *buf, int len)
+ * @description: 向器件写len字节
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 写入的字节数，-1则出现错误，errno为ENXIO时器件未应答
+ */
+int sensor_write(sensor_t *sensor, const uint8_t *buf, int len)
+{
+    return sensor->ops->write(sensor, buf, len);
+}
+
+/**
+ * @name: int sensor_read(sensor_t *sensor, uint8_t *buf, int len)
+ * @description: 从器件读len字节
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 读取的字节数，-1则出现错误，errno为ENXIO时器件未应答
+ */
+int sensor_read(sensor_t *sensor, uint8_t *buf, int len)
+{
+    return sensor->ops->read(sensor, buf, len);
+}
+
+/**
+ * @name: int sensor_transfer(sensor_t *sensor, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen)
+ * @description: 写命令后读出应答，后端支持时在一次总线事务中完成，否则依次写和读
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *wbuf 写入的数据
+ * @param {int} wlen 写入长度
+ * @param {uint8_t} *rbuf 读出的数据
+ * @param {int} rlen 读出长度
+ * @return {int} 读取的字节数，-1则出现错误，errno为ENXIO时器件未应答
+ */
+int sensor_transfer(sensor_t *sensor, const uint8_t *wbuf, int wlen, uint8_t *rbuf, int rlen)
+{
+    if (sensor->ops->transfer)
+    {
+        return sensor->ops->transfer(sensor, wbuf, wlen, rbuf, rlen);
+    }
+
+    if (sensor->ops->write(sensor, wbuf, wlen) < 0)
+    {
+        return -1;
+    }
+
+    return sensor->ops->read(sensor, rbuf, rlen);
+}
+
+/**
+ * @name: void sensor_close(sensor_t *sensor)
+ * @description: 关闭传感器，释放后端私有数据
+ * @param {sensor_t} *sensor 传感器
+ * @return {*}
+ */
+void sensor_close(sensor_t *sensor)
+{
+    if (sensor->ops && sensor->ops->close)
+    {
+        sensor->ops->close(sensor);
+    }
+
+    free(sensor->priv);
+    sensor->priv = NULL;
+    sensor->ops  = NULL;
+}
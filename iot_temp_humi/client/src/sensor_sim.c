@@ -0,0 +1,488 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 22:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:25:06
+ * @Description: 模拟的SHT20，按数据手册在字节层面应答命令，供没有传感器的主机运行和压测客户端
+ *   latency=MS   转换时间，默认为数据手册中用户寄存器当前分辨率的典型值(14/12位时温度66ms，湿度22ms)
+ *   noise=SIGMA  叠加在以一天为周期的温湿度曲线上的高斯噪声的标准差(℃/%RH)，默认0.05
+ *   fail=P       每次总线传输以概率P失败(EIO)
+ *   crc=P        每次读出测量值时以概率P损坏CRC字节
+ *   seed=N       随机数种子，默认取时间和进程号，固定后可复现
+ *
+ *   关闭时在日志中按保持/不保持主机模式和温度/湿度输出从触发到读出结果的延迟直方图，以及转换未完成时被拒绝的读次数
+ */
+
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <strings.h>
+
+#include "i2c_sht20.h"
+#include "logger.h"
+
+#define SIM_RESET_LATENCY   15          // 软复位时间(ms)
+#define SIM_USER_REG        0x02        // 上电和软复位后的用户寄存器
+#define SIM_USER_REG_MASK   0x87        // 用户寄存器可写的位: 分辨率、加热器、OTP重载
+#define SIM_HIST_BUCKETS    256         // 延迟直方图按1ms分桶，最后一桶包含更长的延迟
+
+/***
+ * @name: sim_res
+ * @description: 数据手册各分辨率的典型转换时间和有效位数，下标为用户寄存器 bit7<<1 | bit0
+ */
+static const struct
+{
+    int             temp_ms;            // 温度转换典型时间(ms)
+    int             humi_ms;            // 湿度转换典型时间(ms)
+    int             temp_bits;          // 温度有效位数
+    int             humi_bits;          // 湿度有效位数
+} sim_res[] =
+{
+    {66, 22, 14, 12},
+    {17,  3, 12,  8},
+    {33,  7, 13, 10},
+    { 9, 12, 11, 11},
+};
+
+/***
+ * @name: sensor_sim_t
+ * @description: 模拟器件的状态
+ */
+typedef struct sensor_sim_s
+{
+    int             latency_ms;         // 转换时间，负数为数据手册典型值
+    double          noise;              // 噪声标准差
+    double          fail;               // 传输失败概率
+    double          crc;                // CRC损坏概率
+    unsigned int    seed;               // rand_r()状态
+    uint8_t         user_reg;           // 用户寄存器
+    uint8_t         cmd;                // 最近一次写入的命令
+    long long       ready_ms;           // 转换或复位完成的时刻
+    long long       trigger_ms;         // 触发测量的时刻
+    uint8_t         out[8];             // 下一次读出的数据
+    int             out_len;            // out中的字节数
+    uint32_t        nacks;              // 转换未完成时被拒绝的读
+    uint32_t        hist[2][2][SIM_HIST_BUCKETS];   // [保持主机][湿度][毫秒]的延迟直方图
+} sensor_sim_t;
+
+/**
+ * @name: static long long sim_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
+ */
+static long long sim_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static double sim_uniform(sensor_sim_t *sim)
+ * @description: [0, 1)均匀分布的随机数
+ * @param {sensor_sim_t} *sim 模拟器件
+ * @return {double} 随机数
+ */
+static double sim_uniform(sensor_sim_t *sim)
+{
+    return rand_r(&sim->seed) / ((double)RAND_MAX + 1);
+}
+
+/**
+ * @name: static double sim_gauss(sensor_sim_t *sim)
+ * @description: Box-Muller变换得到标准正态分布的随机数
+ * @param {sensor_sim_t} *sim 模拟器件
+ * @return {double} 随机数
+ */
+static double sim_gauss(sensor_sim_t *sim)
+{
+    return sqrt(-2.0 * log(1.0 - sim_uniform(sim))) * cos(2 * M_PI * sim_uniform(sim));
+}
+
+/**
+ * @name: static uint8_t sim_crc8(const uint8_t *buf, int len)
+ * @description: SHT2x的CRC-8，多项式x^8+x^5+x^4+1，初值0
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {uint8_t} 校验值
+ */
+static uint8_t sim_crc8(const uint8_t *buf, int len)
+{
+    uint8_t         crc = 0;
+    int             i, bit;
+
+    for (i = 0; i < len; i++)
+    {
+        crc ^= buf[i];
+        for (bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @name: static void sim_measure(sensor_sim_t *sim, int humidity)
+ * @description: 开始一次转换，按以一天为周期的曲线加噪声生成读数，编码成MSB、LSB、CRC
+ *               按用户寄存器的分辨率截掉低位并决定转换时间，LSB的bit1为测量类型，温度为0，湿度为1
+ * @param {sensor_sim_t} *sim 模拟器件
+ * @param {int} humidity 1为湿度，0为温度
+ * @return {*}
+ */
+static void sim_measure(sensor_sim_t *sim, int humidity)
+{
+    int             res = ((sim->user_reg >> 6) & 0x02) | (sim->user_reg & 0x01);
+    int             bits = humidity ? sim_res[res].humi_bits : sim_res[res].temp_bits;
+    double          phase = 2 * M_PI * (time(NULL) % 86400) / 86400.0;
+    double          value;
+    double          raw;
+    uint16_t        code;
+
+    if (humidity)
+    {
+        value = 50.0 - 15.0 * sin(phase) + sim->noise * sim_gauss(sim);
+        raw   = (value + 6) / 125 * 65536;
+    }
+    else
+    {
+        value = 22.0 + 5.0 * sin(phase) + sim->noise * sim_gauss(sim);
+        raw   = (value + 46.85) / 175.72 * 65536;
+    }
+
+    code = raw < 0 ? 0 : (raw > 65535 ? 65535 : (uint16_t)raw);
+    code = (code & (0xFFFF << (16 - bits)) & 0xFFFC) | (humidity ? 0x02 : 0x00);
+
+    sim->out[0]   = code >> 8;
+    sim->out[1]   = code & 0xFF;
+    sim->out[2]   = sim_crc8(sim->out, 2);
+    sim->out_len    = 3;
+    sim->trigger_ms = sim_now_ms();
+    sim->ready_ms   = sim->trigger_ms
+                    + (sim->latency_ms >= 0 ? sim->latency_ms : (humidity ? sim_res[res].humi_ms : sim_res[res].temp_ms));
+}
+
+/**
+ * @name: static void sim_serial(sensor_sim_t *sim, uint8_t cmd)
+ * @description: 读出片上存储器中的序列号，每个字节或每两个字节后跟一个CRC
+ * @param {sensor_sim_t} *sim 模拟器件
+ * @param {uint8_t} cmd 0xFA为SNB，0xFC为SNC和SNA
+ * @return {*}
+ */
+static void sim_serial(sensor_sim_t *sim, uint8_t cmd)
+{
+    static const uint8_t snb[4] = {0x53, 0x49, 0x4D, 0x30};
+    static const uint8_t snc[2] = {0x00, 0x01};
+    static const uint8_t sna[2] = {0x00, 0x80};
+    int             i;
+
+    if (cmd == 0xFA)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            sim->out[2 * i]     = snb[i];
+            sim->out[2 * i + 1] = sim_crc8(&snb[i], 1);
+        }
+        sim->out_len = 8;
+    }
+    else
+    {
+        memcpy(&sim->out[0], snc, 2);
+        sim->out[2] = sim_crc8(snc, 2);
+        memcpy(&sim->out[3], sna, 2);
+        sim->out[5] = sim_crc8(sna, 2);
+        sim->out_len = 6;
+    }
+}
+
+/**
+ * @name: static int sim_init(sensor_t *sensor)
+ * @description: 分配模拟器件并设置默认参数
+ * @param {sensor_t} *sensor 传感器
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int sim_init(sensor_t *sensor)
+{
+    sensor_sim_t   *sim;
+
+    if ((sim = calloc(1, sizeof(*sim))) == NULL)
+    {
+        log_error("sensor sim calloc failed: %s\n", strerror(errno));
+        return -1;
+    }
+
+    sim->latency_ms = -1;
+    sim->noise      = 0.05;
+    sim->seed       = (unsigned int)time(NULL) ^ ((unsigned int)getpid() << 16);
+    sim->user_reg   = SIM_USER_REG;
+    sensor->priv    = sim;
+    return 0;
+}
+
+/**
+ * @name: static int sim_option(sensor_t *sensor, const char *key, const char *value)
+ * @description: 解析模拟器件的参数
+ * @param {sensor_t} *sensor 传感器
+ * @param {char} *key 参数名
+ * @param {char} *value 参数值
+ * @return {int} 0为正常执行，非0则参数无效
+ */
+static int sim_option(sensor_t *sensor, const char *key, const char *value)
+{
+    sensor_sim_t   *sim = sensor->priv;
+    double          p   = atof(value);
+
+    if (!strcasecmp(key, "latency"))
+    {
+        sim->latency_ms = atoi(value);
+        return sim->latency_ms < 0 ? -1 : 0;
+    }
+    else if (!strcasecmp(key, "noise"))
+    {
+        sim->noise = p;
+        return p < 0 ? -1 : 0;
+    }
+    else if (!strcasecmp(key, "fail"))
+    {
+        sim->fail = p;
+    }
+    else if (!strcasecmp(key, "crc"))
+    {
+        sim->crc = p;
+    }
+    else if (!strcasecmp(key, "seed"))
+    {
+        sim->seed = strtoul(value, NULL, 0);
+        return 0;
+    }
+    else
+    {
+        return -1;
+    }
+
+    return ((p < 0) || (p > 1)) ? -1 : 0;
+}
+
+/**
+ * @name: static int sim_open(sensor_t *sensor)
+ * @description: 模拟器件上电
+ * @param {sensor_t} *sensor 传感器
+ * @return {int} 0为正常执行
+ */
+static int sim_open(sensor_t *sensor)
+{
+    sensor_sim_t   *sim = sensor->priv;
+
+    log_info("Simulated SHT20: latency %d/%d ms, noise %.3f, fail %.4f, crc %.4f\n",
+             sim->latency_ms >= 0 ? sim->latency_ms : sim_res[0].temp_ms,
+             sim->latency_ms >= 0 ? sim->latency_ms : sim_res[0].humi_ms, sim->noise, sim->fail, sim->crc);
+    return 0;
+}
+
+/**
+ * @name: static int sim_write(sensor_t *sensor, const uint8_t *buf, int len)
+ * @description: 接收命令，触发测量、读写用户寄存器、软复位或读序列号，不认识的命令不应答
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 写入的字节数，-1则出现错误
+ */
+static int sim_write(sensor_t *sensor, const uint8_t *buf, int len)
+{
+    sensor_sim_t   *sim = sensor->priv;
+
+    if (len < 1)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (sim_uniform(sim) < sim->fail)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    sim->cmd     = buf[0];
+    sim->out_len = 0;
+    switch (buf[0])
+    {
+    case CMD_TRIGGER_TEMP_HOLD:
+    case CMD_TRIGGER_TEMP_NOHOLD:
+        sim_measure(sim, 0);
+        break;
+    case CMD_TRIGGER_HUMI_HOLD:
+    case CMD_TRIGGER_HUMI_NOHOLD:
+        sim_measure(sim, 1);
+        break;
+    case CMD_READ_USER_REG:
+        sim->out[0]  = sim->user_reg;
+        sim->out_len = 1;
+        break;
+    case CMD_WRITE_USER_REG:
+        if (len < 2)
+        {
+            errno = ENXIO;
+            return -1;
+        }
+        sim->user_reg = (sim->user_reg & ~SIM_USER_REG_MASK) | (buf[1] & SIM_USER_REG_MASK);
+        break;
+    case CMD_SOFT_RESET:
+        sim->user_reg = SIM_USER_REG;
+        sim->ready_ms = sim_now_ms() + SIM_RESET_LATENCY;
+        break;
+    case 0xFA:
+    case 0xFC:
+        sim_serial(sim, buf[0]);
+        break;
+    default:
+        errno = ENXIO;
+        return -1;
+    }
+
+    return len;
+}
+
+/**
+ * @name: static int sim_read(sensor_t *sensor, uint8_t *buf, int len)
+ * @description: 读出上一条命令的结果
+ *               保持主机模式下转换未完成时拉低SCL，读操作一直等到转换完成
+ *               非保持主机模式下转换未完成时不应答(ENXIO)
+ * @param {sensor_t} *sensor 传感器
+ * @param {uint8_t} *buf 数据
+ * @param {int} len 长度
+ * @return {int} 读取的字节数，-1则出现错误
+ */
+static int sim_read(sensor_t *sensor, uint8_t *buf, int len)
+{
+    sensor_sim_t   *sim  = sensor->priv;
+    long long       wait = sim->ready_ms - sim_now_ms();
+    struct timespec ts;
+    int             hold = (sim->cmd == CMD_TRIGGER_TEMP_HOLD) || (sim->cmd == CMD_TRIGGER_HUMI_HOLD);
+    int             measure = hold || (sim->cmd == CMD_TRIGGER_TEMP_NOHOLD) || (sim->cmd == CMD_TRIGGER_HUMI_NOHOLD);
+    long long       latency;
+
+    if (sim_uniform(sim) < sim->fail)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    if (wait > 0)
+    {
+        if (!hold)
+        {
+            sim->nacks++;
+            errno = ENXIO;
+            return -1;
+        }
+        ts.tv_sec  = wait / 1000;
+        ts.tv_nsec = (wait % 1000) * 1000000;
+        nanosleep(&ts, NULL);
+    }
+
+    if (sim->out_len == 0)
+    {
+        errno = ENXIO;
+        return -1;
+    }
+
+    // 超出结果长度的字节总线上为高电平
+    memset(buf, 0xFF, len);
+    memcpy(buf, sim->out, len < sim->out_len ? len : sim->out_len);
+    if (measure)
+    {
+        if ((len >= 3) && (sim_uniform(sim) < sim->crc))
+        {
+            buf[2] ^= 1 << (rand_r(&sim->seed) % 8);
+        }
+
+        // 测量结果只能读出一次
+        latency = sim_now_ms() - sim->trigger_ms;
+        sim->hist[hold][(sim->cmd & 0x0F) == 0x05][latency < SIM_HIST_BUCKETS ? latency : SIM_HIST_BUCKETS - 1]++;
+        sim->out_len = 0;
+    }
+
+    return len;
+}
+
+/**
+ * @name: static void sim_report(const char *label, const uint32_t *hist)
+ * @description: 在日志中输出一个延迟直方图的条数、分位数和非空的桶
+ * @param {char} *label 直方图名称
+ * @param {uint32_t} *hist SIM_HIST_BUCKETS个桶
+ * @return {*}
+ */
+static void sim_report(const char *label, const uint32_t *hist)
+{
+    char            line[512];
+    uint32_t        total = 0;
+    uint32_t        seen  = 0;
+    int             p50 = -1, p99 = -1, min = -1, max = 0;
+    int             len = 0;
+    int             i;
+
+    for (i = 0; i < SIM_HIST_BUCKETS; i++)
+    {
+        total += hist[i];
+    }
+    if (total == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < SIM_HIST_BUCKETS; i++)
+    {
+        if (hist[i] == 0)
+        {
+            continue;
+        }
+        seen += hist[i];
+        min   = min < 0 ? i : min;
+        max   = i;
+        p50   = ((p50 < 0) && (seen * 2 >= total)) ? i : p50;
+        p99   = ((p99 < 0) && (seen * 100 >= total * 99)) ? i : p99;
+        if (len < sizeof(line) - 16)
+        {
+            len += snprintf(line + len, sizeof(line) - len, " %d:%u", i, hist[i]);
+        }
+    }
+
+    log_info("sim latency %s: n=%u min=%d p50=%d p99=%d max=%d%s ms, buckets(ms:n)%s\n",
+             label, total, min, p50, p99, max, max == SIM_HIST_BUCKETS - 1 ? "+" : "", line);
+}
+
+/**
+ * @name: static void sim_close(sensor_t *sensor)
+ * @description: 输出延迟直方图
+ * @param {sensor_t} *sensor 传感器
+ * @return {*}
+ */
+static void sim_close(sensor_t *sensor)
+{
+    sensor_sim_t   *sim = sensor->priv;
+
+    if (sim == NULL)
+    {
+        return;
+    }
+
+    sim_report("no-hold temp", sim->hist[0][0]);
+    sim_report("no-hold humi", sim->hist[0][1]);
+    sim_report("hold temp", sim->hist[1][0]);
+    sim_report("hold humi", sim->hist[1][1]);
+    log_info("sim rejected %u read(s) before conversion finished\n", sim->nacks);
+}
+
+const sensor_ops_t sensor_sim_ops =
+{
+    .name   = "sim",
+    .init   = sim_init,
+    .option = sim_option,
+    .open   = sim_open,
+    .write  = sim_write,
+    .read   = sim_read,
+    .close  = sim_close,
+};
@@ -2,75 +2,531 @@
  * @Author: RoxyKko
  * @Date: 2023-04-04 18:38:48
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 23:06:14
+ * @LastEditTime: 2026-10-17 21:12:34
  * @Description: socket相关函数
  */
 
 #include "socket_client.h"
 
 int 	connect_flag = 0;
+int     proto_version = 0;                              // 握手选定的协议版本，0为文本协议
+static char proto_devices[PROTO_MAX_DEVICES][DEVID_LEN]; // 本连接已注册的设备名
+static int  proto_ndevices = 0;                         // 本连接已注册的设备数
+static uint8_t ack_buf[PROTO_ACK_FRAME_LEN * 8];        // 服务器确认帧接收缓冲区
+static size_t  ack_len = 0;                             // ack_buf中未处理的字节数
+static char    send_tail[SEND_BATCH_MAX * SEND_LINE_LEN];   // 发送缓冲区满时没写出的部分
+static int     send_tail_off = 0;                       // send_tail中已写出的字节数
+static int     send_tail_len = 0;                       // send_tail中的字节数，0为没有待写出的数据
+static long long send_tail_ms = 0;                      // 开始等待写出的时间，单调时钟(ms)
 
+/**
+ * @name: static long long socket_now_ms(void)
+ * @description: 获取单调时钟毫秒数
+ * @return {long long} 毫秒数
+ */
+static long long socket_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static int socket_connect_watch(socket_connect_t *sc, int op, uint32_t events)
+ * @description: 修改epoll中对连接socket关注的事件
+ * @param {socket_connect_t} *sc 连接状态机
+ * @param {int} op EPOLL_CTL_ADD/EPOLL_CTL_MOD/EPOLL_CTL_DEL
+ * @param {uint32_t} events 关注的事件
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int socket_connect_watch(socket_connect_t *sc, int op, uint32_t events)
+{
+    struct epoll_event  event;
+
+    event.events  = events;
+    event.data.fd = sc->fd;
+    if (epoll_ctl(sc->epfd, op, sc->fd, &event) < 0)
+    {
+        log_error("epoll_ctl socket[%d] failure: %s\n", sc->fd, strerror(errno));
+        return -1;
+    }
+
+    sc->events = op == EPOLL_CTL_DEL ? 0 : events;
+    return 0;
+}
+
+/**
+ * @name: static int socket_connect_start(socket_connect_t *sc)
+ * @description: 创建非阻塞socket并发起连接，不等待三次握手完成
+ * @param {socket_connect_t} *sc 连接状态机
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int socket_connect_start(socket_connect_t *sc)
+{
+    if ((sc->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        log_error("Create socket failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    if ((connect(sc->fd, (struct sockaddr *)&sc->servaddr, sizeof(sc->servaddr)) < 0) && (errno != EINPROGRESS))
+    {
+        log_error("Connect to server[%s:%d] failure: %s\n", inet_ntoa(sc->servaddr.sin_addr),
+                  ntohs(sc->servaddr.sin_port), strerror(errno));
+        return -2;
+    }
+
+    // 连接完成或失败时socket变为可写
+    if (socket_connect_watch(sc, EPOLL_CTL_ADD, EPOLLOUT) < 0)
+    {
+        return -3;
+    }
+
+    sc->state       = CONNECT_PENDING;
+    sc->deadline_ms = socket_now_ms() + CONNECT_TIMEOUT;
+    return 0;
+}
+
+/**
+ * @name: static int socket_connect_hello(socket_connect_t *sc)
+ * @description: connect完成后发送握手行，之后等待服务器选定协议版本
+ * @param {socket_connect_t} *sc 连接状态机
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int socket_connect_hello(socket_connect_t *sc)
+{
+    int             err = 0;
+    socklen_t       len = sizeof(err);
+
+    if ((getsockopt(sc->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) || (err != 0))
+    {
+        log_error("Connect to server[%s:%d] failure: %s\n", inet_ntoa(sc->servaddr.sin_addr),
+                  ntohs(sc->servaddr.sin_port), strerror(err ? err : errno));
+        return -1;
+    }
+
+    // 握手行很短，新连接的发送缓冲区一定放得下
+    sc->len = snprintf(sc->line, sizeof(sc->line), "%s %d\n", PROTO_HELLO, PROTO_VERSION);
+    if (write(sc->fd, sc->line, sc->len) != sc->len)
+    {
+        log_error("Send handshake failure: %s\n", strerror(errno));
+        return -2;
+    }
+
+    if (socket_connect_watch(sc, EPOLL_CTL_MOD, EPOLLIN) < 0)
+    {
+        return -3;
+    }
+
+    sc->len         = 0;
+    sc->state       = CONNECT_HELLO;
+    sc->deadline_ms = socket_now_ms() + PROTO_HELLO_TIMEOUT;
+    return 0;
+}
+
+/**
+ * @name: static int socket_connect_reply(socket_connect_t *sc)
+ * @description: 读取握手应答，应答只有一行，逐字节读取，不会多读走后续数据
+ * @param {socket_connect_t} *sc 连接状态机
+ * @return {int} 1为应答已读完，0为应答还不完整，负数则连接出错
+ */
+static int socket_connect_reply(socket_connect_t *sc)
+{
+    int             rv;
+
+    while (sc->len < sizeof(sc->line) - 1)
+    {
+        if ((rv = read(sc->fd, sc->line + sc->len, 1)) < 0 && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            return 0;
+        }
+
+        if (rv <= 0)
+        {
+            log_error("Read handshake failure: %s\n", rv < 0 ? strerror(errno) : "disconnect");
+            return -1;
+        }
+
+        if (sc->line[sc->len] == '\n')
+        {
+            break;
+        }
+        sc->len++;
+    }
+    sc->line[sc->len] = '\0';
+
+    if ((rv = proto_parse_hello(sc->line)) < 0 || rv > PROTO_VERSION)
+    {
+        log_info("Unknown handshake reply \"%s\", use text protocol\n", sc->line);
+        rv = 0;
+    }
+    proto_version = rv;
+
+    return 1;
+}
 
 /**
- * @name: socket_client_init(char *serv_ip, int port)
- * @description: 建立TCP socket连接
+ * @name: static int socket_connect_ready(socket_connect_t *sc)
+ * @description: 握手结束，socket保持非阻塞，只有支持确认的协议需要继续读socket
+ *               服务器不读数据时写不完的部分由主循环等EPOLLOUT再写，不会阻塞在write()中
+ * @param {socket_connect_t} *sc 连接状态机
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int socket_connect_ready(socket_connect_t *sc)
+{
+    if (socket_connect_watch(sc, proto_version >= PROTO_VERSION_ACK ? EPOLL_CTL_MOD : EPOLL_CTL_DEL, EPOLLIN) < 0)
+    {
+        return -2;
+    }
+
+    // 新连接需要重新注册设备号，上一个连接没写完的数据随连接一起丢弃，未确认的采样会重发
+    proto_ndevices = 0;
+    ack_len        = 0;
+    send_tail_len  = 0;
+    send_tail_off  = 0;
+    sc->state      = CONNECT_READY;
+    sc->ready_ms   = socket_now_ms();
+
+    printf("Connect to server[%s:%d] successfully!\n", inet_ntoa(sc->servaddr.sin_addr), ntohs(sc->servaddr.sin_port));
+    log_info("Use %s protocol version %d\n", proto_version ? "binary" : "text", proto_version);
+    return 0;
+}
+
+/**
+ * @name: int socket_connect_init(socket_connect_t *sc, int epfd, char *serv_ip, int port, int cap_ms)
+ * @description: 初始化非阻塞连接状态机，第一次连接不等待
+ * @param {socket_connect_t} *sc 连接状态机
+ * @param {int} epfd 主循环的epoll句柄，连接过程中的socket由状态机加入
  * @param {char} *serv_ip 服务器IP地址
  * @param {int} port 服务器端口号
- * @return {*}若成功返回socket描述符，否则返回<0
+ * @param {int} cap_ms 重连退避时间的上限(ms)
+ * @return {int} 0为正常执行，非0则参数错误
  */
-int socket_client_init(char *serv_ip, int port)
+int socket_connect_init(socket_connect_t *sc, int epfd, char *serv_ip, int port, int cap_ms)
 {
-    int                 socket_fd;
-    struct sockaddr_in  servaddr;
-    int                 rv = -1;
-
-    // 创建socket并获得socket描述符
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    // 创建socket失败
-    if (socket_fd < 0)
+    memset(sc, 0, sizeof(*sc));
+    sc->servaddr.sin_family = AF_INET;                  // IPV4
+    sc->servaddr.sin_port   = htons(port);              // port
+    if ((inet_aton(serv_ip, &sc->servaddr.sin_addr) == 0) || (cap_ms < CONNECT_BACKOFF_BASE))
     {
-        printf("Create socket failure: %s\n", strerror(errno));
         return -1;
     }
 
-    // 创建socket成功
-    printf("Create socket[%d] successfully\n", socket_fd);
+    // 各设备的随机种子必须不同，否则同时掉线的设备仍会同时重连
+    if (getrandom(&sc->seed, sizeof(sc->seed), GRND_NONBLOCK) != sizeof(sc->seed))
+    {
+        sc->seed = (unsigned int)socket_now_ms() ^ ((unsigned int)getpid() << 16);
+    }
+
+    sc->fd     = -1;
+    sc->epfd   = epfd;
+    sc->cap_ms = cap_ms;
+    sc->state  = CONNECT_IDLE;
+    return 0;
+}
+
+/**
+ * @name: int socket_connect_poll(socket_connect_t *sc, uint32_t events)
+ * @description: 推进连接状态机，退避时间到期时发起连接，任何一步出错或超时都关闭socket并退避
+ *               每一步都不阻塞，连接过程不会推迟采样
+ * @param {socket_connect_t} *sc 连接状态机
+ * @param {uint32_t} events epoll返回的连接socket事件，没有则为0
+ * @return {int} 1为连接和握手已完成，0为还在等待
+ */
+int socket_connect_poll(socket_connect_t *sc, uint32_t events)
+{
+    long long       now = socket_now_ms();
+    int             rv  = 0;
 
-    // 初始化结构体，将空余的8位字节填充为0
-    // 设置参数，connect连接服务器
-    memset(&servaddr, 0, sizeof(servaddr));
-    servaddr.sin_family      = AF_INET;                 // IPV4
-    servaddr.sin_port        = htons(port);             // port
-    inet_aton(serv_ip, &servaddr.sin_addr);             // 将点分十进制IP转换为网络字节序
-    rv = connect(socket_fd, (struct sockaddr *)&servaddr, sizeof(servaddr));
+    switch (sc->state)
+    {
+    case CONNECT_IDLE:
+        if (now >= sc->deadline_ms)
+        {
+            rv = socket_connect_start(sc);
+        }
+        break;
+
+    case CONNECT_PENDING:
+        if (events)
+        {
+            rv = socket_connect_hello(sc);
+        }
+        else if (now >= sc->deadline_ms)
+        {
+            log_error("Connect to server[%s:%d] timeout\n", inet_ntoa(sc->servaddr.sin_addr), ntohs(sc->servaddr.sin_port));
+            rv = -1;
+        }
+        break;
+
+    case CONNECT_HELLO:
+        if (events && ((rv = socket_connect_reply(sc)) > 0))
+        {
+            rv = socket_connect_ready(sc);
+        }
+        else if ((rv == 0) && (now >= sc->deadline_ms))
+        {
+            // 旧服务器不应答握手，继续使用文本协议
+            log_info("Server did not answer handshake, use text protocol\n");
+            proto_version = 0;
+            rv = socket_connect_ready(sc);
+        }
+        break;
+
+    default:
+        break;
+    }
 
-    // 连接服务器失败
     if (rv < 0)
     {
-        printf("Connect to server[%s:%d] failure : %s\n",
-               serv_ip, port, strerror(errno));
+        socket_connect_close(sc);
+    }
+
+    return sc->state == CONNECT_READY;
+}
+
+/**
+ * @name: int socket_connect_timeout(socket_connect_t *sc)
+ * @description: 距状态机下一个截止时间的毫秒数，用作epoll_wait的超时
+ * @param {socket_connect_t} *sc 连接状态机
+ * @return {int} 毫秒数，已连接时返回-1
+ */
+int socket_connect_timeout(socket_connect_t *sc)
+{
+    long long       left;
+
+    if (sc->state == CONNECT_READY)
+    {
+        return -1;
+    }
+
+    left = sc->deadline_ms - socket_now_ms();
+    return left > 0 ? (int)left : 0;
+}
+
+/**
+ * @name: void socket_connect_close(socket_connect_t *sc)
+ * @description: 关闭socket并安排下一次连接
+ *               退避上限从CONNECT_BACKOFF_BASE开始每次失败翻倍，不超过cap_ms，实际等待时间在[0, 上限]内均匀随机(full jitter)
+ *               连接保持不到CONNECT_STABLE_MS就断开也算失败，避免服务器接受后立即断开时反复重连
+ * @param {socket_connect_t} *sc 连接状态机
+ * @return {*}
+ */
+void socket_connect_close(socket_connect_t *sc)
+{
+    long long       now     = socket_now_ms();
+    long long       ceiling = CONNECT_BACKOFF_BASE;
+    int             i;
+
+    // close()同时把socket移出epoll
+    if (sc->fd >= 0)
+    {
+        close(sc->fd);
+    }
+    sc->events = 0;
+
+    if ((sc->state == CONNECT_READY) && (now - sc->ready_ms >= CONNECT_STABLE_MS))
+    {
+        sc->attempts = 0;
+    }
+    sc->attempts++;
+
+    for (i = 1; (i < sc->attempts) && (ceiling < sc->cap_ms); i++)
+    {
+        ceiling *= 2;
+    }
+    if (ceiling > sc->cap_ms)
+    {
+        ceiling = sc->cap_ms;
+    }
+
+    sc->fd          = -1;
+    sc->state       = CONNECT_IDLE;
+    sc->deadline_ms = now + rand_r(&sc->seed) % (ceiling + 1);
+    log_info("Reconnect in %lld ms after %d failure(s)\n", sc->deadline_ms - now, sc->attempts);
+}
+
+/**
+ * @name: static int sendata_device(char *buf, size_t size, const char *devid, uint16_t *dev)
+ * @description: 查找设备名对应的设备号，设备名首次出现时编码设备注册帧
+ * @param {char} *buf 发送缓冲区
+ * @param {size_t} size 发送缓冲区大小
+ * @param {char} *devid 设备名
+ * @param {uint16_t} *dev 设备号
+ * @return {int} 编码的字节数，已注册的设备为0，负数则出现错误
+ */
+static int sendata_device(char *buf, size_t size, const char *devid, uint16_t *dev)
+{
+    int             len = 0;
+    int             i;
+
+    for (i = 0; i < proto_ndevices; i++)
+    {
+        if (!strcmp(proto_devices[i], devid))
+        {
+            break;
+        }
+    }
+
+    if (i == proto_ndevices)
+    {
+        if ((i == PROTO_MAX_DEVICES) || (len = proto_encode_device((uint8_t *)buf, size, i, devid)) < 0)
+        {
+            log_error("Register device %s failure\n", devid);
+            return -1;
+        }
+        strcpy(proto_devices[i], devid);
+        proto_ndevices++;
+    }
+
+    *dev = i;
+    return len;
+}
+
+/**
+ * @name: static void sendata_record(proto_record_t *rec, packinfo_t *pack_info)
+ * @description: 把数据结构体转换为二进制记录，设备号由sendata_device()填写
+ * @param {proto_record_t} *rec 二进制记录
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {*}
+ */
+static void sendata_record(proto_record_t *rec, packinfo_t *pack_info)
+{
+    rec->ts   = pack_info->ts;
+    rec->temp = (int16_t)lrintf(pack_info->temp * 100);
+    rec->humi = (uint16_t)lrintf(pack_info->humi * 100);
+}
+
+/**
+ * @name: static int sendata_write(int sockfd, const char *buf, int len)
+ * @description: 向非阻塞socket写入缓冲区，发送缓冲区满时把没写出的部分存入send_tail，由sendata_flush()继续写
+ * @param {int} sockfd socket描述符
+ * @param {char} *buf 发送缓冲区
+ * @param {int} len 数据长度
+ * @return {int} 0为已全部写出，1为还有数据等待写出，负数则出现错误
+ */
+static int sendata_write(int sockfd, const char *buf, int len)
+{
+    int         send_count = 0;
+    int         rv;
+
+    if (send_tail_len > 0)
+    {
+        log_error("Sendata error: previous frame not flushed\n");
         return -2;
     }
-    // 连接服务器成功,打印服务器IP地址和端口号
-    printf("Connect to server[%s:%d] successfully!\n", serv_ip, port);
 
-    // 若链接成功则返回socket描述符
-    return socket_fd;
+    while (send_count < len)
+    {
+        rv = write(sockfd, buf + send_count, len - send_count);
+        if ((rv < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            memmove(send_tail, buf + send_count, len - send_count);
+            send_tail_off = 0;
+            send_tail_len = len - send_count;
+            send_tail_ms  = socket_now_ms();
+            return 1;
+        }
+        if (rv < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_error("Sendata error: %s\n", strerror(errno));
+            return -1;
+        }
+
+        send_count += rv;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int sendata_flush(int sockfd)
+ * @description: socket可写时继续写出上次没写完的数据
+ * @param {int} sockfd socket描述符
+ * @return {int} 0为已全部写出，1为还有数据等待写出，负数则出现错误
+ */
+int sendata_flush(int sockfd)
+{
+    int         rv;
+
+    while (send_tail_off < send_tail_len)
+    {
+        rv = write(sockfd, send_tail + send_tail_off, send_tail_len - send_tail_off);
+        if ((rv < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            return 1;
+        }
+        if (rv < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_error("Sendata flush error: %s\n", strerror(errno));
+            return -1;
+        }
+
+        send_tail_off += rv;
+    }
+
+    send_tail_len = 0;
+    send_tail_off = 0;
+    return 0;
+}
+
+/**
+ * @name: int sendata_pending(int timeout_ms)
+ * @description: 查询是否有数据等待写出，服务器长期不读时按连接异常处理
+ * @param {int} timeout_ms 等待写出的超时(ms)
+ * @return {int} 0为没有，1为有数据等待写出，-1为等待超过timeout_ms
+ */
+int sendata_pending(int timeout_ms)
+{
+    if (send_tail_len == 0)
+    {
+        return 0;
+    }
+
+    return socket_now_ms() - send_tail_ms > timeout_ms ? -1 : 1;
+}
+
+/**
+ * @name: int socket_connect_want_write(socket_connect_t *sc, int on)
+ * @description: 有数据等待写出时在epoll中关注EPOLLOUT，写完后取消，支持确认的协议始终关注EPOLLIN
+ * @param {socket_connect_t} *sc 连接状态机
+ * @param {int} on 非0为关注EPOLLOUT
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int socket_connect_want_write(socket_connect_t *sc, int on)
+{
+    uint32_t    events = (proto_version >= PROTO_VERSION_ACK ? EPOLLIN : 0) | (on ? EPOLLOUT : 0);
+
+    if ((sc->state != CONNECT_READY) || (events == sc->events))
+    {
+        return 0;
+    }
+
+    return socket_connect_watch(sc, sc->events == 0 ? EPOLL_CTL_ADD : (events == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD), events);
 }
 
 /**
  * @name: sendata(int sockfd, packinfo_t pack_info)
- * @description: 
+ * @description: 按握手选定的协议发送一条数据
  * @param {int} sockfd
  * @param {packinfo_t} pack_info
- * @return {*} 成功返回0，否则返回<0
+ * @return {*} 成功返回0，1为还有数据等待sendata_flush()写出，否则返回<0
  */
 int sendata(int sockfd, packinfo_t pack_info)
 {
-    int         rv            = -1;
-    char        send_buf[128] = {0};
-    int         send_len      = 0;
-    int         send_count    = 0;
+    char            send_buf[128] = {0};
+    int             send_len      = 0;
+    proto_record_t  rec;
+    int             rv;
 
     if(sockfd < 0)
     {
@@ -81,26 +537,162 @@ int sendata(int sockfd, packinfo_t pack_info)
 		return -1;
     }
 
-    memset(send_buf, 0, sizeof(send_buf));
-    sprintf(send_buf, "%s/%s/%f/%f", pack_info.devid, pack_info.time, pack_info.temp, pack_info.humi);
+    if(proto_version)
+    {
+        if((send_len = sendata_device(send_buf, sizeof(send_buf), pack_info.devid, &rec.dev)) < 0)
+        {
+            return -3;
+        }
+        sendata_record(&rec, &pack_info);
+        if((rv = proto_encode_record((uint8_t *)send_buf + send_len, sizeof(send_buf) - send_len, &rec)) < 0)
+        {
+            return -3;
+        }
+        send_len += rv;
+    }
+    else
+    {
+        // 每帧以'\n'结尾，服务器据此在TCP字节流中切分粘包/半包
+        send_len = snprintf(send_buf, sizeof(send_buf), "%s/%s/%f/%f\n", pack_info.devid, pack_info.time, pack_info.temp, pack_info.humi);
+    }
 
-    send_len = strlen(send_buf);
-    log_debug("Sendata: %s\n", send_buf);
-    while(send_count < send_len)
+    if((rv = sendata_write(sockfd, send_buf, send_len)) < 0)
     {
-        rv = write(sockfd, send_buf + send_count, send_len - send_count);
-        if(rv < 0)
+        return -2;
+    }
+
+    log_info("Send data to sever successfully: %s %s %.2f %.2f (%d bytes)\n",
+             pack_info.devid, pack_info.time, pack_info.temp, pack_info.humi, send_len);
+	return rv;
+}
+
+/**
+ * @name: int sendata_batch(int sockfd, packinfo_t *pack_info, int count, uint32_t seq)
+ * @description: 把多条数据编码到同一个缓冲区后一次写出
+ *               协议版本2为一个带序号的批量帧，版本1为连续的记录帧，文本协议下为连续的多行
+ * @param {int} sockfd socket描述符
+ * @param {packinfo_t} *pack_info 数据结构体数组
+ * @param {int} count 数据条数，不超过SEND_BATCH_MAX
+ * @param {uint32_t} seq 批量帧序号，只在协议版本2下使用
+ * @return {int} 成功返回0，1为还有数据等待sendata_flush()写出，否则返回<0
+ */
+int sendata_batch(int sockfd, packinfo_t *pack_info, int count, uint32_t seq)
+{
+    static char     send_buf[SEND_BATCH_MAX * SEND_LINE_LEN];
+    proto_record_t  recs[SEND_BATCH_MAX];
+    int             send_len = 0;
+    int             rv;
+    int             i;
+
+    if((sockfd < 0) || (pack_info == NULL) || (count < 1) || (count > SEND_BATCH_MAX))
+    {
+        log_error("The sendata_batch() argument incorrect!\n");
+        return -1;
+    }
+
+    if(proto_version)
+    {
+        // 新设备的注册帧放在批量帧之前，同一次write发出
+        for(i = 0; i < count; i++)
         {
-            log_error("Sendata error: %s\n", strerror(errno));
-            return -2;
+            if((rv = sendata_device(send_buf + send_len, sizeof(send_buf) - send_len, pack_info[i].devid, &recs[i].dev)) < 0)
+            {
+                return -3;
+            }
+            send_len += rv;
+            sendata_record(&recs[i], &pack_info[i]);
         }
-        
-        send_count += rv;
-        
+
+        if(proto_version >= PROTO_VERSION_ACK)
+        {
+            if((rv = proto_encode_batch((uint8_t *)send_buf + send_len, sizeof(send_buf) - send_len, seq, recs, count)) < 0)
+            {
+                return -3;
+            }
+            send_len += rv;
+        }
+        else
+        {
+            for(i = 0; i < count; i++)
+            {
+                if((rv = proto_encode_record((uint8_t *)send_buf + send_len, sizeof(send_buf) - send_len, &recs[i])) < 0)
+                {
+                    return -3;
+                }
+                send_len += rv;
+            }
+        }
+    }
+    else
+    {
+        for(i = 0; i < count; i++)
+        {
+            send_len += snprintf(send_buf + send_len, SEND_LINE_LEN, "%s/%s/%f/%f\n",
+                                 pack_info[i].devid, pack_info[i].time, pack_info[i].temp, pack_info[i].humi);
+        }
+    }
+
+    if((rv = sendata_write(sockfd, send_buf, send_len)) < 0)
+    {
+        return -2;
+    }
+
+    log_info("Send %d cached data to sever %s (%d bytes)\n", count, rv ? "partly, rest waits for socket" : "successfully", send_len);
+    return rv;
+}
+
+/**
+ * @name: int socket_client_recv_ack(int sockfd, int timeout_ms, uint32_t *seq)
+ * @description: 非阻塞地读取服务器的确认帧，确认是累计的，只返回其中最大的序号
+ * @param {int} sockfd socket描述符
+ * @param {int} timeout_ms 没有数据时最多等待的时间(ms)，0为不等待
+ * @param {uint32_t} *seq 确认的序号
+ * @return {int} 1为收到确认，0为没有新的确认，负数则连接已断开或字节流错误
+ */
+int socket_client_recv_ack(int sockfd, int timeout_ms, uint32_t *seq)
+{
+    struct pollfd   pfd;
+    const uint8_t  *payload;
+    size_t          plen;
+    int             type;
+    int             found = 0;
+    int             rv;
+
+    pfd.fd     = sockfd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+    {
+        return 0;
+    }
+
+    while ((rv = recv(sockfd, ack_buf + ack_len, sizeof(ack_buf) - ack_len, MSG_DONTWAIT)) > 0)
+    {
+        ack_len += rv;
+        while ((rv = proto_decode(ack_buf, ack_len, &type, &payload, &plen)) > 0)
+        {
+            if ((type == PROTO_TYPE_ACK) && (proto_parse_ack(payload, plen, seq) == 0))
+            {
+                found = 1;
+            }
+            memmove(ack_buf, ack_buf + rv, ack_len - rv);
+            ack_len -= rv;
+        }
+
+        // 服务器只发送确认帧，缓冲区满了还解不出完整帧说明字节流已错乱
+        if ((rv < 0) || (ack_len == sizeof(ack_buf)))
+        {
+            log_error("Bad frame from server\n");
+            return -1;
+        }
+    }
+
+    if ((rv == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)))
+    {
+        log_error("Read ack failure: %s\n", rv == 0 ? "disconnect" : strerror(errno));
+        return -2;
     }
 
-    log_info("Send data to sever successfully:%s\n", send_buf);
-	return 0;
+    return found;
 }
 
 /**
@@ -0,0 +1,219 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:08:01
+ * @Description: 溢出缓存，按启动时选择的后端转发到database_*()或mmap_spool_*()
+ */
+
+#include "spool.h"
+
+/**
+ * @name: int spool_open(spool_t *sp, const char *type, char *name, char *table, const db_profile_t *profile, int max_rows, int max_ms)
+ * @description: 解析后端配置并打开缓存
+ *               sqlite          数据库name.db中的table表，按profile设置
+ *               mmap[,RECORDS]  预分配RECORDS条记录的文件name.spool，已有文件沿用原容量
+ * @param {spool_t} *sp 溢出缓存
+ * @param {char} *type 后端配置
+ * @param {char} *name 数据库名或缓存文件名(不含扩展名)
+ * @param {char} *table SQLite表名
+ * @param {db_profile_t} *profile SQLite存储配置
+ * @param {int} max_rows 每次提交或同步最多的条数
+ * @param {int} max_ms 未提交的采样最长等待时间(ms)
+ * @return {int} 0为正常执行，-1为配置错误，其他负数为打开失败
+ */
+int spool_open(spool_t *sp, const char *type, char *name, char *table, const db_profile_t *profile, int max_rows, int max_ms)
+{
+    char            path[128];
+    char           *end;
+    long            capacity = MMAP_SPOOL_DEFAULT;
+    int64_t         max_rowid = 0;
+
+    memset(sp, 0, sizeof(*sp));
+    sp->name  = name;
+    sp->table = table;
+
+    if (!strcmp(type, "sqlite"))
+    {
+        sp->type = SPOOL_SQLITE;
+    }
+    else if (!strncmp(type, "mmap", 4) && ((type[4] == '\0') || (type[4] == ',')))
+    {
+        sp->type = SPOOL_MMAP;
+        if ((type[4] == ',') && (((capacity = strtol(type + 5, &end, 10)) < 1) || (*end != '\0')))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        return -1;
+    }
+
+    if (sp->type == SPOOL_MMAP)
+    {
+        snprintf(path, sizeof(path), "%s.spool", name);
+        if (mmap_spool_open(&sp->mm, path, capacity, max_rows, max_ms) < 0)
+        {
+            return -2;
+        }
+        sp->count = mmap_spool_count(&sp->mm);
+        return 0;
+    }
+
+    if (database_init(name, &sp->db, profile) < 0)
+    {
+        log_error("database init failed!\n");
+        return -2;
+    }
+
+    // 若数据库中不存在表，则创建表，缓存预编译的INSERT语句
+    if ((database_create_table(table, &sp->db) < 0) || (database_batch_init(table, &sp->db, &sp->batch, max_rows, max_ms) < 0))
+    {
+        database_close(name, &sp->db);
+        return -3;
+    }
+
+    // 只从队首删除、在队尾追加，rowid是连续的，两端的rowid就能得出条数
+    if (database_rowid_range(table, &sp->db, &sp->head_rowid, &max_rowid) < 0)
+    {
+        database_batch_close(&sp->batch);
+        database_close(name, &sp->db);
+        return -4;
+    }
+    sp->count = sp->head_rowid > 0 ? (int)(max_rowid - sp->head_rowid + 1) : 0;
+    log_info("Opened spool %s.%s, %d pending\n", name, table, sp->count);
+
+    return 0;
+}
+
+/**
+ * @name: int spool_append(spool_t *sp, packinfo_t *pack_info)
+ * @description: 在队尾追加一条采样，满max_rows条或超过max_ms时落盘
+ * @param {spool_t} *sp 溢出缓存
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int spool_append(spool_t *sp, packinfo_t *pack_info)
+{
+    if (sp->type == SPOOL_MMAP)
+    {
+        if (mmap_spool_append(&sp->mm, pack_info) < 0)
+        {
+            return -1;
+        }
+        // 文件满时覆盖最早的记录，条数以文件头为准
+        sp->count = mmap_spool_count(&sp->mm);
+        return 0;
+    }
+
+    if (database_batch_insert(&sp->batch, pack_info) < 0)
+    {
+        return -1;
+    }
+    // 表清空后SQLite重新从1分配rowid，队首要取这一行实际的rowid
+    if (sp->count++ == 0)
+    {
+        sp->head_rowid = sqlite3_last_insert_rowid(sp->db);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int spool_poll(spool_t *sp)
+ * @description: 未落盘的采样等待超过max_ms时落盘
+ * @param {spool_t} *sp 溢出缓存
+ * @return {int} 距下一次落盘的毫秒数，没有未落盘的采样时返回-1，落盘失败返回-2
+ */
+int spool_poll(spool_t *sp)
+{
+    if (sp->type == SPOOL_MMAP)
+    {
+        return mmap_spool_poll(&sp->mm);
+    }
+
+    return database_batch_poll(&sp->batch);
+}
+
+/**
+ * @name: int spool_count(spool_t *sp)
+ * @description: 缓存中的采样数，只读内存中的计数，不访问数据库
+ * @param {spool_t} *sp 溢出缓存
+ * @return {int} 采样数
+ */
+int spool_count(spool_t *sp)
+{
+    return sp->count;
+}
+
+/**
+ * @name: int spool_read(spool_t *sp, packinfo_t *pack_info, int max_rows)
+ * @description: 读取队首最多max_rows条采样，spool_consume()之前再次读取得到相同的采样
+ * @param {spool_t} *sp 溢出缓存
+ * @param {packinfo_t} *pack_info 数据结构体数组，至少max_rows个元素
+ * @param {int} max_rows 最多读取的条数
+ * @return {int} 读取的条数，负数则出现错误
+ */
+int spool_read(spool_t *sp, packinfo_t *pack_info, int max_rows)
+{
+    if (sp->type == SPOOL_MMAP)
+    {
+        sp->last_count = mmap_spool_read(&sp->mm, pack_info, max_rows);
+        return sp->last_count;
+    }
+
+    sp->last_count = database_select_batch(sp->table, &sp->db, sp->head_rowid - 1, pack_info, max_rows, &sp->last_rowid);
+
+    // 不足max_rows条说明已读到队尾，顺便校正计数
+    if ((sp->last_count >= 0) && (sp->last_count < max_rows))
+    {
+        sp->count = sp->last_count;
+    }
+    return sp->last_count;
+}
+
+/**
+ * @name: int spool_consume(spool_t *sp)
+ * @description: 删除上一次spool_read()读出的采样
+ * @param {spool_t} *sp 溢出缓存
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int spool_consume(spool_t *sp)
+{
+    if (sp->type == SPOOL_MMAP)
+    {
+        mmap_spool_consume(&sp->mm, sp->last_count);
+        sp->count = mmap_spool_count(&sp->mm);
+    }
+    else if (sp->last_count > 0)
+    {
+        if (database_delete_upto(sp->table, &sp->db, sp->last_rowid) < 0)
+        {
+            return -1;
+        }
+        sp->head_rowid = sp->last_rowid + 1;
+        sp->count -= sp->last_count;
+    }
+
+    sp->last_count = 0;
+    return 0;
+}
+
+/**
+ * @name: void spool_close(spool_t *sp)
+ * @description: 落盘剩余的采样并关闭缓存
+ * @param {spool_t} *sp 溢出缓存
+ * @return {*}
+ */
+void spool_close(spool_t *sp)
+{
+    if (sp->type == SPOOL_MMAP)
+    {
+        mmap_spool_close(&sp->mm);
+        return;
+    }
+
+    database_batch_close(&sp->batch);
+    database_close(sp->name, &sp->db);
+}
@@ -0,0 +1,101 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:30:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:01:14
+ * @Description: 服务器端客户端连接及接收缓冲区
+ */
+
+#ifndef _CONNECTION_H_
+#define _CONNECTION_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "logger.h"
+#include "packinfo.h"
+#include "proto.h"
+
+#define CONN_RXBUF_SIZE     4096        // 每个连接的接收缓冲区大小
+#define CONN_FRAME_DELIM    '\n'        // 文本帧结束符
+#define CONN_ACK_PENDING    16          // 每个连接等待提交的批量帧数，超出时合并到最新的一项
+
+/***
+ * @name: conn_ack_t
+ * @description: 等待确认的批量帧，所属工作线程的前upto条记录处理完后确认seq
+ */
+typedef struct conn_ack_s
+{
+    uint32_t        seq;                // 批量帧序号
+    uint64_t        upto;               // 该帧最后一条记录在工作线程入队记录中的位置
+} conn_ack_t;
+
+/***
+ * @name: CONN_RECV
+ * @description: conn_recv()的返回值
+ */
+enum CONN_RECV
+{
+    CONN_RECV_AGAIN = 0,                // 内核缓冲区已读空(EAGAIN)
+    CONN_RECV_FULL,                     // 接收缓冲区已满，套接字中可能还有数据
+    CONN_RECV_EOF,                      // 对端关闭连接
+    CONN_RECV_ERROR                     // 读错误，或缓冲区已满仍无完整帧
+};
+
+/***
+ * @name: CONN_FRAME
+ * @description: conn_next_frame()的返回值
+ */
+enum CONN_FRAME
+{
+    CONN_FRAME_NONE = 0,                // 没有完整帧
+    CONN_FRAME_OK,                      // 取到完整帧
+    CONN_FRAME_BAD                      // 二进制帧头或crc错误，字节流无法继续切分
+};
+
+/***
+ * @name: conn_t
+ * @description: 客户端连接，保存尚未组成完整帧的数据
+ *               [rx_head, rx_tail) 为未处理的数据，rx_head 之前的空间在下次接收前回收
+ */
+typedef struct conn_s
+{
+    int             fd;                         // 客户端套接字
+    size_t          rx_head;                    // 未处理数据起始偏移
+    size_t          rx_tail;                    // 未处理数据结束偏移
+    int             readable;                   // 套接字中可能还有未读的数据
+    int             closing;                    // 对端已关闭或读出错，处理完缓冲区后关闭
+    int             blocked;                    // 入库队列已满，暂停读取
+    int             proto;                      // 握手选定的二进制协议版本，0为文本协议
+    char            devices[PROTO_MAX_DEVICES][DEVID_LEN];  // 二进制协议下本连接注册的设备名
+    int             batch_done;                 // 当前批量帧中已送入入库队列的记录数
+    uint64_t        acked;                      // 已确认到的工作线程入队记录位置
+    uint64_t        pushed;                     // 本连接最后一条记录的工作线程入队位置，未确认的记录都在(acked, pushed]中
+    conn_ack_t      acks[CONN_ACK_PENDING];     // 等待确认的批量帧，按序号递增
+    int             ack_head;                   // acks中最早一项的下标
+    int             ack_count;                  // acks中的项数
+    int             acking;                     // 是否在工作线程的等待确认链表中
+    struct conn_s  *prev;                       // 所属工作线程的连接链表
+    struct conn_s  *next;
+    struct conn_s  *next_blocked;               // 所属工作线程的暂停读取链表
+    struct conn_s  *next_acking;                // 所属工作线程的等待确认链表
+    char            rxbuf[CONN_RXBUF_SIZE];     // 接收缓冲区
+} conn_t;
+
+int set_nonblocking(int fd);
+
+conn_t *conn_new(int fd);
+
+void conn_free(conn_t *conn);
+
+int conn_recv(conn_t *conn);
+
+int conn_next_frame(conn_t *conn, char **frame, size_t *len);
+
+void conn_unget_frame(conn_t *conn, char *frame, size_t len);
+
+#endif
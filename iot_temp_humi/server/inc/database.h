@@ -2,23 +2,86 @@
  * @Author: RoxyKko
  * @Date: 2023-04-05 19:24:03
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 22:42:10
+ * @LastEditTime: 2026-10-17 20:51:32
  * @Description: sqlite的使用
  */
 
 #ifndef __DATABASE_H__
 #define __DATABASE_H__
 
-#include "iot_main.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "logger.h"
 #include "packinfo.h"
 #include "sqlite3.h"
 
-int database_init(char *dbname, sqlite3 **db);
+#include <stdlib.h>
+#include <math.h>
+
+#define DB_PROFILE_DEFAULT  "durable"     // 默认存储配置
+#define DB_SCHEMA_VERSION   1             // 数据库模式版本，写入PRAGMA user_version
+#define DB_SAMPLE_TABLE     "samples"     // 时序表
+#define DB_DEVICE_TABLE     "devices"     // 设备表
+#define DB_DEVICE_CACHE_SIZE 1024         // 设备id缓存大小，必须为2的幂
+#define DB_BUSY_TIMEOUT     5000          // 等待其他连接释放写锁的超时(ms)
+
+/***
+ * @name: db_profile_t
+ * @description: 存储配置，在database_init()打开数据库时一次性设置
+ */
+typedef struct db_profile_s
+{
+    char            name[16];           // 预设名
+    char            journal_mode[16];   // 日志模式 WAL/DELETE/TRUNCATE...
+    char            synchronous[8];     // 同步级别 OFF/NORMAL/FULL/EXTRA
+    long long       mmap_size;          // 内存映射大小(字节)，0为不使用
+    int             page_size;          // 页大小(字节)，只对新建的数据库文件生效
+    int             cache_size;         // 页缓存大小，负数为KiB
+    int             wal_autocheckpoint; // WAL自动检查点页数
+} db_profile_t;
+
+/***
+ * @name: db_device_t
+ * @description: 设备名到设备id的缓存项
+ */
+typedef struct db_device_s
+{
+    char            name[DEVID_LEN];    // 设备名，为空表示空闲
+    int64_t         id;                 // 设备id
+} db_device_t;
+
+/***
+ * @name: db_batch_t
+ * @description: 批量插入句柄，缓存预编译的INSERT语句，多行合并到一个事务中提交
+ */
+typedef struct db_batch_s
+{
+    sqlite3        *db;                 // 数据库句柄
+    sqlite3_stmt   *stmt;               // 缓存的INSERT语句
+    sqlite3_stmt   *dev_select;         // 缓存的设备id查询语句
+    sqlite3_stmt   *dev_insert;         // 缓存的设备插入语句
+    db_device_t    *devices;            // 设备id缓存
+    int             max_rows;           // 每个事务最多插入的行数
+    int             max_ms;             // 事务最长持续时间(ms)
+    int             pending;            // 当前事务中未提交的行数
+    long long       begin_ms;           // 当前事务开始时间(ms)
+    uint64_t        rows;               // 已提交的行数
+    uint64_t        commits;            // 已提交的事务数
+    uint64_t        failures;           // 提交失败被回滚的事务数，存储线程插入失败时也累加
+} db_batch_t;
+
+int database_profile_parse(const char *str, db_profile_t *profile);
+
+int database_init(char *dbname, sqlite3 **db, const db_profile_t *profile);
 
 int database_close(char *dbname, sqlite3 **db);
 
 int database_create_table(char *dbname, sqlite3 **db);
 
+int database_schema_init(char *legacy_table, sqlite3 **db);
+
 int database_insert_data(char *dbname, sqlite3 **db, packinfo_t *pack_info);
 
 int database_select_data(char *dbname, sqlite3 **db, packinfo_t *pack_info);
@@ -27,6 +90,16 @@ int database_delete_data(char *dbname, sqlite3 **db);
 
 int database_check_data(char *dbname, sqlite3 **db);
 
+int database_batch_init(char *dbname, sqlite3 **db, db_batch_t *batch, int max_rows, int max_ms);
+
+int database_batch_insert(db_batch_t *batch, packinfo_t *pack_info);
+
+int database_batch_commit(db_batch_t *batch);
+
+int database_batch_poll(db_batch_t *batch);
+
+int database_batch_close(db_batch_t *batch);
+
 
 
 
@@ -0,0 +1,58 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:00:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:00:00
+ * @Description: 存储线程入库前的重复记录过滤
+ */
+
+#ifndef _DEDUP_H_
+#define _DEDUP_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "logger.h"
+#include "packinfo.h"
+
+#define DEDUP_DEVICES       1024        // 跟踪的设备数，必须为2的幂
+#define DEDUP_WINDOW        16384       // 每个设备在高水位之下跟踪的时间槽数，必须为64的倍数，覆盖客户端整个发送窗口的重发
+#define DEDUP_RESOLUTION    1000        // 时间槽宽度(ms)，与客户端整秒的采样时间一致
+
+/***
+ * @name: dedup_device_t
+ * @description: 一个设备的已入库时间槽，以采样时间作为设备内的序号
+ *               high为已入库的最大时间槽，(high - DEDUP_WINDOW, high] 内的时间槽在环形位图中各占一位
+ */
+typedef struct dedup_device_s
+{
+    char            name[DEVID_LEN];                // 设备名，空串表示空闲
+    int64_t         high;                           // 高水位时间槽
+    uint64_t        bits[DEDUP_WINDOW / 64];        // 第slot % DEDUP_WINDOW位为1表示该时间槽已入库
+} dedup_device_t;
+
+/***
+ * @name: dedup_t
+ * @description: 重复记录过滤器，只由存储线程访问，计数器可由主线程读取
+ *               只在确定重复时丢弃，不确定的记录(窗口之外、非整秒、设备表已满)仍交给数据库的主键去重
+ */
+typedef struct dedup_s
+{
+    dedup_device_t *devices;                        // 按设备名开放寻址的哈希表
+    uint64_t        dropped;                        // 丢弃的重复记录数
+    uint64_t        untracked;                      // 无法判断而交给数据库的记录数
+} dedup_t;
+
+int dedup_init(dedup_t *dedup);
+
+void dedup_destroy(dedup_t *dedup);
+
+int dedup_check(dedup_t *dedup, const packinfo_t *pack_info);
+
+void dedup_mark(dedup_t *dedup, const packinfo_t *pack_info);
+
+void dedup_reset(dedup_t *dedup);
+
+#endif
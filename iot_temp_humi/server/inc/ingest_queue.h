@@ -0,0 +1,75 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:45:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:45:43
+ * @Description: 网络线程到存储线程的有界无锁多生产者单消费者队列
+ */
+
+#ifndef _INGEST_QUEUE_H_
+#define _INGEST_QUEUE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "logger.h"
+#include "packinfo.h"
+
+#define INGEST_QUEUE_SIZE       16384   // 默认队列容量，必须为2的幂
+#define CACHELINE_SIZE          64
+
+/***
+ * @name: ingest_slot_t
+ * @description: 队列槽位，seq 用于生产者和消费者之间交接槽位的所有权
+ */
+typedef struct ingest_slot_s
+{
+    uint64_t        seq;
+    int             src;                        // 来源编号
+    packinfo_t      pack;
+} ingest_slot_t;
+
+/***
+ * @name: ingest_queue_t
+ * @description: 有界MPSC环形队列(Vyukov算法)，入队和出队都不加锁
+ *               head由多个网络线程竞争，tail只由存储线程修改，分别放在不同缓存行
+ */
+typedef struct ingest_queue_s
+{
+    ingest_slot_t  *slots;                      // 槽位数组
+    uint64_t        mask;                       // 容量-1
+    uint64_t        capacity;                   // 容量
+    int             efd;                        // 唤醒存储线程的eventfd
+
+    char            pad0[CACHELINE_SIZE];
+    uint64_t        head;                       // 下一个入队位置
+    char            pad1[CACHELINE_SIZE - sizeof(uint64_t)];
+    uint64_t        tail;                       // 下一个出队位置
+    int             sleeping;                   // 存储线程是否在等待
+    char            pad2[CACHELINE_SIZE - sizeof(uint64_t) - sizeof(int)];
+
+    uint64_t        high_water;                 // 队列深度最高水位
+    uint64_t        full_count;                 // 队列已满导致入队失败的次数
+} ingest_queue_t;
+
+int ingest_queue_init(ingest_queue_t *queue, uint64_t capacity);
+
+void ingest_queue_destroy(ingest_queue_t *queue);
+
+int ingest_queue_push(ingest_queue_t *queue, const packinfo_t *pack, int src);
+
+int ingest_queue_pop(ingest_queue_t *queue, packinfo_t *pack, int *src);
+
+int ingest_queue_wait(ingest_queue_t *queue, int timeout_ms);
+
+void ingest_queue_wakeup(ingest_queue_t *queue);
+
+uint64_t ingest_queue_depth(ingest_queue_t *queue);
+
+#endif
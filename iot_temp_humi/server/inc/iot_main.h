@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-11 21:14:55
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 22:38:36
+ * @LastEditTime: 2026-10-17 19:14:13
  * @Description: 服务器端
  */
 
@@ -24,11 +24,16 @@
 #include <sys/epoll.h>  // for epoll
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <signal.h>
+#include <pthread.h>
 
 #include "database.h"
 #include "logger.h"
 #include "packinfo.h"
 #include "sqlite3.h"
 #include "socket_server.h"
+#include "worker.h"
+#include "ingest_queue.h"
+#include "storage.h"
 
 #endif  
@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-05 22:32:51
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 21:11:36
+ * @LastEditTime: 2026-10-17 19:36:30
  * @Description: 传输数据结构体
  */
 
@@ -10,21 +10,47 @@
 #define __PACKINFO_H__
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 #include "logger.h"
 
 #define DEVID_LEN   16
 #define TIME_LEN    32
+#define PACKINFO_DELIM  '/'     // 文本帧字段分隔符
+#define PACKINFO_FIELDS 4       // 文本帧字段数
 
 
 typedef struct packinfo_st
 {
     char devid[DEVID_LEN];
     char time[TIME_LEN];
+    int64_t ts;             // 采样时间，epoch毫秒
     float temp;
     float humi;
 } packinfo_t;
 
+/***
+ * @name: packinfo_view_t
+ * @description: 文本帧解析结果，devid和time指向接收缓冲区内部，不以'\0'结尾
+ */
+typedef struct packinfo_view_s
+{
+    const char     *devid;          // 设备名
+    size_t          devid_len;
+    const char     *time;           // 本地时间字符串
+    size_t          time_len;
+    int64_t         ts;             // 采样时间，epoch毫秒
+    float           temp;
+    float           humi;
+} packinfo_view_t;
+
+int64_t packinfo_parse_time(const char *datime, size_t len);
+
+int packinfo_parse_view(const char *buf, size_t len, packinfo_view_t *view);
+
+int packinfo_parse(const char *buf, size_t len, packinfo_t *pack_info);
+
 int data_segmentation(char *buf, packinfo_t *pack_info);
 
 #endif
\ No newline at end of file
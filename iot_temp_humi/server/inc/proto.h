@@ -0,0 +1,94 @@
+/***
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:45:43
+ * @Description: 客户端与服务器之间的二进制传输协议
+ *
+ *   连接建立后客户端先发送文本握手行 "HELLO <最高版本>\n"，服务器应答 "HELLO <选定版本>\n"
+ *   选定版本为0或没有应答时继续使用文本帧 "devid/time/temp/humi\n"
+ *
+ *   二进制帧(多字节字段均为小端):
+ *   +------+------+--------+---------------+--------+
+ *   | 0xA5 | type | len u16| payload[len]  | crc u16|
+ *   +------+------+--------+---------------+--------+
+ *   crc为CRC-16/CCITT-FALSE，覆盖type、len和payload
+ *
+ *   PROTO_TYPE_DEVICE  u16 设备号 + 设备名，为本连接注册设备号
+ *   PROTO_TYPE_RECORD  u16 设备号 + s64 epoch毫秒 + s16 温度(0.01℃) + u16 湿度(0.01%RH)，共20字节
+ *   PROTO_TYPE_BATCH   u32 序号 + u16 记录数 + 若干条与RECORD负载相同的14字节记录，用于发送缓存的数据(版本2)
+ *   PROTO_TYPE_ACK     u32 序号，服务器把记录提交到数据库后发给客户端，确认序号不大于该值的批量帧(版本2)
+ *
+ *   版本1只有DEVICE和RECORD帧，写入成功即视为送达
+ *   版本2的批量帧序号在每个连接上从1开始递增，服务器按序累计确认，客户端收到确认后才删除缓存
+ */
+
+#ifndef _PROTO_H_
+#define _PROTO_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PROTO_MAGIC         0xA5        // 二进制帧起始字节
+#define PROTO_VERSION       2           // 支持的最高二进制协议版本，0为文本协议
+#define PROTO_VERSION_ACK   2           // 支持批量帧和确认帧的最低版本
+#define PROTO_HELLO         "HELLO"     // 握手行前缀
+#define PROTO_HELLO_TIMEOUT 1000        // 客户端等待握手应答的超时(ms)
+#define PROTO_HDR_LEN       4           // magic + type + len
+#define PROTO_CRC_LEN       2           // crc
+#define PROTO_MAX_PAYLOAD   2048        // 最大负载长度，整帧必须能放进服务器的连接接收缓冲区
+#define PROTO_MAX_FRAME     (PROTO_HDR_LEN + PROTO_MAX_PAYLOAD + PROTO_CRC_LEN)
+#define PROTO_MAX_DEVICES   16          // 每个连接可注册的设备数
+#define PROTO_RECORD_LEN    14          // 记录帧负载长度
+#define PROTO_BATCH_HDR_LEN 6           // 批量帧负载头: 序号 + 记录数
+#define PROTO_BATCH_MAX     ((PROTO_MAX_PAYLOAD - PROTO_BATCH_HDR_LEN) / PROTO_RECORD_LEN)  // 批量帧最多包含的记录数
+#define PROTO_ACK_FRAME_LEN (PROTO_HDR_LEN + 4 + PROTO_CRC_LEN)                         // 确认帧长度
+
+/***
+ * @name: PROTO_TYPE
+ * @description: 二进制帧类型
+ */
+enum PROTO_TYPE
+{
+    PROTO_TYPE_DEVICE = 1,              // 注册设备号
+    PROTO_TYPE_RECORD = 2,              // 一条采样记录
+    PROTO_TYPE_BATCH  = 3,              // 多条采样记录
+    PROTO_TYPE_ACK    = 4               // 累计确认
+};
+
+/***
+ * @name: proto_record_t
+ * @description: 解码后的采样记录
+ */
+typedef struct proto_record_s
+{
+    uint16_t        dev;                // 本连接注册的设备号
+    int64_t         ts;                 // 采样时间，epoch毫秒
+    int16_t         temp;               // 温度，0.01℃
+    uint16_t        humi;               // 湿度，0.01%RH
+} proto_record_t;
+
+uint16_t proto_crc16(const uint8_t *buf, size_t len);
+
+int proto_encode_device(uint8_t *buf, size_t size, uint16_t dev, const char *name);
+
+int proto_encode_record(uint8_t *buf, size_t size, const proto_record_t *rec);
+
+int proto_encode_batch(uint8_t *buf, size_t size, uint32_t seq, const proto_record_t *recs, int count);
+
+int proto_encode_ack(uint8_t *buf, size_t size, uint32_t seq);
+
+int proto_decode(const uint8_t *buf, size_t len, int *type, const uint8_t **payload, size_t *plen);
+
+int proto_parse_device(const uint8_t *payload, size_t plen, uint16_t *dev, char *name, size_t size);
+
+int proto_parse_record(const uint8_t *payload, size_t plen, proto_record_t *rec);
+
+int proto_batch_count(const uint8_t *payload, size_t plen, uint32_t *seq);
+
+int proto_parse_ack(const uint8_t *payload, size_t plen, uint32_t *seq);
+
+int proto_parse_hello(const char *line);
+
+#endif
@@ -2,7 +2,7 @@
  * @Author: RoxyKko
  * @Date: 2023-04-11 21:16:03
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 22:02:22
+ * @LastEditTime: 2026-10-17 19:11:00
  * @Description: 服务器端socket
  */
 
@@ -24,7 +24,7 @@
 #include <netinet/in.h>
 
 
-int socket_server_init(char *listen_ip, int listen_port);
+int socket_server_init(char *listen_ip, int listen_port, int reuseport);
 
 void set_socket_rlimit();
 
@@ -0,0 +1,72 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:01:14
+ * @Description: 服务器端存储线程
+ */
+
+#ifndef _STORAGE_H_
+#define _STORAGE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "logger.h"
+#include "packinfo.h"
+#include "database.h"
+#include "ingest_queue.h"
+#include "dedup.h"
+
+#define STORAGE_WAIT_TIMEOUT    100     // 队列为空时的等待超时(ms)
+#define STORAGE_BATCH_ROWS      256     // 默认每个事务最多提交的行数
+#define STORAGE_BATCH_MS        200     // 默认事务最长持续时间(ms)
+#define STORAGE_MAX_SOURCES     64      // 最多的记录来源数，与WORKER_MAX相同
+
+/***
+ * @name: storage_source_t
+ * @description: 一个记录来源(工作线程)的处理进度，done和lost由存储线程写入、来源读取，seen由来源写入
+ *               同一来源的记录按入队顺序处理，前done条都已提交或随失败的事务回滚
+ */
+typedef struct storage_source_s
+{
+    uint64_t            done;           // 已处理的记录数
+    uint64_t            lost;           // 最近一次失败的事务结束时的done，(lost_from, lost]中的记录可能没有写入
+    uint64_t            lost_from;      // 失败范围的起点，来源还没看到上一次失败时与之合并
+    uint64_t            seen;           // 来源已处理过的lost，由来源写入
+    uint64_t            txn;            // 当前事务中该来源的记录数，只由存储线程访问
+    int                 efd;            // 处理进度更新时写入的eventfd，-1为不通知
+    char                pad[CACHELINE_SIZE - 5 * sizeof(uint64_t) - sizeof(int)];
+} storage_source_t;
+
+/***
+ * @name: storage_t
+ * @description: 存储线程，独占数据库句柄，从入库队列取出记录写入数据库
+ */
+typedef struct storage_s
+{
+    pthread_t           tid;            // 线程id
+    char               *table;          // 数据库表名
+    sqlite3           **db;             // 数据库句柄
+    ingest_queue_t     *queue;          // 入库队列
+    int                 batch_rows;     // 每个事务最多提交的行数
+    int                 batch_ms;       // 事务最长持续时间(ms)
+    db_batch_t          batch;          // 批量插入句柄
+    int                 stop;           // 为1时写完队列中剩余的记录后退出
+    uint64_t            records;        // 入库记录数
+    uint64_t            errors;         // 入库失败次数
+    uint64_t            failures;       // 已通知来源的提交失败次数
+    storage_source_t    sources[STORAGE_MAX_SOURCES];   // 各来源的处理进度
+    dedup_t             dedup;          // 入库前的重复记录过滤
+} storage_t;
+
+int storage_start(storage_t *storage);
+
+void storage_stop(storage_t *storage);
+
+void storage_attach(storage_t *storage, int src, int efd);
+
+#endif
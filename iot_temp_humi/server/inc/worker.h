@@ -0,0 +1,81 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:45:43
+ * @Description: 服务器端epoll工作线程
+ */
+
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "logger.h"
+#include "packinfo.h"
+#include "ingest_queue.h"
+#include "socket_server.h"
+#include "connection.h"
+#include "storage.h"
+
+#define WORKER_MAX              64      // 最大工作线程数
+#define WORKER_MAX_EVENTS       512     // 单次epoll_wait最多返回的事件数
+#define WORKER_WAIT_TIMEOUT     1000    // epoll_wait超时(ms)，用于检查停止信号
+#define WORKER_RETRY_TIMEOUT    5       // 有连接因入库队列已满暂停读取时的epoll_wait超时(ms)
+
+extern volatile int g_sigstop;          // 停止信号
+
+/***
+ * @name: worker_stat_t
+ * @description: 工作线程计数器，仅由所属线程写入，主线程读取快照
+ */
+typedef struct worker_stat_s
+{
+    uint64_t    accepts;                // 接受的连接数
+    uint64_t    closes;                 // 关闭的连接数
+    uint64_t    reads;                  // read()次数
+    uint64_t    bytes;                  // 接收字节数
+    uint64_t    records;                // 送入入库队列的记录数
+    uint64_t    errors;                 // 解析失败次数
+    uint64_t    stalls;                 // 入库队列已满导致暂停读取的次数
+    uint64_t    wakeups;                // epoll_wait返回事件的次数
+    uint64_t    acks;                   // 发送的确认帧数
+} worker_stat_t;
+
+/***
+ * @name: worker_t
+ * @description: 工作线程，独占一个SO_REUSEPORT监听套接字和一个epoll实例
+ */
+typedef struct worker_s
+{
+    int                 id;             // 线程编号
+    int                 cpu;            // 绑定的CPU核
+    int                 listenfd;       // 监听套接字
+    int                 epollfd;        // epoll句柄
+    pthread_t           tid;            // 线程id
+    conn_t             *conns;          // 本线程持有的客户端连接
+    conn_t             *blocked;        // 因入库队列已满暂停读取的连接
+    ingest_queue_t     *queue;          // 入库队列
+    storage_t          *storage;        // 存储线程，记录提交后通过efd通知本线程发送确认
+    int                 efd;            // 存储线程的提交通知
+    uint64_t            pushed;         // 本线程送入入库队列的记录数
+    conn_t             *acking;         // 有批量帧等待确认的连接
+    worker_stat_t       stat;           // 计数器
+} worker_t;
+
+int worker_init(worker_t *worker, int id, char *listen_ip, int listen_port, int reuseport);
+
+int worker_start(worker_t *worker);
+
+void worker_join(worker_t *worker);
+
+void worker_stat_snapshot(worker_t *worker, worker_stat_t *stat);
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:30:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:45:43
+ * @Description: 服务器端客户端连接及接收缓冲区
+ */
+
+#include "connection.h"
+
+/**
+ * @name: int set_nonblocking(int fd)
+ * @description: 将文件描述符设置为非阻塞
+ * @param {int} fd 文件描述符
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int set_nonblocking(int fd)
+{
+    int flags;
+
+    if ((flags = fcntl(fd, F_GETFL, 0)) < 0)
+    {
+        return -1;
+    }
+
+    if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return -2;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: conn_t *conn_new(int fd)
+ * @description: 为新连接分配连接结构体
+ * @param {int} fd 客户端套接字
+ * @return {conn_t} 成功返回连接指针，失败返回NULL
+ */
+conn_t *conn_new(int fd)
+{
+    conn_t *conn;
+
+    if ((conn = malloc(sizeof(conn_t))) == NULL)
+    {
+        log_error("conn_new() malloc failure: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    conn->fd       = fd;
+    conn->rx_head  = 0;
+    conn->rx_tail  = 0;
+    conn->readable = 0;
+    conn->closing  = 0;
+    conn->blocked  = 0;
+    conn->proto    = 0;
+    conn->batch_done = 0;
+    conn->acked    = 0;
+    conn->ack_head = 0;
+    conn->ack_count = 0;
+    conn->acking   = 0;
+    memset(conn->devices, 0, sizeof(conn->devices));
+    conn->prev     = NULL;
+    conn->next     = NULL;
+    conn->next_blocked = NULL;
+    conn->next_acking  = NULL;
+
+    return conn;
+}
+
+/**
+ * @name: void conn_free(conn_t *conn)
+ * @description: 关闭套接字并释放连接
+ * @param {conn_t} *conn 连接
+ * @return {*}
+ */
+void conn_free(conn_t *conn)
+{
+    if (!conn)
+    {
+        return;
+    }
+
+    if (conn->fd >= 0)
+    {
+        close(conn->fd);
+    }
+    free(conn);
+}
+
+/**
+ * @name: int conn_recv(conn_t *conn)
+ * @description: 向接收缓冲区读入数据，直到缓冲区满或套接字返回EAGAIN
+ *               读之前先把未处理的半帧移动到缓冲区开头
+ * @param {conn_t} *conn 连接
+ * @return {int} enum CONN_RECV，读入的数据在任何返回值下都需要先取帧处理
+ */
+int conn_recv(conn_t *conn)
+{
+    ssize_t     rv;
+
+    if (conn->rx_head > 0)
+    {
+        memmove(conn->rxbuf, conn->rxbuf + conn->rx_head, conn->rx_tail - conn->rx_head);
+        conn->rx_tail -= conn->rx_head;
+        conn->rx_head  = 0;
+    }
+
+    // 整个缓冲区都是同一个未结束的帧
+    if (conn->rx_tail >= sizeof(conn->rxbuf))
+    {
+        log_error("socket[%d] frame exceeds %d bytes\n", conn->fd, CONN_RXBUF_SIZE);
+        return CONN_RECV_ERROR;
+    }
+
+    while (conn->rx_tail < sizeof(conn->rxbuf))
+    {
+        rv = read(conn->fd, conn->rxbuf + conn->rx_tail, sizeof(conn->rxbuf) - conn->rx_tail);
+        if (rv > 0)
+        {
+            conn->rx_tail += rv;
+            continue;
+        }
+
+        if (rv == 0)
+        {
+            return CONN_RECV_EOF;
+        }
+
+        if (errno == EINTR)
+        {
+            continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return CONN_RECV_AGAIN;
+        }
+
+        return CONN_RECV_ERROR;
+    }
+
+    return CONN_RECV_FULL;
+}
+
+/**
+ * @name: int conn_next_frame(conn_t *conn, char **frame, size_t *len)
+ * @description: 从接收缓冲区中取出下一个完整的帧
+ *               文本协议下帧结束符被替换为'\0'，二进制协议下frame指向整个帧(含帧头和crc)
+ * @param {conn_t} *conn 连接
+ * @param {char} **frame 帧起始地址，指向接收缓冲区内部
+ * @param {size_t} *len 帧长度，文本帧不含结束符
+ * @return {int} enum CONN_FRAME
+ */
+int conn_next_frame(conn_t *conn, char **frame, size_t *len)
+{
+    char           *start = conn->rxbuf + conn->rx_head;
+    char           *end;
+    const uint8_t  *payload;
+    size_t          plen;
+    int             type;
+    int             rv;
+
+    if (conn->proto)
+    {
+        rv = proto_decode((uint8_t *)start, conn->rx_tail - conn->rx_head, &type, &payload, &plen);
+        if (rv < 0)
+        {
+            log_error("socket[%d] bad binary frame (%d)\n", conn->fd, rv);
+            return CONN_FRAME_BAD;
+        }
+        if (rv == 0)
+        {
+            return CONN_FRAME_NONE;
+        }
+
+        *frame = start;
+        *len   = rv;
+        conn->rx_head += rv;
+        return CONN_FRAME_OK;
+    }
+
+    end = memchr(start, CONN_FRAME_DELIM, conn->rx_tail - conn->rx_head);
+    if (!end)
+    {
+        return CONN_FRAME_NONE;
+    }
+
+    *end   = '\0';
+    *frame = start;
+    *len   = end - start;
+    conn->rx_head = end - conn->rxbuf + 1;
+
+    return CONN_FRAME_OK;
+}
+
+/**
+ * @name: void conn_unget_frame(conn_t *conn, char *frame, size_t len)
+ * @description: 把conn_next_frame()取出的帧放回接收缓冲区，下次重新取出
+ * @param {conn_t} *conn 连接
+ * @param {char} *frame 帧起始地址
+ * @param {size_t} len 帧长度
+ * @return {*}
+ */
+void conn_unget_frame(conn_t *conn, char *frame, size_t len)
+{
+    if (!conn->proto)
+    {
+        frame[len] = CONN_FRAME_DELIM;
+    }
+    conn->rx_head = frame - conn->rxbuf;
+}
@@ -2,20 +2,149 @@
  * @Author: RoxyKko
  * @Date: 2023-04-05 20:54:52
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-10 23:57:16
+ * @LastEditTime: 2026-10-17 20:48:55
  * @Description: 数据库sqlite的使用
  */
 
 #include "database.h"
 
+/*** 
+ * @description: 存储配置预设
+ *   durable    WAL + synchronous=FULL，每次提交都落盘，掉电不丢已提交的数据
+ *   throughput WAL + synchronous=NORMAL，只在检查点时fsync，掉电可能丢最后几个事务，但数据库不会损坏
+ */
+static const db_profile_t db_profile_presets[] =
+{
+    { "durable",    "WAL", "FULL",   0,                4096, -2000, 1000 },
+    { "throughput", "WAL", "NORMAL", 64 * 1024 * 1024, 4096, -8192, 4000 },
+};
+
 /**
- * @name: database_init(char *dbname)
+ * @name: int database_profile_parse(const char *str, db_profile_t *profile)
+ * @description: 解析存储配置字符串，格式为 预设名[,键=值...]，如 "throughput,mmap_size=0,synchronous=FULL"
+ *               可用的键: journal_mode synchronous mmap_size page_size cache_size wal_autocheckpoint
+ * @param {char} *str 配置字符串
+ * @param {db_profile_t} *profile 解析结果
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_profile_parse(const char *str, db_profile_t *profile)
+{
+    char    buf[256];
+    char   *token;
+    char   *saveptr = NULL;
+    char   *value;
+    int     i;
+
+    if ((str == NULL) || (profile == NULL) || (strlen(str) >= sizeof(buf)))
+    {
+        log_error("The database_profile_parse() argument incorrect!\n");
+        return -1;
+    }
+
+    strcpy(buf, str);
+    token = strtok_r(buf, ",", &saveptr);
+    for (i = 0; i < sizeof(db_profile_presets) / sizeof(db_profile_presets[0]); i++)
+    {
+        if (token && !strcasecmp(token, db_profile_presets[i].name))
+        {
+            *profile = db_profile_presets[i];
+            break;
+        }
+    }
+    if (i == sizeof(db_profile_presets) / sizeof(db_profile_presets[0]))
+    {
+        log_error("Unknown storage profile: %s\n", token ? token : "");
+        return -2;
+    }
+
+    while ((token = strtok_r(NULL, ",", &saveptr)) != NULL)
+    {
+        if ((value = strchr(token, '=')) == NULL)
+        {
+            log_error("Storage profile option '%s' is not key=value\n", token);
+            return -3;
+        }
+        *value++ = '\0';
+
+        if (!strcasecmp(token, "journal_mode"))
+        {
+            snprintf(profile->journal_mode, sizeof(profile->journal_mode), "%s", value);
+        }
+        else if (!strcasecmp(token, "synchronous"))
+        {
+            snprintf(profile->synchronous, sizeof(profile->synchronous), "%s", value);
+        }
+        else if (!strcasecmp(token, "mmap_size"))
+        {
+            profile->mmap_size = atoll(value);
+        }
+        else if (!strcasecmp(token, "page_size"))
+        {
+            profile->page_size = atoi(value);
+        }
+        else if (!strcasecmp(token, "cache_size"))
+        {
+            profile->cache_size = atoi(value);
+        }
+        else if (!strcasecmp(token, "wal_autocheckpoint"))
+        {
+            profile->wal_autocheckpoint = atoi(value);
+        }
+        else
+        {
+            log_error("Unknown storage profile option: %s\n", token);
+            return -4;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static int database_apply_profile(sqlite3 *db, const db_profile_t *profile)
+ * @description: 打开数据库后一次性设置存储相关的PRAGMA
+ *               page_size只对新建的数据库文件生效，必须在切换journal_mode之前设置
+ * @param {sqlite3} *db 数据库句柄
+ * @param {db_profile_t} *profile 存储配置
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int database_apply_profile(sqlite3 *db, const db_profile_t *profile)
+{
+    char    sql[512]    = {0};
+    char   *zErrMsg     = 0;
+
+    snprintf(sql, sizeof(sql),
+             "PRAGMA page_size=%d;"
+             "PRAGMA journal_mode=%s;"
+             "PRAGMA synchronous=%s;"
+             "PRAGMA mmap_size=%lld;"
+             "PRAGMA cache_size=%d;"
+             "PRAGMA wal_autocheckpoint=%d;",
+             profile->page_size, profile->journal_mode, profile->synchronous,
+             profile->mmap_size, profile->cache_size, profile->wal_autocheckpoint);
+
+    if (sqlite3_exec(db, sql, 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("Sqlite apply storage profile error:%s\n", zErrMsg);
+        sqlite3_free(zErrMsg);
+        return -1;
+    }
+
+    log_info("Storage profile %s: journal_mode=%s synchronous=%s mmap_size=%lld page_size=%d cache_size=%d wal_autocheckpoint=%d\n",
+             profile->name, profile->journal_mode, profile->synchronous, profile->mmap_size,
+             profile->page_size, profile->cache_size, profile->wal_autocheckpoint);
+    return 0;
+}
+
+/**
+ * @name: database_init(char *dbname, sqlite3 **db, const db_profile_t *profile)
  * @description: 数据库sqlite初始化
  * @param {char} *dbname database文件名
  * @param {sqlite3} *db 数据库指针
+ * @param {db_profile_t} *profile 存储配置，为NULL时使用sqlite默认配置
  * @return {int} 0为正常执行，非0则出现错误
  */
-int database_init(char *dbname, sqlite3 **db)
+int database_init(char *dbname, sqlite3 **db, const db_profile_t *profile)
 {
     
     int     rv          = -1;
@@ -35,11 +164,19 @@ int database_init(char *dbname, sqlite3 **db)
         log_error("Can't open database: %s\n", sqlite3_errmsg(*db));
         return -2;
     }
-    else
+
+    // WAL模式下读者不会阻塞写入
+    if (profile && database_apply_profile(*db, profile) < 0)
     {
-        log_info("Opened database successfully!\n");
-        return 0;
+        sqlite3_close(*db);
+        return -3;
     }
+
+    // 迁移工具等其他写者持有写锁时等待而不是直接返回SQLITE_BUSY
+    sqlite3_busy_timeout(*db, DB_BUSY_TIMEOUT);
+
+    log_info("Opened database successfully!\n");
+    return 0;
 }
 
 /**
@@ -116,6 +253,157 @@ int database_create_table(char *dbname, sqlite3 **db)
     return 0;
 }
 
+/**
+ * @name: static int database_user_version(sqlite3 *db)
+ * @description: 读取数据库文件的模式版本号(PRAGMA user_version)
+ * @param {sqlite3} *db 数据库句柄
+ * @return {int} 版本号，负数则出现错误
+ */
+static int database_user_version(sqlite3 *db)
+{
+    sqlite3_stmt   *stmt;
+    int             version = -1;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Sqlite read user_version error:%s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    if (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    return version;
+}
+
+/**
+ * @name: static int database_table_exists(sqlite3 *db, const char *table)
+ * @description: 判断表是否存在
+ * @param {sqlite3} *db 数据库句柄
+ * @param {char} *table 表名
+ * @return {int} 1为存在，0为不存在，负数则出现错误
+ */
+static int database_table_exists(sqlite3 *db, const char *table)
+{
+    sqlite3_stmt   *stmt;
+    int             rv;
+
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM sqlite_master WHERE type='table' AND name=?;", -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Sqlite query sqlite_master error:%s\n", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+    rv = sqlite3_step(stmt) == SQLITE_ROW;
+    sqlite3_finalize(stmt);
+
+    return rv;
+}
+
+/**
+ * @name: static int database_exec(sqlite3 *db, const char *sql)
+ * @description: 执行不需要返回结果的SQL，出错时记录日志
+ * @param {sqlite3} *db 数据库句柄
+ * @param {char} *sql SQL语句
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int database_exec(sqlite3 *db, const char *sql)
+{
+    char   *zErrMsg     = 0;
+
+    if (sqlite3_exec(db, sql, 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("Sqlite exec error:%s\n", zErrMsg);
+        sqlite3_free(zErrMsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int database_schema_init(char *legacy_table, sqlite3 **db)
+ * @description: 创建带类型的时序表
+ *   旧版全文本表不在启动时转换，数据量大时会让服务器长时间离线，由sht20_migrate工具在线迁移
+ *   devices(id, name)                      设备名到整数id的映射
+ *   samples(device, ts, temp, humi)        WITHOUT ROWID，按(device, ts)聚簇
+ *                                          ts为epoch毫秒，temp/humi为0.01定点整数
+ *   samples_view                           还原为设备名、本地时间和浮点读数的视图
+ *   PRAGMA user_version 记录模式版本，为0时视为旧文件
+ * @param {char} *legacy_table 旧版表名(SN/DATIME/TEMP/HUMI全为CHAR)，为NULL时不检查
+ * @param {sqlite3} **db 数据库指针
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_schema_init(char *legacy_table, sqlite3 **db)
+{
+    char    sql[1024]   = {0};
+    int     version;
+    int     legacy;
+
+    if (db == NULL)
+    {
+        log_error("The database_schema_init() argument incorrect!\n");
+        return -1;
+    }
+
+    if ((version = database_user_version(*db)) < 0)
+    {
+        return -2;
+    }
+
+    if (version > DB_SCHEMA_VERSION)
+    {
+        log_error("Database schema version %d is newer than supported version %d\n", version, DB_SCHEMA_VERSION);
+        return -3;
+    }
+
+    legacy = legacy_table ? database_table_exists(*db, legacy_table) : 0;
+    if (legacy > 0)
+    {
+        log_warn("Legacy table %s found, run sht20_migrate to move its rows into %s\n", legacy_table, DB_SAMPLE_TABLE);
+    }
+
+    if (version == DB_SCHEMA_VERSION)
+    {
+        log_info("database schema version %d\n", version);
+        return 0;
+    }
+
+    if (database_exec(*db, "BEGIN IMMEDIATE;") < 0)
+    {
+        return -4;
+    }
+
+    snprintf(sql, sizeof(sql),
+             "CREATE TABLE IF NOT EXISTS %s(id INTEGER PRIMARY KEY, name TEXT NOT NULL UNIQUE);"
+             "CREATE TABLE IF NOT EXISTS %s(device INTEGER NOT NULL, ts INTEGER NOT NULL,"
+             " temp INTEGER NOT NULL, humi INTEGER NOT NULL, PRIMARY KEY(device, ts)) WITHOUT ROWID;"
+             "CREATE VIEW IF NOT EXISTS %s_view AS SELECT d.name AS devid,"
+             " datetime(s.ts / 1000, 'unixepoch', 'localtime') AS datime, s.ts AS ts,"
+             " s.temp / 100.0 AS temp, s.humi / 100.0 AS humi"
+             " FROM %s s JOIN %s d ON d.id = s.device;",
+             DB_DEVICE_TABLE, DB_SAMPLE_TABLE, DB_SAMPLE_TABLE, DB_SAMPLE_TABLE, DB_DEVICE_TABLE);
+    if (database_exec(*db, sql) < 0)
+    {
+        database_exec(*db, "ROLLBACK;");
+        return -5;
+    }
+
+    snprintf(sql, sizeof(sql), "PRAGMA user_version=%d;", DB_SCHEMA_VERSION);
+    if ((database_exec(*db, sql) < 0) || (database_exec(*db, "COMMIT;") < 0))
+    {
+        database_exec(*db, "ROLLBACK;");
+        return -6;
+    }
+
+    log_info("database_schema_init: schema version %d -> %d\n", version, DB_SCHEMA_VERSION);
+    return 0;
+}
+
 /**
  * @name: database_insert_data(char *dbname, sqlite3 *db, packinfo_t pack_info)
  * @description: 向数据库中插入数据
@@ -156,19 +444,18 @@ int database_insert_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
 
 /**
  * @name: database_select_data(char *dbname, sqlite3 *db, packinfo_t pack_info)
- * @description: 选择数据库文件并返回第一条数据到pack_info
+ * @description: 选择数据库文件并返回第一条数据到pack_info，逐行step预编译语句，不分配结果表
  * @param {char} *dbname database文件名
  * @param {sqlite3} *db 数据库指针
  * @param {packinfo_t} pack_info 数据结构体
- * @return {int} 返回剩余行数，负数则出现错误
+ * @return {int} 1为取到数据，0为表中没有数据，负数则出现错误
  */
 int database_select_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
 {
-    char    sql[128]    = {0};
-    int     rv          = -1;
-    char   *zErrMsg     = 0;  
-    char  **dbResult;                   // 二维数组，存放结果
-    int     nRow=0, nColumn=0;          // 行数和列数
+    char            sql[128]    = {0};
+    sqlite3_stmt   *stmt        = NULL;
+    const char     *text;
+    int             rv          = -1;
 
     if((dbname == NULL) || (db == NULL) || (pack_info == NULL))
     {
@@ -176,27 +463,38 @@ int database_select_data(char *dbname, sqlite3 **db, packinfo_t *pack_info)
         return -1;
     }
 
-    memset(sql, 0, sizeof(sql));
-    sprintf(sql, "SELECT * FROM %s LIMIT 1;", dbname);          // 选择第一条数据
-
-    rv = sqlite3_get_table(*db, sql, &dbResult, &nRow, &nColumn, &zErrMsg);
-    if (rv != SQLITE_OK)
+    snprintf(sql, sizeof(sql), "SELECT SN, DATIME, TEMP, HUMI FROM %s ORDER BY rowid LIMIT 1;", dbname);  // 选择第一条数据
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
     {
-        log_error("Sqlite_select_data error:%s\n", zErrMsg);
-        sqlite3_free(zErrMsg);
+        log_error("Sqlite_select_data error:%s\n", sqlite3_errmsg(*db));
         return -2;
     }
 
     memset(pack_info, 0, sizeof(packinfo_t));
-    // 0-3 四个存第一行的标签，4-7四个存第二行的数据
-    strcpy(pack_info->devid, dbResult[4]);
-    strcpy(pack_info->time, dbResult[5]);
-    pack_info->temp = atof(dbResult[6]);
-    pack_info->humi = atof(dbResult[7]);
-    log_info("Last data select table successfully: %s, %s, %f, %f\n",
-             pack_info->devid, pack_info->time, pack_info->temp, pack_info->humi);
+    if ((rv = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        if ((text = (const char *)sqlite3_column_text(stmt, 0)) != NULL)
+        {
+            snprintf(pack_info->devid, sizeof(pack_info->devid), "%s", text);
+        }
+        if ((text = (const char *)sqlite3_column_text(stmt, 1)) != NULL)
+        {
+            snprintf(pack_info->time, sizeof(pack_info->time), "%s", text);
+        }
+        pack_info->temp = sqlite3_column_double(stmt, 2);
+        pack_info->humi = sqlite3_column_double(stmt, 3);
+        log_info("Last data select table successfully: %s, %s, %f, %f\n",
+                 pack_info->devid, pack_info->time, pack_info->temp, pack_info->humi);
+    }
+    sqlite3_finalize(stmt);
 
-    return nRow;
+    if ((rv != SQLITE_ROW) && (rv != SQLITE_DONE))
+    {
+        log_error("Sqlite_select_data error:%s\n", sqlite3_errmsg(*db));
+        return -3;
+    }
+
+    return rv == SQLITE_ROW;
 }
 
 /**
@@ -234,13 +532,18 @@ int database_delete_data(char *dbname, sqlite3 **db)
     return 0;
 }
 
+/**
+ * @name: int database_check_data(char *dbname, sqlite3 **db)
+ * @description: 检查表中是否有数据，只step一次预编译语句，不分配结果表
+ * @param {char} *dbname 表名
+ * @param {sqlite3} **db 数据库指针
+ * @return {int} 1为有数据，0为没有数据，负数则出现错误
+ */
 int database_check_data(char *dbname, sqlite3 **db)
 {
-    char    sql[128];
-    int     rv;
-    char   *zErrMsg = 0;
-    char  **dbResult;
-    int     nRow=0, nColumn=0;
+    char            sql[128];
+    sqlite3_stmt   *stmt        = NULL;
+    int             rv;
 
     if((dbname == NULL) || (db == NULL))
     {
@@ -248,16 +551,316 @@ int database_check_data(char *dbname, sqlite3 **db)
         return -1;
     }
 
-    memset(sql, 0, sizeof(sql));
-    sprintf(sql, "SELECT * FROM %s LIMIT 1;", dbname);          // 选择第一条数据
+    snprintf(sql, sizeof(sql), "SELECT 1 FROM %s LIMIT 1;", dbname);
+    if (sqlite3_prepare_v2(*db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Sqlite_check_data error:%s\n", sqlite3_errmsg(*db));
+        return -2;
+    }
 
-    rv = sqlite3_get_table(*db, sql, &dbResult, &nRow, &nColumn, &zErrMsg);
-    if (rv != SQLITE_OK)
+    rv = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if ((rv != SQLITE_ROW) && (rv != SQLITE_DONE))
+    {
+        log_error("Sqlite_check_data error:%s\n", sqlite3_errmsg(*db));
+        return -3;
+    }
+
+    return rv == SQLITE_ROW;
+}
+/**
+ * @name: static long long database_now_ms(void)
+ * @description: 获取单调时钟毫秒数，用于计算事务持续时间
+ * @return {long long} 毫秒数
+ */
+static long long database_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: int database_batch_init(char *dbname, sqlite3 **db, db_batch_t *batch, int max_rows, int max_ms)
+ * @description: 初始化批量插入，预编译并缓存INSERT语句和设备id查询语句
+ * @param {char} *dbname 时序表名
+ * @param {sqlite3} **db 数据库指针
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @param {int} max_rows 每个事务最多插入的行数，达到后立即提交
+ * @param {int} max_ms 事务最长持续时间(ms)，超过后提交
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_init(char *dbname, sqlite3 **db, db_batch_t *batch, int max_rows, int max_ms)
+{
+    char    sql[128]    = {0};
+
+    if ((dbname == NULL) || (db == NULL) || (batch == NULL) || (max_rows < 1) || (max_ms < 0))
+    {
+        log_error("The database_batch_init() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(batch, 0, sizeof(db_batch_t));
+    batch->db       = *db;
+    batch->max_rows = max_rows;
+    batch->max_ms   = max_ms;
+
+    if ((batch->devices = calloc(DB_DEVICE_CACHE_SIZE, sizeof(db_device_t))) == NULL)
+    {
+        log_error("database_batch_init calloc failure: %s\n", strerror(errno));
+        return -2;
+    }
+
+    // 同一毫秒的重复采样直接忽略
+    snprintf(sql, sizeof(sql), "INSERT OR IGNORE INTO %s(device, ts, temp, humi) VALUES (?, ?, ?, ?);", dbname);
+    if (sqlite3_prepare_v2(batch->db, sql, -1, &batch->stmt, NULL) != SQLITE_OK)
+    {
+        log_error("database_batch_init prepare error:%s\n", sqlite3_errmsg(batch->db));
+        database_batch_close(batch);
+        return -3;
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT id FROM %s WHERE name = ?;", DB_DEVICE_TABLE);
+    if (sqlite3_prepare_v2(batch->db, sql, -1, &batch->dev_select, NULL) != SQLITE_OK)
+    {
+        log_error("database_batch_init prepare error:%s\n", sqlite3_errmsg(batch->db));
+        database_batch_close(batch);
+        return -3;
+    }
+
+    snprintf(sql, sizeof(sql), "INSERT INTO %s(name) VALUES (?);", DB_DEVICE_TABLE);
+    if (sqlite3_prepare_v2(batch->db, sql, -1, &batch->dev_insert, NULL) != SQLITE_OK)
+    {
+        log_error("database_batch_init prepare error:%s\n", sqlite3_errmsg(batch->db));
+        database_batch_close(batch);
+        return -3;
+    }
+
+    log_info("database_batch_init: %s commit every %d rows or %d ms\n", dbname, max_rows, max_ms);
+    return 0;
+}
+
+/**
+ * @name: static int64_t database_device_id(db_batch_t *batch, const char *name)
+ * @description: 查找设备名对应的整数id，不存在则新建，结果缓存在开放寻址哈希表中
+ *               需在事务中调用，缓存满时退化为每次查询数据库
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @param {char} *name 设备名
+ * @return {int64_t} 设备id，负数则出现错误
+ */
+static int64_t database_device_id(db_batch_t *batch, const char *name)
+{
+    db_device_t    *dev  = NULL;
+    uint32_t        hash = 2166136261u;         // FNV-1a
+    int64_t         id   = -1;
+    const char     *p;
+    int             i;
+
+    for (p = name; *p; p++)
+    {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+
+    for (i = 0; i < DB_DEVICE_CACHE_SIZE; i++)
+    {
+        dev = &batch->devices[(hash + i) & (DB_DEVICE_CACHE_SIZE - 1)];
+        if (dev->name[0] == '\0')
+        {
+            break;
+        }
+        if (!strncmp(dev->name, name, sizeof(dev->name)))
+        {
+            return dev->id;
+        }
+    }
+
+    sqlite3_bind_text(batch->dev_select, 1, name, -1, SQLITE_STATIC);
+    if (sqlite3_step(batch->dev_select) == SQLITE_ROW)
+    {
+        id = sqlite3_column_int64(batch->dev_select, 0);
+    }
+    sqlite3_reset(batch->dev_select);
+
+    if (id < 0)
+    {
+        sqlite3_bind_text(batch->dev_insert, 1, name, -1, SQLITE_STATIC);
+        if (sqlite3_step(batch->dev_insert) == SQLITE_DONE)
+        {
+            id = sqlite3_last_insert_rowid(batch->db);
+            log_info("database: new device %s id=%lld\n", name, (long long)id);
+        }
+        else
+        {
+            log_error("database insert device %s error:%s\n", name, sqlite3_errmsg(batch->db));
+        }
+        sqlite3_reset(batch->dev_insert);
+    }
+
+    if ((id >= 0) && (i < DB_DEVICE_CACHE_SIZE))
+    {
+        snprintf(dev->name, sizeof(dev->name), "%s", name);
+        dev->id = id;
+    }
+
+    return id;
+}
+
+/**
+ * @name: int database_batch_commit(db_batch_t *batch)
+ * @description: 提交当前事务，没有未提交的行时直接返回
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_commit(db_batch_t *batch)
+{
+    char   *zErrMsg     = 0;
+
+    if ((batch == NULL) || (batch->pending == 0))
     {
-        log_error("Sqlite_check_data error:%s\n", zErrMsg);
+        return 0;
+    }
+
+    if (sqlite3_exec(batch->db, "COMMIT;", 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("database_batch_commit error:%s\n", zErrMsg);
         sqlite3_free(zErrMsg);
+        sqlite3_exec(batch->db, "ROLLBACK;", 0, 0, 0);
+        batch->pending = 0;
+        batch->failures++;
+
+        // 回滚后本事务中新建的设备id失效
+        memset(batch->devices, 0, DB_DEVICE_CACHE_SIZE * sizeof(db_device_t));
         return -2;
     }
 
-    return nRow;
-}
\ No newline at end of file
+    log_debug("database_batch_commit: %d rows committed\n", batch->pending);
+    batch->rows    += batch->pending;
+    batch->commits++;
+    batch->pending  = 0;
+    return 0;
+}
+
+/**
+ * @name: int database_batch_insert(db_batch_t *batch, packinfo_t *pack_info)
+ * @description: 绑定参数向时序表插入一行，必要时开启新事务，满max_rows行或超过max_ms时提交
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_insert(db_batch_t *batch, packinfo_t *pack_info)
+{
+    char   *zErrMsg     = 0;
+    int     rv          = -1;
+    int64_t device;
+
+    if ((batch == NULL) || (batch->stmt == NULL) || (pack_info == NULL))
+    {
+        log_error("The database_batch_insert() argument incorrect!\n");
+        return -1;
+    }
+
+    // 开启事务时就取写锁，和其他写连接并发时由busy_timeout等待，避免读事务升级为写事务时直接返回SQLITE_BUSY
+    if (batch->pending == 0)
+    {
+        if (sqlite3_exec(batch->db, "BEGIN IMMEDIATE;", 0, 0, &zErrMsg) != SQLITE_OK)
+        {
+            log_error("database_batch_insert begin error:%s\n", zErrMsg);
+            sqlite3_free(zErrMsg);
+            return -2;
+        }
+        batch->begin_ms = database_now_ms();
+    }
+
+    if ((device = database_device_id(batch, pack_info->devid)) < 0)
+    {
+        if (batch->pending == 0)
+        {
+            // 回滚后本事务中新建的设备id失效
+            sqlite3_exec(batch->db, "ROLLBACK;", 0, 0, 0);
+            memset(batch->devices, 0, DB_DEVICE_CACHE_SIZE * sizeof(db_device_t));
+        }
+        return -3;
+    }
+
+    // 读数以0.01为单位的定点整数存储
+    sqlite3_bind_int64(batch->stmt, 1, device);
+    sqlite3_bind_int64(batch->stmt, 2, pack_info->ts);
+    sqlite3_bind_int(batch->stmt, 3, (int)lrintf(pack_info->temp * 100));
+    sqlite3_bind_int(batch->stmt, 4, (int)lrintf(pack_info->humi * 100));
+
+    rv = sqlite3_step(batch->stmt);
+    sqlite3_reset(batch->stmt);
+    sqlite3_clear_bindings(batch->stmt);
+    if (rv != SQLITE_DONE)
+    {
+        log_error("database_batch_insert step error:%s\n", sqlite3_errmsg(batch->db));
+        if (batch->pending == 0)
+        {
+            // 回滚后本事务中新建的设备id失效
+            sqlite3_exec(batch->db, "ROLLBACK;", 0, 0, 0);
+            memset(batch->devices, 0, DB_DEVICE_CACHE_SIZE * sizeof(db_device_t));
+        }
+        return -4;
+    }
+    batch->pending++;
+
+    if ((batch->pending >= batch->max_rows) || (database_now_ms() - batch->begin_ms >= batch->max_ms))
+    {
+        return database_batch_commit(batch);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int database_batch_poll(db_batch_t *batch)
+ * @description: 事务持续时间超过max_ms时提交
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @return {int} 距下一次提交的毫秒数，没有未提交的行时返回-1，提交失败返回-2
+ */
+int database_batch_poll(db_batch_t *batch)
+{
+    long long   elapsed;
+
+    if ((batch == NULL) || (batch->pending == 0))
+    {
+        return -1;
+    }
+
+    elapsed = database_now_ms() - batch->begin_ms;
+    if (elapsed < batch->max_ms)
+    {
+        return (int)(batch->max_ms - elapsed);
+    }
+
+    return database_batch_commit(batch) < 0 ? -2 : -1;
+}
+
+/**
+ * @name: int database_batch_close(db_batch_t *batch)
+ * @description: 提交剩余的行并释放缓存的语句
+ * @param {db_batch_t} *batch 批量插入句柄
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int database_batch_close(db_batch_t *batch)
+{
+    int     rv;
+
+    if (batch == NULL)
+    {
+        return -1;
+    }
+
+    rv = database_batch_commit(batch);
+    sqlite3_finalize(batch->stmt);
+    sqlite3_finalize(batch->dev_select);
+    sqlite3_finalize(batch->dev_insert);
+    free(batch->devices);
+    batch->stmt       = NULL;
+    batch->dev_select = NULL;
+    batch->dev_insert = NULL;
+    batch->devices    = NULL;
+
+    return rv;
+}
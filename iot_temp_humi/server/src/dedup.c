@@ -0,0 +1,207 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:00:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:00:00
+ * @Description: 存储线程入库前的重复记录过滤
+ *   客户端在确认之前断线会重发整个窗口，服务器上同一设备的同一采样时间会出现多次
+ *   每个设备记下已入库的最大采样时间和其下DEDUP_WINDOW个时间槽的位图，重复记录在进入SQLite之前丢弃
+ */
+
+#include "dedup.h"
+
+/**
+ * @name: int dedup_init(dedup_t *dedup)
+ * @description: 分配设备表
+ * @param {dedup_t} *dedup 过滤器
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int dedup_init(dedup_t *dedup)
+{
+    if (!dedup)
+    {
+        log_error("The dedup_init() argument incorrect!\n");
+        return -1;
+    }
+
+    if ((dedup->devices = calloc(DEDUP_DEVICES, sizeof(dedup_device_t))) == NULL)
+    {
+        log_error("dedup_init() calloc failure\n");
+        return -2;
+    }
+
+    dedup->dropped   = 0;
+    dedup->untracked = 0;
+    return 0;
+}
+
+/**
+ * @name: void dedup_destroy(dedup_t *dedup)
+ * @description: 释放设备表
+ * @param {dedup_t} *dedup 过滤器
+ * @return {*}
+ */
+void dedup_destroy(dedup_t *dedup)
+{
+    if (dedup)
+    {
+        free(dedup->devices);
+        dedup->devices = NULL;
+    }
+}
+
+/**
+ * @name: static dedup_device_t *dedup_device(dedup_t *dedup, const char *name, int create)
+ * @description: 按设备名查找设备，FNV-1a哈希 + 线性探测
+ * @param {dedup_t} *dedup 过滤器
+ * @param {char} *name 设备名
+ * @param {int} create 不存在时是否占用空闲位置
+ * @return {dedup_device_t} 设备，NULL为不存在或设备表已满
+ */
+static dedup_device_t *dedup_device(dedup_t *dedup, const char *name, int create)
+{
+    dedup_device_t *dev;
+    uint32_t        hash = 2166136261u;
+    const char     *p;
+    int             i;
+
+    for (p = name; *p; p++)
+    {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+
+    for (i = 0; i < DEDUP_DEVICES; i++)
+    {
+        dev = &dedup->devices[(hash + i) & (DEDUP_DEVICES - 1)];
+        if (dev->name[0] == '\0')
+        {
+            if (!create)
+            {
+                return NULL;
+            }
+            snprintf(dev->name, sizeof(dev->name), "%s", name);
+            dev->high = INT64_MIN;
+            return dev;
+        }
+        if (!strncmp(dev->name, name, sizeof(dev->name)))
+        {
+            return dev;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @name: static int dedup_slot(const packinfo_t *pack_info, int64_t *slot)
+ * @description: 采样时间转换为时间槽，只跟踪非负的整秒时间，保证不同记录不会落在同一时间槽
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @param {int64_t} *slot 时间槽
+ * @return {int} 0为可以跟踪，-1为不跟踪
+ */
+static int dedup_slot(const packinfo_t *pack_info, int64_t *slot)
+{
+    if ((pack_info->ts < 0) || (pack_info->ts % DEDUP_RESOLUTION))
+    {
+        return -1;
+    }
+
+    *slot = pack_info->ts / DEDUP_RESOLUTION;
+    return 0;
+}
+
+/**
+ * @name: int dedup_check(dedup_t *dedup, const packinfo_t *pack_info)
+ * @description: 判断记录是否已经入库
+ * @param {dedup_t} *dedup 过滤器
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 1为确定重复，应当丢弃，0为新记录或无法判断
+ */
+int dedup_check(dedup_t *dedup, const packinfo_t *pack_info)
+{
+    dedup_device_t *dev;
+    int64_t         slot;
+    uint64_t        bit;
+
+    if (dedup_slot(pack_info, &slot) < 0)
+    {
+        __atomic_fetch_add(&dedup->untracked, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    if (((dev = dedup_device(dedup, pack_info->devid, 0)) == NULL) || (slot > dev->high))
+    {
+        return 0;
+    }
+
+    if (slot <= dev->high - DEDUP_WINDOW)
+    {
+        __atomic_fetch_add(&dedup->untracked, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    bit = (uint64_t)slot % DEDUP_WINDOW;
+    if (dev->bits[bit / 64] & (1ULL << (bit % 64)))
+    {
+        __atomic_fetch_add(&dedup->dropped, 1, __ATOMIC_RELAXED);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: void dedup_mark(dedup_t *dedup, const packinfo_t *pack_info)
+ * @description: 记录已写入当前事务，超过高水位时前移高水位并清除移出窗口的位
+ * @param {dedup_t} *dedup 过滤器
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {*}
+ */
+void dedup_mark(dedup_t *dedup, const packinfo_t *pack_info)
+{
+    dedup_device_t *dev;
+    int64_t         slot;
+    int64_t         s;
+    uint64_t        bit;
+
+    if ((dedup_slot(pack_info, &slot) < 0) || ((dev = dedup_device(dedup, pack_info->devid, 1)) == NULL))
+    {
+        return;
+    }
+
+    if (slot > dev->high)
+    {
+        // 高水位前移，(high, slot) 内的时间槽复用的是窗口最旧的位，需要清零
+        if ((dev->high == INT64_MIN) || (slot - dev->high >= DEDUP_WINDOW))
+        {
+            memset(dev->bits, 0, sizeof(dev->bits));
+        }
+        else
+        {
+            for (s = dev->high + 1; s < slot; s++)
+            {
+                bit = (uint64_t)s % DEDUP_WINDOW;
+                dev->bits[bit / 64] &= ~(1ULL << (bit % 64));
+            }
+        }
+        dev->high = slot;
+    }
+    else if (slot <= dev->high - DEDUP_WINDOW)
+    {
+        return;
+    }
+
+    bit = (uint64_t)slot % DEDUP_WINDOW;
+    dev->bits[bit / 64] |= 1ULL << (bit % 64);
+}
+
+/**
+ * @name: void dedup_reset(dedup_t *dedup)
+ * @description: 清空所有设备的位图，提交失败回滚后已标记的记录并没有入库，之后的记录都交给数据库判断
+ * @param {dedup_t} *dedup 过滤器
+ * @return {*}
+ */
+void dedup_reset(dedup_t *dedup)
+{
+    memset(dedup->devices, 0, DEDUP_DEVICES * sizeof(dedup_device_t));
+}
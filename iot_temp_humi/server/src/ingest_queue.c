@@ -0,0 +1,231 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:45:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:45:43
+ * @Description: 网络线程到存储线程的有界无锁多生产者单消费者队列
+ */
+
+#include "ingest_queue.h"
+
+/**
+ * @name: int ingest_queue_init(ingest_queue_t *queue, uint64_t capacity)
+ * @description: 初始化队列
+ * @param {ingest_queue_t} *queue 队列
+ * @param {uint64_t} capacity 容量，必须为2的幂
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int ingest_queue_init(ingest_queue_t *queue, uint64_t capacity)
+{
+    uint64_t    i;
+
+    if (!queue || capacity < 2 || (capacity & (capacity - 1)))
+    {
+        log_error("The ingest_queue_init() argument incorrect!\n");
+        return -1;
+    }
+
+    memset(queue, 0, sizeof(*queue));
+    if ((queue->slots = calloc(capacity, sizeof(ingest_slot_t))) == NULL)
+    {
+        log_error("ingest_queue_init() calloc failure: %s\n", strerror(errno));
+        return -2;
+    }
+
+    if ((queue->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+    {
+        log_error("ingest_queue_init() eventfd failure: %s\n", strerror(errno));
+        free(queue->slots);
+        return -3;
+    }
+
+    for (i = 0; i < capacity; i++)
+    {
+        queue->slots[i].seq = i;
+    }
+    queue->capacity = capacity;
+    queue->mask     = capacity - 1;
+
+    return 0;
+}
+
+/**
+ * @name: void ingest_queue_destroy(ingest_queue_t *queue)
+ * @description: 释放队列
+ * @param {ingest_queue_t} *queue 队列
+ * @return {*}
+ */
+void ingest_queue_destroy(ingest_queue_t *queue)
+{
+    if (!queue)
+    {
+        return;
+    }
+
+    close(queue->efd);
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+/**
+ * @name: int ingest_queue_push(ingest_queue_t *queue, const packinfo_t *pack, int src)
+ * @description: 入队，可由多个网络线程并发调用，同一来源的数据按入队顺序出队
+ * @param {ingest_queue_t} *queue 队列
+ * @param {packinfo_t} *pack 数据
+ * @param {int} src 来源编号，即工作线程编号
+ * @return {int} 0为入队成功，-1为队列已满
+ */
+int ingest_queue_push(ingest_queue_t *queue, const packinfo_t *pack, int src)
+{
+    ingest_slot_t  *slot;
+    uint64_t        pos;
+    uint64_t        seq;
+    uint64_t        depth;
+    uint64_t        high;
+    int64_t         dif;
+
+    pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    while (1)
+    {
+        slot = &queue->slots[pos & queue->mask];
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        dif  = (int64_t)seq - (int64_t)pos;
+
+        if (dif == 0)
+        {
+            // 槽位空闲，抢占head
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (dif < 0)
+        {
+            // 槽位还未被存储线程取走，队列已满
+            __atomic_fetch_add(&queue->full_count, 1, __ATOMIC_RELAXED);
+            return -1;
+        }
+        else
+        {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->pack = *pack;
+    slot->src  = src;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    // 更新最高水位
+    depth = pos + 1 - __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    high  = __atomic_load_n(&queue->high_water, __ATOMIC_RELAXED);
+    while (depth > high)
+    {
+        if (__atomic_compare_exchange_n(&queue->high_water, &high, depth, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            break;
+        }
+    }
+
+    // 存储线程正在等待时才需要系统调用唤醒
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&queue->sleeping, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST))
+    {
+        ingest_queue_wakeup(queue);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int ingest_queue_pop(ingest_queue_t *queue, packinfo_t *pack, int *src)
+ * @description: 出队，只能由存储线程调用
+ * @param {ingest_queue_t} *queue 队列
+ * @param {packinfo_t} *pack 数据
+ * @param {int} *src 来源编号
+ * @return {int} 1为取到数据，0为队列为空
+ */
+int ingest_queue_pop(ingest_queue_t *queue, packinfo_t *pack, int *src)
+{
+    ingest_slot_t  *slot;
+    uint64_t        pos = queue->tail;
+
+    slot = &queue->slots[pos & queue->mask];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+    {
+        return 0;
+    }
+
+    *pack = slot->pack;
+    *src  = slot->src;
+    __atomic_store_n(&slot->seq, pos + queue->capacity, __ATOMIC_RELEASE);
+    __atomic_store_n(&queue->tail, pos + 1, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+/**
+ * @name: int ingest_queue_wait(ingest_queue_t *queue, int timeout_ms)
+ * @description: 队列为空时存储线程在eventfd上等待，直到有数据入队或超时
+ * @param {ingest_queue_t} *queue 队列
+ * @param {int} timeout_ms 超时时间(ms)
+ * @return {int} 1为有数据，0为超时
+ */
+int ingest_queue_wait(ingest_queue_t *queue, int timeout_ms)
+{
+    struct pollfd   pfd;
+    uint64_t        val;
+    int             rv;
+
+    __atomic_store_n(&queue->sleeping, 1, __ATOMIC_SEQ_CST);
+
+    // 设置等待标志后再检查一次，避免错过设置之前入队的数据
+    if (ingest_queue_depth(queue) > 0)
+    {
+        __atomic_store_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST);
+        return 1;
+    }
+
+    pfd.fd     = queue->efd;
+    pfd.events = POLLIN;
+    rv = poll(&pfd, 1, timeout_ms);
+    __atomic_store_n(&queue->sleeping, 0, __ATOMIC_SEQ_CST);
+
+    if (rv > 0)
+    {
+        while (read(queue->efd, &val, sizeof(val)) > 0)
+            ;
+    }
+
+    return ingest_queue_depth(queue) > 0;
+}
+
+/**
+ * @name: void ingest_queue_wakeup(ingest_queue_t *queue)
+ * @description: 唤醒在ingest_queue_wait()中等待的存储线程
+ * @param {ingest_queue_t} *queue 队列
+ * @return {*}
+ */
+void ingest_queue_wakeup(ingest_queue_t *queue)
+{
+    uint64_t    val = 1;
+
+    if (write(queue->efd, &val, sizeof(val)) < 0 && errno != EAGAIN)
+    {
+        log_error("ingest_queue_wakeup() write eventfd failure: %s\n", strerror(errno));
+    }
+}
+
+/**
+ * @name: uint64_t ingest_queue_depth(ingest_queue_t *queue)
+ * @description: 当前队列深度(近似值)
+ * @param {ingest_queue_t} *queue 队列
+ * @return {uint64_t} 队列中的记录数
+ */
+uint64_t ingest_queue_depth(ingest_queue_t *queue)
+{
+    uint64_t    head = __atomic_load_n(&queue->head, __ATOMIC_SEQ_CST);
+    uint64_t    tail = __atomic_load_n(&queue->tail, __ATOMIC_SEQ_CST);
+
+    return head > tail ? head - tail : 0;
+}
@@ -2,47 +2,60 @@
  * @Author: RoxyKko
  * @Date: 2023-04-11 21:15:13
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 22:53:48
+ * @LastEditTime: 2026-10-17 19:47:50
  * @Description: 服务器端
  */
 
 #include "iot_main.h"
 
-#define MAX_EVENTS      512
 #define DATABASE_NAME   "sht20"                 // 数据库名
-#define TABLE_NAME      "RPI4B"                 // 数据库表名
+#define TABLE_NAME      "RPI4B"                 // 旧版全文本表名，由sht20_migrate迁移到时序表
+#define STAT_INTERVAL   10                      // 工作线程计数器打印间隔(s)
 #define Vision          1.5                     // 版本号
 #define lastEdit        "2023-04-06 17:57:49"   // 最后编辑时间
 
+volatile int g_sigstop = 0;                     // 停止信号
+
 static inline void print_usage(char *progname);
+static void sig_stop(int signum);
+static void print_worker_stat(worker_t *workers, worker_stat_t *last, int nworkers, int interval);
+static void print_storage_stat(storage_t *storage, ingest_queue_t *queue, uint64_t *last_records, int interval);
 
 int main(int argc, char **argv)
 {
-    struct epoll_event          event;                          // epoll事件结构体
-	struct epoll_event          event_array[MAX_EVENTS];        // epoll事件数组
-    packinfo_t                  pack_info;                      // 数据结构体
-    int					        listenfd;                       // server监听套接字
-    int                         connfd;                         // client连接套接字
+    static worker_t             workers[WORKER_MAX];            // 工作线程
+    static worker_stat_t        last_stat[WORKER_MAX];          // 上一次打印时的计数器
+    static ingest_queue_t       queue;                          // 网络线程到存储线程的入库队列
+    static storage_t            storage;                        // 存储线程
+    uint64_t                    last_records    =       0;      // 上一次打印时的入库记录数
     char                       *progname        =       NULL;   // 程序名
     int                         daemon_run      =       0;      // 守护进程
     int                         opt;                            // getopt_long返回值
-    int                         rv;                             // 返回值
-    int                         i, j;
+    int                         i;
     int                         serv_port       =       0;      // 服务器端口
-    char                        buf[1024];                      // 数据缓冲区
-    int                         epollfd         =       -1;     // epoll句柄
-    int                         events          =       -1;     // epoll_wait返回值
+    int                         nworkers        =       1;      // 工作线程数
+    uint64_t                    queue_size      =       INGEST_QUEUE_SIZE;  // 入库队列容量
+    int                         batch_rows      =       STORAGE_BATCH_ROWS; // 每个事务最多提交的行数
+    int                         batch_ms        =       STORAGE_BATCH_MS;   // 事务最长持续时间(ms)
+    char                       *p;
+    char                       *storage_opt     =       DB_PROFILE_DEFAULT; // 存储配置
+    db_profile_t                profile;                        // 解析后的存储配置
+    int                         started         =       0;      // 已启动的工作线程数
     sqlite3 			       *db;                             // 数据库句柄
 
     struct option long_option[] =
 		{
 			{"daemon", no_argument, NULL, 'b'},
 			{"port", required_argument, NULL, 'p'},
+			{"workers", required_argument, NULL, 'w'},
+			{"queue", required_argument, NULL, 'q'},
+			{"batch", required_argument, NULL, 'B'},
+			{"storage", required_argument, NULL, 'S'},
 			{"help", no_argument, NULL, 'h'},
 			{0, 0, 0, 0}};
 
     progname = argv[0];
-    while ((opt = getopt_long(argc, argv, "bp:h", long_option, NULL)) != -1)
+    while ((opt = getopt_long(argc, argv, "bp:w:q:B:S:h", long_option, NULL)) != -1)
     {
         switch (opt)
 		{
@@ -52,6 +65,22 @@ int main(int argc, char **argv)
 		case 'p':
 			serv_port = atoi(optarg);
 			break;
+		case 'w':
+			nworkers = atoi(optarg);
+			break;
+		case 'q':
+			queue_size = strtoull(optarg, NULL, 0);
+			break;
+		case 'B':
+			batch_rows = atoi(optarg);
+			if ((p = strchr(optarg, ',')) != NULL)
+			{
+				batch_ms = atoi(p + 1);
+			}
+			break;
+		case 'S':
+			storage_opt = optarg;
+			break;
 		case 'h':
 			print_usage(progname);
 			return EXIT_SUCCESS;
@@ -77,7 +106,8 @@ int main(int argc, char **argv)
     log_info("=                                                          =\n");
     log_info("============================================================\n");
 
-    if (!serv_port)
+    if (!serv_port || nworkers < 1 || nworkers > WORKER_MAX || queue_size < 2 || (queue_size & (queue_size - 1))
+        || batch_rows < 1 || batch_ms < 0 || database_profile_parse(storage_opt, &profile) < 0)
 	{
 		print_usage(progname);
 		return -2;
@@ -93,131 +123,160 @@ int main(int argc, char **argv)
 		log_debug("Runing daemon successfully!\n");
 	}
 
+    signal(SIGINT, sig_stop);
+    signal(SIGTERM, sig_stop);
     set_socket_rlimit();
-    if ((listenfd = socket_server_init(NULL, serv_port)) < 0)
-	{
-		log_error("ERROR: %s server listen on port %d failure\n", argv[0], serv_port);
-		return -2;
-	}
-    log_debug("%s server start to listen on port %d\n", argv[0],serv_port);
-
-    if( (epollfd=epoll_create(MAX_EVENTS)) < 0 )
-    {
-		log_error("Create epoll failure:%s\n", strerror(errno));
-		return -4;
-	}
-
-    event.events = EPOLLIN;
-	event.data.fd = listenfd;
-
-    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, listenfd, &event) < 0)
-	{
-		log_error("Execute epoll_ctl failure:%s\n", strerror(errno));
-		return -5;
-	}
 
     // 初始化数据库
-    if (database_init(DATABASE_NAME, &db) < 0)
+    if (database_init(DATABASE_NAME, &db, &profile) < 0)
     {
         log_error("database init failed!\n");
         printf("database init failed!\n");
         return -6;
     }
 
-    // 若数据库中不存在表，则创建表
-    if (database_create_table(TABLE_NAME, &db) < 0)
+    // 创建时序表，存在旧版表时提示运行迁移工具
+    if (database_schema_init(TABLE_NAME, &db) < 0)
     {
         log_error("database create table failed!\n");
         database_close(DATABASE_NAME, &db);
         return -7;
     }
 
-    while(1)
+    // 数据库写入由独立的存储线程完成，网络线程只负责把解析好的记录送入队列
+    if (ingest_queue_init(&queue, queue_size) < 0)
     {
-        // 没接收到数据时，阻塞等待
-        events = epoll_wait(epollfd, event_array, MAX_EVENTS, -1);
-        if (events < 0)
-		{
-			log_error("epoll failure: %s\n", strerror(errno));
-			break;
-		}
-		else if (events == 0)
-		{
-			log_error("epoll get timeout\n");
-			continue;
-		}
+        database_close(DATABASE_NAME, &db);
+        return -8;
+    }
 
-        // events > 0 是活动事件计数
-        for(i = 0; i < events; i++)
+    storage.table = DB_SAMPLE_TABLE;
+    storage.db    = &db;
+    storage.queue = &queue;
+    storage.batch_rows = batch_rows;
+    storage.batch_ms   = batch_ms;
+    if (storage_start(&storage) < 0)
+    {
+        ingest_queue_destroy(&queue);
+        database_close(DATABASE_NAME, &db);
+        return -9;
+    }
+
+    // 每个工作线程拥有独立的SO_REUSEPORT监听套接字和epoll实例，由内核在它们之间分发新连接
+    for (i = 0; i < nworkers; i++)
+    {
+        if (worker_init(&workers[i], i, NULL, serv_port, nworkers > 1) < 0)
         {
-            if ((event_array[i].events & EPOLLERR) || (event_array[i].events & EPOLLHUP))
-			{
-				log_error("epoll_wait get error on fd[%d]: %s\n", event_array[i].data.fd, strerror(errno));
-				epoll_ctl(epollfd, EPOLL_CTL_DEL, event_array[i].data.fd, NULL);
-				close(event_array[i].data.fd);
-			}
+            log_error("ERROR: %s server listen on port %d failure\n", argv[0], serv_port);
+            g_sigstop = 1;
+            break;
+        }
+
+        workers[i].queue   = &queue;
+        workers[i].storage = &storage;
+        if (worker_start(&workers[i]) < 0)
+        {
+            close(workers[i].efd);
+            close(workers[i].epollfd);
+            close(workers[i].listenfd);
+            g_sigstop = 1;
+            break;
+        }
+        started++;
+    }
+    log_info("%s server start %d worker(s) listen on port %d\n", argv[0], started, serv_port);
 
-            // 监听socket得到event意味着有新的客户端链接
-            if (event_array[i].data.fd == listenfd)
-			{
-				if ((connfd = accept(listenfd, (struct sockaddr *)NULL, NULL)) < 0)
-				{
-					log_error("accept() failure: %s \n", strerror(errno));
-                    close(connfd);
-					continue;
-				}
-
-				event.data.fd = connfd;
-				event.events = EPOLLIN;
-				if (epoll_ctl(epollfd, EPOLL_CTL_ADD, connfd, &event) < 0)
-				{
-					log_error("epoll add client socket failure: %s \n", strerror(errno));
-					close(event_array[i].data.fd);
-					continue;
-				}
-
-				log_info("epoll add new client socket[%d] ok.\n", connfd);
+    while (!g_sigstop)
+    {
+        sleep(STAT_INTERVAL);
+        print_worker_stat(workers, last_stat, started, STAT_INTERVAL);
+        print_storage_stat(&storage, &queue, &last_records, STAT_INTERVAL);
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        worker_join(&workers[i]);
+    }
+
+    // 网络线程全部退出后，存储线程写完队列中剩余的记录再退出
+    storage_stop(&storage);
+    ingest_queue_destroy(&queue);
 
-			}
-            else    // 客户端套接字已连接并获取数据
-            {
-                // 清空数据缓存区
-                memset(buf, 0, sizeof(buf));
-
-                // 读取客户端数据
-                if ((rv = read(event_array[i].data.fd, buf, sizeof(buf))) <= 0)
-				{
-					log_error("socket[%d] read failure or get disconnect and will be removed. \n", event_array[i].data.fd);
-
-					if(epoll_ctl(epollfd, EPOLL_CTL_DEL, event_array[i].data.fd, NULL) < 0)
-                    {
-                        log_error("epoll_ctl del socket[%d] failure: %s \n", event_array[i].data.fd, strerror(errno));
-                    }
-
-					close(event_array[i].data.fd);
-					continue;
-				}
-                
-                // 若rv>0读取到数据
-                data_segmentation(buf, &pack_info);
-
-                // 数据库插入数据
-                if (database_insert_data(TABLE_NAME, &db, &pack_info) < 0)
-                {
-                    log_error("database insert data failed!\n");
-                    database_close(DATABASE_NAME, &db);
-                    return -8;
-                }
-
-
-            }
-
-        }   // end for
-
-    }   // end while
     database_close(DATABASE_NAME, &db);
-    return 0;
+    return started == nworkers ? 0 : -4;
+
+}
+
+/**
+ * @name: static void print_storage_stat(storage_t *storage, ingest_queue_t *queue, uint64_t *last_records, int interval)
+ * @description: 打印存储线程的入库速率、丢弃的重复记录数和入库队列深度、最高水位
+ * @param {storage_t} *storage 存储线程
+ * @param {ingest_queue_t} *queue 入库队列
+ * @param {uint64_t} *last_records 上一次打印时的入库记录数，打印后更新
+ * @param {int} interval 打印间隔(s)
+ * @return {*}
+ */
+static void print_storage_stat(storage_t *storage, ingest_queue_t *queue, uint64_t *last_records, int interval)
+{
+    uint64_t    records = __atomic_load_n(&storage->records, __ATOMIC_RELAXED);
+
+    log_info("storage: records=%llu (%llu/s) commits=%llu errors=%llu duplicates=%llu untracked=%llu queue depth=%llu/%llu high_water=%llu full=%llu\n",
+             (unsigned long long)records, (unsigned long long)((records - *last_records) / interval),
+             (unsigned long long)__atomic_load_n(&storage->batch.commits, __ATOMIC_RELAXED),
+             (unsigned long long)__atomic_load_n(&storage->errors, __ATOMIC_RELAXED),
+             (unsigned long long)__atomic_load_n(&storage->dedup.dropped, __ATOMIC_RELAXED),
+             (unsigned long long)__atomic_load_n(&storage->dedup.untracked, __ATOMIC_RELAXED),
+             (unsigned long long)ingest_queue_depth(queue), (unsigned long long)queue->capacity,
+             (unsigned long long)__atomic_load_n(&queue->high_water, __ATOMIC_RELAXED),
+             (unsigned long long)__atomic_load_n(&queue->full_count, __ATOMIC_RELAXED));
+    *last_records = records;
+}
+
+/**
+ * @name: static void sig_stop(int signum)
+ * @description: SIGINT/SIGTERM信号处理，通知所有线程退出
+ * @param {int} signum 信号
+ * @return {*}
+ */
+static void sig_stop(int signum)
+{
+    g_sigstop = 1;
+}
+
+/**
+ * @name: static void print_worker_stat(worker_t *workers, worker_stat_t *last, int nworkers, int interval)
+ * @description: 打印每个工作线程的计数器及本周期的入库速率
+ * @param {worker_t} *workers 工作线程数组
+ * @param {worker_stat_t} *last 上一次打印时的计数器，打印后更新
+ * @param {int} nworkers 工作线程数
+ * @param {int} interval 打印间隔(s)
+ * @return {*}
+ */
+static void print_worker_stat(worker_t *workers, worker_stat_t *last, int nworkers, int interval)
+{
+    worker_stat_t   now;
+    uint64_t        total_records = 0;
+    uint64_t        total_rate    = 0;
+    uint64_t        rate;
+    int             i;
+
+    for (i = 0; i < nworkers; i++)
+    {
+        worker_stat_snapshot(&workers[i], &now);
+        rate = (now.records - last[i].records) / interval;
+        log_info("worker[%d] cpu%d: conns=%llu records=%llu (%llu/s) bytes=%llu reads=%llu wakeups=%llu stalls=%llu acks=%llu errors=%llu\n",
+                 workers[i].id, workers[i].cpu,
+                 (unsigned long long)(now.accepts - now.closes),
+                 (unsigned long long)now.records, (unsigned long long)rate,
+                 (unsigned long long)now.bytes, (unsigned long long)now.reads,
+                 (unsigned long long)now.wakeups, (unsigned long long)now.stalls,
+                 (unsigned long long)now.acks, (unsigned long long)now.errors);
+        total_records += now.records;
+        total_rate    += rate;
+        last[i] = now;
+    }
 
+    log_info("all workers: records=%llu (%llu/s)\n", (unsigned long long)total_records, (unsigned long long)total_rate);
 }
 
 static inline void print_usage(char *progname)
@@ -229,8 +288,13 @@ static inline void print_usage(char *progname)
 
 	printf(" -b[daemon ] set program running on background\n");
 	printf(" -p[port   ] Socket server port address\n");
+	printf(" -w[workers] Number of epoll worker threads, each pinned to a core (default 1)\n");
+	printf(" -B[batch  ] Commit every ROWS[,MS] inserted rows or milliseconds (default %d,%d)\n", STORAGE_BATCH_ROWS, STORAGE_BATCH_MS);
+	printf(" -S[storage] Storage profile durable|throughput[,key=value...] (default %s)\n", DB_PROFILE_DEFAULT);
+	printf("             keys: journal_mode synchronous mmap_size page_size cache_size wal_autocheckpoint\n");
+	printf(" -q[queue  ] Ingest queue capacity between workers and storage, power of 2 (default %d)\n", INGEST_QUEUE_SIZE);
 	printf(" -h[help   ] Display this help information\n");
 
-	printf("\nExample: %s -b -p 8900\n", progname);
+	printf("\nExample: %s -b -p 8900 -w 4 -S throughput\n", progname);
 	return;
 }
\ No newline at end of file
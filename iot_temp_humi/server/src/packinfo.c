@@ -2,25 +2,321 @@
  * @Author: RoxyKko
  * @Date: 2023-04-11 17:14:15
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 21:05:42
+ * @LastEditTime: 2026-10-17 19:36:30
  * @Description: 服务器接收数据包
  */
 
 #include "packinfo.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*** 
+ * @description: 10的整数次幂，double可以精确表示到1e22
+ */
+static const double packinfo_pow10[] =
+{
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*** 
+ * @description: 每个工作线程缓存最近一个小时整点的epoch秒，同一小时内的时间不再调用mktime
+ */
+static __thread int     packinfo_hour_key  = -1;
+static __thread time_t  packinfo_hour_base = 0;
+
+/**
+ * @name: static int packinfo_digits(const char *p, int n)
+ * @description: 把n个十进制数字字符转换为整数
+ * @param {char} *p 字符串
+ * @param {int} n 位数
+ * @return {int} 转换结果，出现非数字字符返回-1
+ */
+static int packinfo_digits(const char *p, int n)
+{
+    int     value = 0;
+    int     i;
+
+    for (i = 0; i < n; i++)
+    {
+        if ((p[i] < '0') || (p[i] > '9'))
+        {
+            return -1;
+        }
+        value = value * 10 + (p[i] - '0');
+    }
+
+    return value;
+}
+
+/**
+ * @name: int64_t packinfo_parse_time(const char *datime, size_t len)
+ * @description: 把客户端的本地时间字符串"YYYY-MM-DD HH:MM:SS"转换为epoch毫秒
+ *               mktime每次都要加锁读取时区，按小时缓存整点时间，其余部分直接相加
+ * @param {char} *datime 时间字符串，不要求以'\0'结尾
+ * @param {size_t} len 字符串长度
+ * @return {int64_t} epoch毫秒，负数则格式错误
+ */
+int64_t packinfo_parse_time(const char *datime, size_t len)
+{
+    struct tm   tm;
+    time_t      base;
+    int         year, mon, mday, hour, min, sec;
+    int         key;
+
+    if ((len != 19) || (datime[4] != '-') || (datime[7] != '-') || (datime[10] != ' ')
+        || (datime[13] != ':') || (datime[16] != ':'))
+    {
+        return -1;
+    }
+
+    year = packinfo_digits(datime, 4);
+    mon  = packinfo_digits(datime + 5, 2);
+    mday = packinfo_digits(datime + 8, 2);
+    hour = packinfo_digits(datime + 11, 2);
+    min  = packinfo_digits(datime + 14, 2);
+    sec  = packinfo_digits(datime + 17, 2);
+    if ((year < 0) || (mon < 1) || (mon > 12) || (mday < 1) || (mday > 31) || (hour < 0) || (hour > 23)
+        || (min < 0) || (min > 59) || (sec < 0) || (sec > 60))
+    {
+        return -1;
+    }
+
+    key = ((year * 12 + mon) * 31 + mday) * 24 + hour;
+    if (key != packinfo_hour_key)
+    {
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year  = year - 1900;
+        tm.tm_mon   = mon - 1;
+        tm.tm_mday  = mday;
+        tm.tm_hour  = hour;
+        tm.tm_isdst = -1;
+        if ((base = mktime(&tm)) == (time_t)-1)
+        {
+            return -2;
+        }
+        packinfo_hour_key  = key;
+        packinfo_hour_base = base;
+    }
+
+    return ((int64_t)packinfo_hour_base + min * 60 + sec) * 1000;
+}
+
+/**
+ * @name: static int packinfo_parse_float(const char *p, size_t len, float *value)
+ * @description: 解析十进制浮点数，结果与(float)strtod()完全一致
+ *               有效数字不超过2^53且十进制指数不超过22时，尾数和10的幂都能被double精确表示，
+ *               一次乘除即得到正确舍入的结果(Clinger快速路径)，其他情况交给strtod
+ * @param {char} *p 数字字符串，不要求以'\0'结尾
+ * @param {size_t} len 字符串长度
+ * @param {float} *value 解析结果
+ * @return {int} 0为正常执行，非0则格式错误
+ */
+static int packinfo_parse_float(const char *p, size_t len, float *value)
+{
+    const char *end     = p + len;
+    const char *s       = p;
+    uint64_t    mant    = 0;
+    int         digits  = 0;
+    int         exp10   = 0;
+    int         neg     = 0;
+    char        buf[64];
+    char       *stop;
+    double      d;
+
+    if ((s < end) && ((*s == '-') || (*s == '+')))
+    {
+        neg = (*s++ == '-');
+    }
+
+    for (; (s < end) && (*s >= '0') && (*s <= '9'); s++, digits++)
+    {
+        mant = mant * 10 + (*s - '0');
+    }
+
+    if ((s < end) && (*s == '.'))
+    {
+        for (s++; (s < end) && (*s >= '0') && (*s <= '9'); s++, digits++, exp10--)
+        {
+            mant = mant * 10 + (*s - '0');
+        }
+    }
+
+    if ((s == end) && (digits > 0) && (digits <= 19) && (mant <= (1ULL << 53)) && (exp10 >= -22))
+    {
+        d = (double)mant / packinfo_pow10[-exp10];
+        *value = neg ? -d : d;
+        return 0;
+    }
+
+    // 指数形式、有效数字过多等少见的写法
+    if ((len == 0) || (len >= sizeof(buf)))
+    {
+        return -1;
+    }
+    memcpy(buf, p, len);
+    buf[len] = '\0';
+    d = strtod(buf, &stop);
+    if (stop != buf + len)
+    {
+        return -2;
+    }
+    *value = d;
+    return 0;
+}
+
+/**
+ * @name: static int packinfo_split(const char *buf, size_t len, const char **seps, int max)
+ * @description: 查找帧中所有的'/'，每次比较16字节(SSE2/NEON)，不足16字节的尾部逐字节查找
+ * @param {char} *buf 帧
+ * @param {size_t} len 帧长度
+ * @param {char} **seps 分隔符位置
+ * @param {int} max 最多记录的分隔符数
+ * @return {int} 分隔符个数，超过max时返回max + 1
+ */
+static int packinfo_split(const char *buf, size_t len, const char **seps, int max)
+{
+    size_t      i = 0;
+    int         n = 0;
+
+#if defined(__SSE2__)
+    const __m128i   slash = _mm_set1_epi8(PACKINFO_DELIM);
+    unsigned int    mask;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + i)), slash));
+        while (mask)
+        {
+            if (n == max)
+            {
+                return max + 1;
+            }
+            seps[n++] = buf + i + __builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint8x16_t    slash = vdupq_n_u8(PACKINFO_DELIM);
+    uint64_t            mask;
+
+    for (; i + 16 <= len; i += 16)
+    {
+        // NEON没有movemask，右移窄化后每个字节对应掩码中的4位
+        mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(
+                   vceqq_u8(vld1q_u8((const uint8_t *)(buf + i)), slash)), 4)), 0);
+        while (mask)
+        {
+            if (n == max)
+            {
+                return max + 1;
+            }
+            seps[n++] = buf + i + (__builtin_ctzll(mask) >> 2);
+            mask &= ~(0xFULL << (__builtin_ctzll(mask) & ~3));
+        }
+    }
+#endif
+
+    for (; i < len; i++)
+    {
+        if (buf[i] == PACKINFO_DELIM)
+        {
+            if (n == max)
+            {
+                return max + 1;
+            }
+            seps[n++] = buf + i;
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @name: int packinfo_parse_view(const char *buf, size_t len, packinfo_view_t *view)
+ * @description: 解析一个文本帧"devid/time/temp/humi"，可重入，不修改也不复制接收缓冲区
+ *               devid和time以视图形式指向buf内部，字段数必须正好为4
+ * @param {char} *buf 帧，不含结束符
+ * @param {size_t} len 帧长度
+ * @param {packinfo_view_t} *view 解析结果
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int packinfo_parse_view(const char *buf, size_t len, packinfo_view_t *view)
+{
+    const char *seps[PACKINFO_FIELDS - 1];
+    const char *end = buf + len;
+
+    if (packinfo_split(buf, len, seps, PACKINFO_FIELDS - 1) != PACKINFO_FIELDS - 1)
+    {
+        return -1;
+    }
+
+    view->devid     = buf;
+    view->devid_len = seps[0] - buf;
+    view->time      = seps[0] + 1;
+    view->time_len  = seps[1] - view->time;
+    if ((view->devid_len == 0) || (view->devid_len >= DEVID_LEN) || (view->time_len >= TIME_LEN))
+    {
+        return -2;
+    }
+
+    if ((packinfo_parse_float(seps[1] + 1, seps[2] - seps[1] - 1, &view->temp) < 0)
+        || (packinfo_parse_float(seps[2] + 1, end - seps[2] - 1, &view->humi) < 0))
+    {
+        return -3;
+    }
+
+    if ((view->ts = packinfo_parse_time(view->time, view->time_len)) < 0)
+    {
+        return -4;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: int packinfo_parse(const char *buf, size_t len, packinfo_t *pack_info)
+ * @description: 解析一个文本帧并填入数据结构体，送入入库队列前只复制设备名和时间字符串
+ * @param {char} *buf 帧，不含结束符
+ * @param {size_t} len 帧长度
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int packinfo_parse(const char *buf, size_t len, packinfo_t *pack_info)
+{
+    packinfo_view_t view;
+    int             rv;
+
+    if ((rv = packinfo_parse_view(buf, len, &view)) < 0)
+    {
+        log_error("packinfo_parse() malformed frame (%d): %.*s\n", rv, (int)len, buf);
+        return rv;
+    }
+
+    memcpy(pack_info->devid, view.devid, view.devid_len);
+    pack_info->devid[view.devid_len] = '\0';
+    memcpy(pack_info->time, view.time, view.time_len);
+    pack_info->time[view.time_len] = '\0';
+    pack_info->ts   = view.ts;
+    pack_info->temp = view.temp;
+    pack_info->humi = view.humi;
+
+    return 0;
+}
+
 /**
  * @name: int data_segmentation(char *buf, packinfo_t *pack_info)
  * @description: 将数据从接收缓冲区中提取至结构体中
- * @param {char} *buf 接收缓冲区
+ * @param {char} *buf 以'\0'结尾的帧
  * @param {packinfo_t} *pack_info 数据结构体
  * @return {*} 0为正常执行，非0则出现错误
  */
 int data_segmentation(char *buf, packinfo_t *pack_info)
 {
-    char        *buf_ptr[4];
-    char        *p = NULL;
-    int          j = 0;
-
     if( !buf || !pack_info )
     {
         log_error("The data_segmentation() argument incorrect!\n");
@@ -29,17 +325,5 @@ int data_segmentation(char *buf, packinfo_t *pack_info)
 
     log_debug("Read data from client:%s\n", buf);
 
-    p = strtok(buf, "/");
-    while(p)
-    {
-        buf_ptr[j++] = p;
-        p = strtok(NULL, "/");
-    }
-
-    strcpy(pack_info->devid, buf_ptr[0]);
-    strcpy(pack_info->time, buf_ptr[1]);
-    pack_info->temp = atof(buf_ptr[2]);
-    pack_info->humi = atof(buf_ptr[3]);
-
-    return 0;
+    return packinfo_parse(buf, strlen(buf), pack_info);
 }
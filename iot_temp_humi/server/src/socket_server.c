@@ -2,12 +2,20 @@
  * @Author: RoxyKko
  * @Date: 2023-04-11 21:15:56
  * @LastEditors: RoxyKko
- * @LastEditTime: 2023-04-11 22:00:53
+ * @LastEditTime: 2026-10-17 19:11:00
  * @Description: 
  */
 #include "socket_server.h"
 
-int socket_server_init(char *listen_ip, int listen_port)
+/**
+ * @name: int socket_server_init(char *listen_ip, int listen_port, int reuseport)
+ * @description: 创建TCP监听套接字
+ * @param {char} *listen_ip 监听IP，为NULL时监听所有地址
+ * @param {int} listen_port 监听端口
+ * @param {int} reuseport 非0则设置SO_REUSEPORT，多个监听套接字可绑定同一端口，由内核分发连接
+ * @return {int} 成功返回监听套接字，否则返回<0
+ */
+int socket_server_init(char *listen_ip, int listen_port, int reuseport)
 {
 	struct sockaddr_in servaddr;
 	int rv = 0;
@@ -22,6 +30,13 @@ int socket_server_init(char *listen_ip, int listen_port)
 
 	setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
 
+	if (reuseport && setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+	{
+		printf("Set SO_REUSEPORT failure: %s\n", strerror(errno));
+		close(listenfd);
+		return -4;
+	}
+
 	memset(&servaddr, 0, sizeof(servaddr));
 	servaddr.sin_family = AF_INET;
 	servaddr.sin_port = htons(listen_port);
@@ -51,7 +66,7 @@ int socket_server_init(char *listen_ip, int listen_port)
 
 	if (listen(listenfd, 64) < 0)
 	{
-		printf("Use bind() to bind the TCP socket failure: %s\n", strerror(errno));
+		printf("Use listen() to listen the TCP socket failure: %s\n", strerror(errno));
 		rv = -3;
 		close(listenfd);
 		return rv;
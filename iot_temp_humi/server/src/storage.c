@@ -0,0 +1,213 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:01:14
+ * @Description: 服务器端存储线程
+ */
+
+#include "storage.h"
+#include <signal.h>
+
+/**
+ * @name: static void storage_publish(storage_t *storage)
+ * @description: 事务结束后把各来源在该事务中的记录计入处理进度，并通知来源发送确认
+ *               事务还未结束时直接返回，提交或插入失败时记下失败位置，来源据此断开受影响的连接让客户端重发
+ * @param {storage_t} *storage 存储线程
+ * @return {*}
+ */
+static void storage_publish(storage_t *storage)
+{
+    storage_source_t   *source;
+    uint64_t            one     = 1;
+    int                 failed;
+    int                 efd;
+    int                 i;
+
+    if (storage->batch.pending > 0)
+    {
+        return;
+    }
+
+    failed = (storage->batch.failures != storage->failures);
+    storage->failures = storage->batch.failures;
+
+    // 回滚的记录已在过滤器中标记，清空后重发的记录交给数据库的主键判断
+    if (failed)
+    {
+        dedup_reset(&storage->dedup);
+    }
+
+    for (i = 0; i < STORAGE_MAX_SOURCES; i++)
+    {
+        source = &storage->sources[i];
+        if (source->txn == 0)
+        {
+            continue;
+        }
+
+        // 来源还没处理上一次失败时两段合并，中间成功的记录也算在内，只会多断开几个连接
+        if (failed)
+        {
+            if (__atomic_load_n(&source->seen, __ATOMIC_ACQUIRE) == source->lost)
+            {
+                __atomic_store_n(&source->lost_from, source->done, __ATOMIC_RELAXED);
+            }
+            __atomic_store_n(&source->lost, source->done + source->txn, __ATOMIC_RELEASE);
+        }
+        __atomic_store_n(&source->done, source->done + source->txn, __ATOMIC_RELEASE);
+        source->txn = 0;
+
+        if ((efd = __atomic_load_n(&source->efd, __ATOMIC_ACQUIRE)) >= 0)
+        {
+            write(efd, &one, sizeof(one));
+        }
+    }
+}
+
+/**
+ * @name: static void *storage_thread(void *arg)
+ * @description: 存储线程主循环，数据库的慢写入只阻塞本线程，不阻塞网络线程
+ * @param {void} *arg 存储线程
+ * @return {*}
+ */
+static void *storage_thread(void *arg)
+{
+    storage_t      *storage = (storage_t *)arg;
+    packinfo_t      pack_info;
+    sigset_t        sigmask;
+    int             timeout;
+    int             src;
+
+    // 停止信号只由主线程处理
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, SIGINT);
+    sigaddset(&sigmask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+
+    log_info("storage thread running\n");
+
+    while (1)
+    {
+        if (!ingest_queue_pop(storage->queue, &pack_info, &src))
+        {
+            // 网络线程已全部退出且队列已写空
+            if (__atomic_load_n(&storage->stop, __ATOMIC_ACQUIRE) && ingest_queue_depth(storage->queue) == 0)
+            {
+                break;
+            }
+
+            // 有未提交的行时最多等到事务到期，队列空闲时提交
+            timeout = database_batch_poll(&storage->batch);
+            ingest_queue_wait(storage->queue, timeout >= 0 ? timeout : STORAGE_WAIT_TIMEOUT);
+            database_batch_poll(&storage->batch);
+            storage_publish(storage);
+            continue;
+        }
+
+        // 重复记录同样计入来源的处理进度，客户端重发的批量帧照常得到确认
+        storage->sources[src].txn++;
+        if (dedup_check(&storage->dedup, &pack_info))
+        {
+            storage_publish(storage);
+            continue;
+        }
+
+        if (database_batch_insert(&storage->batch, &pack_info) < 0)
+        {
+            log_error("storage database insert data failed!\n");
+            __atomic_fetch_add(&storage->errors, 1, __ATOMIC_RELAXED);
+
+            // 这条记录没有入库，按提交失败处理，不能向客户端确认，事务结束时受影响的连接断开让客户端重发
+            storage->batch.failures++;
+        }
+        else
+        {
+            __atomic_fetch_add(&storage->records, 1, __ATOMIC_RELAXED);
+            dedup_mark(&storage->dedup, &pack_info);
+        }
+        storage_publish(storage);
+    }
+
+    database_batch_close(&storage->batch);
+    dedup_destroy(&storage->dedup);
+    log_info("storage thread exit\n");
+    return NULL;
+}
+
+/**
+ * @name: int storage_start(storage_t *storage)
+ * @description: 启动存储线程
+ * @param {storage_t} *storage 存储线程
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int storage_start(storage_t *storage)
+{
+    int     i;
+
+    if (!storage || !storage->db || !storage->table || !storage->queue)
+    {
+        log_error("The storage_start() argument incorrect!\n");
+        return -1;
+    }
+
+    storage->stop     = 0;
+    storage->records  = 0;
+    storage->errors   = 0;
+    storage->failures = 0;
+    memset(storage->sources, 0, sizeof(storage->sources));
+    for (i = 0; i < STORAGE_MAX_SOURCES; i++)
+    {
+        storage->sources[i].efd = -1;
+    }
+
+    if (dedup_init(&storage->dedup) < 0)
+    {
+        return -2;
+    }
+
+    // 预编译的INSERT语句缓存在存储线程中，多行合并为一个事务提交
+    if (database_batch_init(storage->table, storage->db, &storage->batch, storage->batch_rows, storage->batch_ms) < 0)
+    {
+        dedup_destroy(&storage->dedup);
+        return -2;
+    }
+    if (pthread_create(&storage->tid, NULL, storage_thread, storage) != 0)
+    {
+        log_error("create storage thread failure\n");
+        database_batch_close(&storage->batch);
+        dedup_destroy(&storage->dedup);
+        return -3;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: void storage_stop(storage_t *storage)
+ * @description: 通知存储线程写完队列后退出，并等待其退出
+ * @param {storage_t} *storage 存储线程
+ * @return {*}
+ */
+void storage_stop(storage_t *storage)
+{
+    __atomic_store_n(&storage->stop, 1, __ATOMIC_RELEASE);
+    ingest_queue_wakeup(storage->queue);
+    pthread_join(storage->tid, NULL);
+}
+
+/**
+ * @name: void storage_attach(storage_t *storage, int src, int efd)
+ * @description: 登记来源的eventfd，该来源的记录提交后存储线程写入eventfd
+ * @param {storage_t} *storage 存储线程
+ * @param {int} src 来源编号
+ * @param {int} efd eventfd
+ * @return {*}
+ */
+void storage_attach(storage_t *storage, int src, int efd)
+{
+    if (storage && (src >= 0) && (src < STORAGE_MAX_SOURCES))
+    {
+        __atomic_store_n(&storage->sources[src].efd, efd, __ATOMIC_RELEASE);
+    }
+}
@@ -0,0 +1,820 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:01:14
+ * @Description: 服务器端epoll工作线程
+ */
+#define _GNU_SOURCE     // for pthread_setaffinity_np, accept4
+#include "worker.h"
+#include <sched.h>
+#include <signal.h>
+
+#define STAT_ADD(w, field, n)   __atomic_fetch_add(&(w)->stat.field, (n), __ATOMIC_RELAXED)
+
+/**
+ * @name: int worker_init(worker_t *worker, int id, char *listen_ip, int listen_port, int reuseport)
+ * @description: 创建工作线程自己的监听套接字和epoll实例
+ * @param {worker_t} *worker 工作线程
+ * @param {int} id 线程编号，同时决定绑定的CPU核
+ * @param {char} *listen_ip 监听IP
+ * @param {int} listen_port 监听端口
+ * @param {int} reuseport 非0则使用SO_REUSEPORT
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int worker_init(worker_t *worker, int id, char *listen_ip, int listen_port, int reuseport)
+{
+    struct epoll_event  event;
+    long                ncpu;
+
+    if (!worker)
+    {
+        log_error("The worker_init() argument incorrect!\n");
+        return -1;
+    }
+
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    worker->id       = id;
+    worker->cpu      = ncpu > 0 ? id % ncpu : 0;
+    worker->listenfd = -1;
+    worker->epollfd  = -1;
+    worker->conns    = NULL;
+    worker->blocked  = NULL;
+    worker->acking   = NULL;
+    worker->pushed   = 0;
+    worker->efd      = -1;
+    memset(&worker->stat, 0, sizeof(worker->stat));
+
+    if ((worker->listenfd = socket_server_init(listen_ip, listen_port, reuseport)) < 0)
+    {
+        log_error("worker[%d] listen on port %d failure\n", id, listen_port);
+        return -2;
+    }
+
+    if (set_nonblocking(worker->listenfd) < 0)
+    {
+        log_error("worker[%d] set listen socket nonblocking failure:%s\n", id, strerror(errno));
+        close(worker->listenfd);
+        return -2;
+    }
+
+    if ((worker->epollfd = epoll_create(WORKER_MAX_EVENTS)) < 0)
+    {
+        log_error("worker[%d] create epoll failure:%s\n", id, strerror(errno));
+        close(worker->listenfd);
+        return -3;
+    }
+
+    event.events   = EPOLLIN;
+    event.data.ptr = NULL;                  // data.ptr为NULL表示监听套接字
+    if (epoll_ctl(worker->epollfd, EPOLL_CTL_ADD, worker->listenfd, &event) < 0)
+    {
+        log_error("worker[%d] execute epoll_ctl failure:%s\n", id, strerror(errno));
+        close(worker->epollfd);
+        close(worker->listenfd);
+        return -4;
+    }
+
+    event.events   = EPOLLIN;
+    event.data.ptr = &worker->efd;          // data.ptr指向efd表示存储线程的提交通知
+    if (((worker->efd = eventfd(0, EFD_NONBLOCK)) < 0)
+        || (epoll_ctl(worker->epollfd, EPOLL_CTL_ADD, worker->efd, &event) < 0))
+    {
+        log_error("worker[%d] create commit eventfd failure:%s\n", id, strerror(errno));
+        if (worker->efd >= 0)
+        {
+            close(worker->efd);
+        }
+        close(worker->epollfd);
+        close(worker->listenfd);
+        return -5;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static void worker_close_conn(worker_t *worker, conn_t *conn)
+ * @description: 从epoll和连接链表中移除连接，关闭套接字并释放
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @return {*}
+ */
+static void worker_close_conn(worker_t *worker, conn_t *conn)
+{
+    conn_t    **pp;
+
+    if (epoll_ctl(worker->epollfd, EPOLL_CTL_DEL, conn->fd, NULL) < 0)
+    {
+        log_error("worker[%d] epoll_ctl del socket[%d] failure: %s \n", worker->id, conn->fd, strerror(errno));
+    }
+
+    if (conn->blocked)
+    {
+        for (pp = &worker->blocked; *pp; pp = &(*pp)->next_blocked)
+        {
+            if (*pp == conn)
+            {
+                *pp = conn->next_blocked;
+                break;
+            }
+        }
+    }
+
+    if (conn->acking)
+    {
+        for (pp = &worker->acking; *pp; pp = &(*pp)->next_acking)
+        {
+            if (*pp == conn)
+            {
+                *pp = conn->next_acking;
+                break;
+            }
+        }
+    }
+
+    if (conn->prev)
+    {
+        conn->prev->next = conn->next;
+    }
+    else
+    {
+        worker->conns = conn->next;
+    }
+    if (conn->next)
+    {
+        conn->next->prev = conn->prev;
+    }
+
+    conn_free(conn);
+    STAT_ADD(worker, closes, 1);
+}
+
+/**
+ * @name: static void worker_accept(worker_t *worker)
+ * @description: 接受所有等待中的客户端连接，以非阻塞边沿触发方式加入本线程的epoll
+ * @param {worker_t} *worker 工作线程
+ * @return {*}
+ */
+static void worker_accept(worker_t *worker)
+{
+    struct epoll_event  event;
+    conn_t             *conn;
+    int                 connfd;
+
+    while (1)
+    {
+        if ((connfd = accept4(worker->listenfd, (struct sockaddr *)NULL, NULL, SOCK_NONBLOCK)) < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                log_error("worker[%d] accept() failure: %s \n", worker->id, strerror(errno));
+            }
+            return;
+        }
+
+        if ((conn = conn_new(connfd)) == NULL)
+        {
+            close(connfd);
+            continue;
+        }
+        conn->acked  = worker->pushed;
+        conn->pushed = worker->pushed;
+
+        event.data.ptr = conn;
+        event.events   = EPOLLIN | EPOLLRDHUP | EPOLLET;
+        if (epoll_ctl(worker->epollfd, EPOLL_CTL_ADD, connfd, &event) < 0)
+        {
+            log_error("worker[%d] epoll add client socket failure: %s \n", worker->id, strerror(errno));
+            conn_free(conn);
+            continue;
+        }
+
+        conn->next = worker->conns;
+        if (worker->conns)
+        {
+            worker->conns->prev = conn;
+        }
+        worker->conns = conn;
+
+        STAT_ADD(worker, accepts, 1);
+        log_info("worker[%d] epoll add new client socket[%d] ok.\n", worker->id, connfd);
+    }
+}
+
+/**
+ * @name: static int worker_handshake(worker_t *worker, conn_t *conn, int version)
+ * @description: 应答客户端的握手行，选定双方都支持的最高协议版本，之后的字节流按该版本切分
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @param {int} version 客户端支持的最高版本
+ * @return {int} 0为正常执行，非0则应答发送失败
+ */
+static int worker_handshake(worker_t *worker, conn_t *conn, int version)
+{
+    char        reply[32];
+    int         len;
+
+    if (version > PROTO_VERSION)
+    {
+        version = PROTO_VERSION;
+    }
+
+    // 握手是连接上的第一帧，发送缓冲区为空，非阻塞write不会只写一部分
+    len = snprintf(reply, sizeof(reply), "%s %d\n", PROTO_HELLO, version);
+    if (write(conn->fd, reply, len) != len)
+    {
+        log_error("worker[%d] socket[%d] handshake reply failure: %s\n", worker->id, conn->fd, strerror(errno));
+        return -1;
+    }
+
+    conn->proto = version;
+    log_info("worker[%d] socket[%d] use %s protocol version %d\n", worker->id, conn->fd,
+             version ? "binary" : "text", version);
+    return 0;
+}
+
+/**
+ * @name: static int worker_push(worker_t *worker, packinfo_t *pack_info)
+ * @description: 把一条记录送入入库队列
+ * @param {worker_t} *worker 工作线程
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，-1为入库队列已满
+ */
+static int worker_push(worker_t *worker, packinfo_t *pack_info)
+{
+    if (ingest_queue_push(worker->queue, pack_info, worker->id) < 0)
+    {
+        return -1;
+    }
+
+    worker->pushed++;
+    STAT_ADD(worker, records, 1);
+    return 0;
+}
+
+/**
+ * @name: static int worker_ack_conn(worker_t *worker, conn_t *conn, uint64_t done)
+ * @description: 弹出记录都已处理的批量帧，只为其中序号最大的一个发送累计确认
+ *               失败的事务必须先由worker_drop_lost()处理，否则会确认没有写入的记录
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @param {uint64_t} done 存储线程已处理的本线程记录数
+ * @return {int} 0为正常执行，-1为需要关闭连接
+ */
+static int worker_ack_conn(worker_t *worker, conn_t *conn, uint64_t done)
+{
+    uint8_t     frame[PROTO_ACK_FRAME_LEN];
+    conn_ack_t *ack;
+    uint32_t    seq     = 0;
+    int         found   = 0;
+    int         len;
+
+    while (conn->ack_count > 0)
+    {
+        ack = &conn->acks[conn->ack_head];
+        if (ack->upto > done)
+        {
+            break;
+        }
+
+        seq         = ack->seq;
+        conn->acked = ack->upto;
+        conn->ack_head = (conn->ack_head + 1) % CONN_ACK_PENDING;
+        conn->ack_count--;
+        found = 1;
+    }
+
+    if (!found)
+    {
+        return 0;
+    }
+
+    // 确认帧很小，非阻塞write写不完说明客户端长期不读，按连接异常处理
+    len = proto_encode_ack(frame, sizeof(frame), seq);
+    if (write(conn->fd, frame, len) != len)
+    {
+        log_error("worker[%d] socket[%d] send ack %u failure: %s\n", worker->id, conn->fd, seq, strerror(errno));
+        return -1;
+    }
+
+    STAT_ADD(worker, acks, 1);
+    return 0;
+}
+
+/**
+ * @name: static int worker_ack_add(worker_t *worker, conn_t *conn, uint32_t seq)
+ * @description: 批量帧的记录全部入队后登记等待确认，记录已全部处理(如都被丢弃)时立即确认
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @param {uint32_t} seq 批量帧序号
+ * @return {int} 0为正常执行，-1为需要关闭连接
+ */
+static int worker_ack_add(worker_t *worker, conn_t *conn, uint32_t seq)
+{
+    storage_source_t   *source;
+    conn_ack_t         *ack;
+    uint64_t            done;
+
+    // 确认是累计的，等待项已满时合并到最新的一项，只是推迟前面几帧的确认
+    if (conn->ack_count == CONN_ACK_PENDING)
+    {
+        ack = &conn->acks[(conn->ack_head + conn->ack_count - 1) % CONN_ACK_PENDING];
+    }
+    else
+    {
+        ack = &conn->acks[(conn->ack_head + conn->ack_count) % CONN_ACK_PENDING];
+        conn->ack_count++;
+    }
+    ack->seq  = seq;
+    ack->upto = worker->pushed;
+
+    if (!conn->acking)
+    {
+        conn->acking      = 1;
+        conn->next_acking = worker->acking;
+        worker->acking    = conn;
+    }
+
+    // 先读done再读lost，有还没处理的失败事务时交给随后的worker_send_acks()
+    source = &worker->storage->sources[worker->id];
+    done   = __atomic_load_n(&source->done, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&source->lost, __ATOMIC_ACQUIRE) != source->seen)
+    {
+        return 0;
+    }
+
+    return worker_ack_conn(worker, conn, done);
+}
+
+/**
+ * @name: static void worker_drop_lost(worker_t *worker, uint64_t lost)
+ * @description: 存储线程的事务失败后，只断开有记录落在失败范围(lost_from, lost]中的二进制连接，让客户端重发未确认的数据
+ *               连接未确认的记录都在(acked, pushed]中，其他连接的记录也可能夹在其中，只会多断开，不会漏掉
+ * @param {worker_t} *worker 工作线程
+ * @param {uint64_t} lost 存储线程发布的lost
+ * @return {*}
+ */
+static void worker_drop_lost(worker_t *worker, uint64_t lost)
+{
+    storage_source_t   *source = &worker->storage->sources[worker->id];
+    uint64_t            from   = __atomic_load_n(&source->lost_from, __ATOMIC_RELAXED);
+    conn_t             *conn   = worker->conns;
+    conn_t             *next;
+
+    while (conn)
+    {
+        next = conn->next;
+        if (conn->proto && (conn->acked < lost) && (conn->pushed > from))
+        {
+            log_error("worker[%d] socket[%d] records lost in a failed commit, close to make client resend\n",
+                      worker->id, conn->fd);
+            worker_close_conn(worker, conn);
+        }
+        conn = next;
+    }
+
+    __atomic_store_n(&source->seen, lost, __ATOMIC_RELEASE);
+}
+
+/**
+ * @name: static void worker_send_acks(worker_t *worker)
+ * @description: 存储线程提交后为等待确认的连接发送确认，没有等待项的连接移出链表
+ *               发送失败的连接在这里关闭，只能在一轮epoll事件全部处理完后调用
+ * @param {worker_t} *worker 工作线程
+ * @return {*}
+ */
+static void worker_send_acks(worker_t *worker)
+{
+    storage_source_t   *source = &worker->storage->sources[worker->id];
+    conn_t            **pp     = &worker->acking;
+    conn_t             *conn;
+    uint64_t            done;
+    uint64_t            lost;
+    uint64_t            n;
+    int                 rv;
+
+    read(worker->efd, &n, sizeof(n));
+    done = __atomic_load_n(&source->done, __ATOMIC_ACQUIRE);
+    lost = __atomic_load_n(&source->lost, __ATOMIC_ACQUIRE);
+    if (lost != source->seen)
+    {
+        worker_drop_lost(worker, lost);
+    }
+
+    while ((conn = *pp) != NULL)
+    {
+        if (((rv = worker_ack_conn(worker, conn, done)) < 0) || (conn->ack_count == 0))
+        {
+            *pp = conn->next_acking;
+            conn->acking      = 0;
+            conn->next_acking = NULL;
+            if (rv < 0)
+            {
+                worker_close_conn(worker, conn);
+            }
+            continue;
+        }
+        pp = &conn->next_acking;
+    }
+}
+
+/**
+ * @name: static int worker_binary_record(worker_t *worker, conn_t *conn, const uint8_t *payload, size_t plen)
+ * @description: 把一条二进制记录转换为数据结构体并送入入库队列，设备号未注册的记录被丢弃
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @param {uint8_t} *payload 14字节的记录
+ * @param {size_t} plen 记录长度
+ * @return {int} 0为已处理(包括被丢弃的记录)，-1为入库队列已满
+ */
+static int worker_binary_record(worker_t *worker, conn_t *conn, const uint8_t *payload, size_t plen)
+{
+    packinfo_t      pack_info;
+    proto_record_t  rec;
+
+    if ((proto_parse_record(payload, plen, &rec) < 0) || (rec.dev >= PROTO_MAX_DEVICES)
+        || (conn->devices[rec.dev][0] == '\0'))
+    {
+        STAT_ADD(worker, errors, 1);
+        return 0;
+    }
+
+    strcpy(pack_info.devid, conn->devices[rec.dev]);
+    pack_info.time[0] = '\0';
+    pack_info.ts      = rec.ts;
+    pack_info.temp    = rec.temp / 100.0f;
+    pack_info.humi    = rec.humi / 100.0f;
+
+    if (worker_push(worker, &pack_info) < 0)
+    {
+        return -1;
+    }
+    conn->pushed = worker->pushed;
+    return 0;
+}
+
+/**
+ * @name: static int worker_binary_frame(worker_t *worker, conn_t *conn, uint8_t *frame, size_t len)
+ * @description: 处理一个已通过crc校验的二进制帧，设备注册帧记入连接的设备表，记录帧和批量帧送入入库队列
+ *               批量帧中途遇到队列已满时记下已送入的记录数，重试时从下一条继续，不会重复入库
+ *               批量帧全部入队后登记等待确认，存储线程提交后由worker_send_acks()发送确认
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @param {uint8_t} *frame 整个帧
+ * @param {size_t} len 帧长度
+ * @return {int} 0为已处理(包括内容错误被丢弃的帧)，-1为入库队列已满，-2为需要关闭连接
+ */
+static int worker_binary_frame(worker_t *worker, conn_t *conn, uint8_t *frame, size_t len)
+{
+    const uint8_t  *payload = frame + PROTO_HDR_LEN;
+    size_t          plen    = len - PROTO_HDR_LEN - PROTO_CRC_LEN;
+    uint16_t        dev;
+    char            name[DEVID_LEN];
+    uint32_t        seq;
+    int             count;
+
+    switch (frame[1])
+    {
+    case PROTO_TYPE_DEVICE:
+        if ((proto_parse_device(payload, plen, &dev, name, sizeof(name)) < 0) || (dev >= PROTO_MAX_DEVICES))
+        {
+            break;
+        }
+        strcpy(conn->devices[dev], name);
+        log_info("worker[%d] socket[%d] register device[%u] %s\n", worker->id, conn->fd, dev, name);
+        return 0;
+
+    case PROTO_TYPE_RECORD:
+        return worker_binary_record(worker, conn, payload, plen);
+
+    case PROTO_TYPE_BATCH:
+        if ((count = proto_batch_count(payload, plen, &seq)) < 0)
+        {
+            break;
+        }
+        for ( ; conn->batch_done < count; conn->batch_done++)
+        {
+            if (worker_binary_record(worker, conn, payload + PROTO_BATCH_HDR_LEN + conn->batch_done * PROTO_RECORD_LEN,
+                                     PROTO_RECORD_LEN) < 0)
+            {
+                return -1;
+            }
+        }
+        conn->batch_done = 0;
+        return worker_ack_add(worker, conn, seq) < 0 ? -2 : 0;
+    }
+
+    STAT_ADD(worker, errors, 1);
+    return 0;
+}
+
+/**
+ * @name: static int worker_handle_frame(worker_t *worker, conn_t *conn, char *frame, size_t len)
+ * @description: 解析一个完整的帧并送入入库队列，文本协议下的握手行在这里应答
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @param {char} *frame 文本协议下为以'\0'结尾的帧，二进制协议下为整个二进制帧
+ * @param {size_t} len 帧长度
+ * @return {int} 0为已处理(包括解析失败被丢弃的帧)，-1为入库队列已满，-2为需要关闭连接
+ */
+static int worker_handle_frame(worker_t *worker, conn_t *conn, char *frame, size_t len)
+{
+    packinfo_t  pack_info;
+    int         version;
+
+    if (conn->proto)
+    {
+        return worker_binary_frame(worker, conn, (uint8_t *)frame, len);
+    }
+
+    if ((version = proto_parse_hello(frame)) >= 0)
+    {
+        return worker_handshake(worker, conn, version) < 0 ? -2 : 0;
+    }
+
+    if (packinfo_parse(frame, len, &pack_info) < 0)
+    {
+        STAT_ADD(worker, errors, 1);
+        return 0;
+    }
+
+    return worker_push(worker, &pack_info);
+}
+
+/**
+ * @name: static void worker_block_conn(worker_t *worker, conn_t *conn)
+ * @description: 入库队列已满时暂停读取该连接，数据留在内核缓冲区中，由TCP窗口向客户端施加背压
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @return {*}
+ */
+static void worker_block_conn(worker_t *worker, conn_t *conn)
+{
+    if (conn->blocked)
+    {
+        return;
+    }
+
+    conn->blocked      = 1;
+    conn->next_blocked = worker->blocked;
+    worker->blocked    = conn;
+    STAT_ADD(worker, stalls, 1);
+}
+
+/**
+ * @name: static void worker_read(worker_t *worker, conn_t *conn)
+ * @description: 先处理接收缓冲区中已有的完整帧，再把套接字读到EAGAIN并继续取帧
+ *               入库队列已满时停在当前帧，连接进入暂停链表，稍后从同一位置继续
+ * @param {worker_t} *worker 工作线程
+ * @param {conn_t} *conn 客户端连接
+ * @return {*}
+ */
+static void worker_read(worker_t *worker, conn_t *conn)
+{
+    char       *frame;
+    size_t      len;
+    size_t      pending;
+    int         rv;
+
+    while (1)
+    {
+        while ((rv = conn_next_frame(conn, &frame, &len)) == CONN_FRAME_OK)
+        {
+            if (len == 0)
+            {
+                continue;
+            }
+
+            if ((rv = worker_handle_frame(worker, conn, frame, len)) == -1)
+            {
+                conn_unget_frame(conn, frame, len);
+                worker_block_conn(worker, conn);
+                return;
+            }
+
+            if (rv < 0)
+            {
+                rv = CONN_FRAME_BAD;
+                break;
+            }
+        }
+
+        // 二进制字节流失去同步，无法再切分出后续的帧
+        if (rv == CONN_FRAME_BAD)
+        {
+            STAT_ADD(worker, errors, 1);
+            conn->readable = 0;
+            conn->closing  = 1;
+            break;
+        }
+
+        if (!conn->readable)
+        {
+            break;
+        }
+
+        pending = conn->rx_tail - conn->rx_head;
+        rv = conn_recv(conn);
+        STAT_ADD(worker, reads, 1);
+        STAT_ADD(worker, bytes, conn->rx_tail - conn->rx_head - pending);
+
+        if (rv == CONN_RECV_AGAIN)
+        {
+            conn->readable = 0;
+        }
+        else if (rv != CONN_RECV_FULL)
+        {
+            conn->readable = 0;
+            conn->closing  = 1;
+        }
+    }
+
+    if (conn->closing)
+    {
+        log_error("worker[%d] socket[%d] read failure or get disconnect and will be removed. \n", worker->id, conn->fd);
+        worker_close_conn(worker, conn);
+    }
+}
+
+/**
+ * @name: static void worker_retry_blocked(worker_t *worker)
+ * @description: 重新处理因入库队列已满而暂停读取的连接
+ * @param {worker_t} *worker 工作线程
+ * @return {*}
+ */
+static void worker_retry_blocked(worker_t *worker)
+{
+    conn_t     *conn = worker->blocked;
+    conn_t     *next;
+
+    worker->blocked = NULL;
+    while (conn)
+    {
+        next = conn->next_blocked;
+        conn->blocked      = 0;
+        conn->next_blocked = NULL;
+        worker_read(worker, conn);
+        conn = next;
+    }
+}
+
+/**
+ * @name: static void *worker_thread(void *arg)
+ * @description: 工作线程主循环，绑定CPU核后处理本线程epoll上的所有事件
+ * @param {void} *arg 工作线程
+ * @return {*}
+ */
+static void *worker_thread(void *arg)
+{
+    worker_t           *worker = (worker_t *)arg;
+    struct epoll_event  event_array[WORKER_MAX_EVENTS];
+    cpu_set_t           cpuset;
+    sigset_t            sigmask;
+    conn_t             *conn;
+    int                 committed;
+    int                 events;
+    int                 i;
+
+    // 停止信号只由主线程处理
+    sigemptyset(&sigmask);
+    sigaddset(&sigmask, SIGINT);
+    sigaddset(&sigmask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &sigmask, NULL);
+
+    CPU_ZERO(&cpuset);
+    CPU_SET(worker->cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+    {
+        log_warn("worker[%d] bind to cpu%d failure\n", worker->id, worker->cpu);
+    }
+    log_info("worker[%d] running on cpu%d, listen socket[%d]\n", worker->id, worker->cpu, worker->listenfd);
+
+    while (!g_sigstop)
+    {
+        events = epoll_wait(worker->epollfd, event_array, WORKER_MAX_EVENTS,
+                            worker->blocked ? WORKER_RETRY_TIMEOUT : WORKER_WAIT_TIMEOUT);
+        if (events < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log_error("worker[%d] epoll failure: %s\n", worker->id, strerror(errno));
+            break;
+        }
+
+        STAT_ADD(worker, wakeups, 1);
+
+        committed = 0;
+        for (i = 0; i < events; i++)
+        {
+            conn = (conn_t *)event_array[i].data.ptr;
+
+            // 监听socket得到event意味着有新的客户端链接
+            if (conn == NULL)
+            {
+                worker_accept(worker);
+                continue;
+            }
+
+            // 发送确认失败会关闭其他连接，它们可能还在本次返回的事件中，等所有事件处理完再发送
+            if (conn == (conn_t *)&worker->efd)
+            {
+                committed = 1;
+                continue;
+            }
+
+            if (event_array[i].events & EPOLLERR)
+            {
+                log_error("worker[%d] epoll_wait get error on fd[%d]\n", worker->id, conn->fd);
+                worker_close_conn(worker, conn);
+                continue;
+            }
+
+            // EPOLLHUP/EPOLLRDHUP时缓冲区中可能还有数据，由worker_read()读完后关闭
+            conn->readable = 1;
+            if (!conn->blocked)
+            {
+                worker_read(worker, conn);
+            }
+        }
+
+        if (committed)
+        {
+            worker_send_acks(worker);
+        }
+
+        if (worker->blocked)
+        {
+            worker_retry_blocked(worker);
+        }
+    }
+
+    while (worker->conns)
+    {
+        worker_close_conn(worker, worker->conns);
+    }
+    storage_attach(worker->storage, worker->id, -1);
+    close(worker->efd);
+    close(worker->epollfd);
+    close(worker->listenfd);
+    log_info("worker[%d] exit\n", worker->id);
+    return NULL;
+}
+
+/**
+ * @name: int worker_start(worker_t *worker)
+ * @description: 启动工作线程
+ * @param {worker_t} *worker 工作线程
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+int worker_start(worker_t *worker)
+{
+    if (!worker || !worker->queue || !worker->storage || (worker->id >= STORAGE_MAX_SOURCES))
+    {
+        log_error("The worker_start() argument incorrect!\n");
+        return -1;
+    }
+
+    storage_attach(worker->storage, worker->id, worker->efd);
+
+    if (pthread_create(&worker->tid, NULL, worker_thread, worker) != 0)
+    {
+        log_error("worker[%d] create thread failure\n", worker->id);
+        return -2;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: void worker_join(worker_t *worker)
+ * @description: 等待工作线程退出
+ * @param {worker_t} *worker 工作线程
+ * @return {*}
+ */
+void worker_join(worker_t *worker)
+{
+    pthread_join(worker->tid, NULL);
+}
+
+/**
+ * @name: void worker_stat_snapshot(worker_t *worker, worker_stat_t *stat)
+ * @description: 读取工作线程计数器快照
+ * @param {worker_t} *worker 工作线程
+ * @param {worker_stat_t} *stat 计数器快照
+ * @return {*}
+ */
+void worker_stat_snapshot(worker_t *worker, worker_stat_t *stat)
+{
+    stat->accepts = __atomic_load_n(&worker->stat.accepts, __ATOMIC_RELAXED);
+    stat->closes  = __atomic_load_n(&worker->stat.closes, __ATOMIC_RELAXED);
+    stat->reads   = __atomic_load_n(&worker->stat.reads, __ATOMIC_RELAXED);
+    stat->bytes   = __atomic_load_n(&worker->stat.bytes, __ATOMIC_RELAXED);
+    stat->records = __atomic_load_n(&worker->stat.records, __ATOMIC_RELAXED);
+    stat->errors  = __atomic_load_n(&worker->stat.errors, __ATOMIC_RELAXED);
+    stat->wakeups = __atomic_load_n(&worker->stat.wakeups, __ATOMIC_RELAXED);
+    stat->stalls  = __atomic_load_n(&worker->stat.stalls, __ATOMIC_RELAXED);
+    stat->acks    = __atomic_load_n(&worker->stat.acks, __ATOMIC_RELAXED);
+}
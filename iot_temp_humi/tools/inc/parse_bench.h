@@ -0,0 +1,25 @@
+/***
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:10:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:10:00
+ * @Description: 文本帧解析微基准
+ */
+
+#ifndef _PARSE_BENCH_H_
+#define _PARSE_BENCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "logger.h"
+#include "packinfo.h"
+
+#define BENCH_FRAMES        100000      // 每轮解析的帧数
+#define BENCH_MIN_MS        1000        // 每个解析函数最少运行时间(ms)
+#define BENCH_CHECK_VALUES  1000000     // 浮点解析一致性检查的随机数个数
+
+#endif
@@ -0,0 +1,102 @@
+/***
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:40:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 19:40:00
+ * @Description: 旧版全文本表到时序表的在线迁移工具
+ */
+
+#ifndef _SHT20_MIGRATE_H_
+#define _SHT20_MIGRATE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "logger.h"
+#include "packinfo.h"
+#include "database.h"
+#include "sqlite3.h"
+
+#define MIGRATE_DATABASE        "sht20"             // 默认数据库名
+#define MIGRATE_LEGACY_TABLE    "RPI4B"             // 默认旧版表名
+#define MIGRATE_PROGRESS_TABLE  "migrate_progress"  // 断点续传进度表
+#define MIGRATE_PROFILE         "throughput"        // 默认存储配置
+#define MIGRATE_MAX_THREADS     16                  // 最大读取线程数
+#define MIGRATE_PARTS_PER_THREAD 4                  // 每个读取线程对应的分区数，分区越多负载越均衡
+#define MIGRATE_BATCH_ROWS      20000               // 每批读取的行数，也是每个写事务的行数
+#define MIGRATE_REPORT_MS       1000                // 进度打印间隔(ms)
+
+/***
+ * @name: migrate_part_t
+ * @description: 旧表按rowid划分的分区，next之前的行已迁移并提交
+ */
+typedef struct migrate_part_s
+{
+    int                 id;             // 分区编号
+    int64_t             lo;             // 起始rowid
+    int64_t             hi;             // 结束rowid(包含)
+    int64_t             next;           // 下一个待迁移的rowid，大于hi表示分区已完成
+} migrate_part_t;
+
+/***
+ * @name: migrate_batch_t
+ * @description: 读取线程解析好的一批行，写线程在一个事务中写入并更新分区进度
+ */
+typedef struct migrate_batch_s
+{
+    int                 part;           // 所属分区
+    int64_t             next;           // 本批提交后分区的续传位置
+    int                 nrows;          // 有效行数
+    int                 bad;            // 无法解析而跳过的行数
+    packinfo_t          rows[];         // 解析后的行
+} migrate_batch_t;
+
+/***
+ * @name: migrate_queue_t
+ * @description: 读取线程到写线程的有界批次队列
+ */
+typedef struct migrate_queue_s
+{
+    pthread_mutex_t     lock;
+    pthread_cond_t      not_empty;
+    pthread_cond_t      not_full;
+    migrate_batch_t   **slots;          // 环形缓冲区
+    int                 size;           // 容量
+    int                 head;           // 队首下标
+    int                 count;          // 队列中的批次数
+    int                 producers;      // 仍在运行的读取线程数
+    int                 closed;         // 写线程已退出，读取线程停止入队
+} migrate_queue_t;
+
+/***
+ * @name: migrate_t
+ * @description: 迁移任务
+ */
+typedef struct migrate_s
+{
+    char                dbpath[128];    // 数据库文件路径
+    char               *table;          // 旧版表名
+    sqlite3            *db;             // 写连接
+    db_batch_t          batch;          // 时序表批量写入
+    sqlite3_stmt       *progress;       // 缓存的进度更新语句
+    int                 nthreads;       // 读取线程数
+    int                 batch_rows;     // 每批行数
+    migrate_part_t     *parts;          // 分区
+    int                 nparts;         // 分区数
+    int                 next_part;      // 下一个待领取的分区
+    migrate_queue_t     queue;          // 批次队列
+    uint64_t            rows;           // 已提交的行数
+    uint64_t            bad;            // 跳过的行数
+    uint64_t            batches;        // 已提交的批次数
+} migrate_t;
+
+#endif
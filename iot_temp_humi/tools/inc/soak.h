@@ -0,0 +1,62 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 22:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 22:20:00
+ * @Description: 客户端和服务器的长时间运行测试
+ */
+
+#ifndef _SOAK_H_
+#define _SOAK_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define SOAK_ALLOC_ENV      "SOAK_ALLOC_FILE"   // soak_alloc计数文件路径的环境变量
+#define SOAK_PORT           18900               // 默认端口
+#define SOAK_HOURS          4.0                 // 默认运行时间(小时)
+#define SOAK_REPORT_S       300                 // 默认报告间隔(s)
+#define SOAK_WARMUP_S       600                 // 计算RSS增长时跳过的启动时间(s)
+#define SOAK_DIR            "soak_run"          // 默认运行目录
+
+/***
+ * @name: soak_alloc_t
+ * @description: soak_alloc写入共享文件的分配计数
+ */
+typedef struct soak_alloc_s
+{
+    uint64_t        allocs;                     // malloc/calloc/realloc次数
+    uint64_t        frees;                      // free次数
+    uint64_t        bytes;                      // 申请的字节数
+} soak_alloc_t;
+
+/***
+ * @name: soak_proc_t
+ * @description: 被测进程
+ */
+typedef struct soak_proc_s
+{
+    const char     *role;                       // server/client
+    pid_t           pid;                        // 进程号
+    char            dir[320];                   // 工作目录
+    char            alloc_path[320];            // 分配计数文件
+    long            rss_kb;                     // 当前RSS(kB)
+    long            rss_base_kb;                // 预热结束时的RSS(kB)
+    int             fds;                        // 打开的描述符数
+    soak_alloc_t    alloc;                      // 当前分配计数
+    soak_alloc_t    alloc_last;                 // 上次报告时的分配计数
+} soak_proc_t;
+
+#endif
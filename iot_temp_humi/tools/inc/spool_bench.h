@@ -0,0 +1,37 @@
+/*** 
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:50:00
+ * @Description: 客户端溢出缓存后端基准
+ */
+
+#ifndef _SPOOL_BENCH_H_
+#define _SPOOL_BENCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "logger.h"
+#include "spool.h"
+
+#define BENCH_ROWS          2000        // 默认每个用例追加的记录数
+#define BENCH_DRAIN_ROWS    128         // 每次读回的记录数，与客户端DRAIN_ROWS相同
+#define BENCH_NAME          "spool_bench" // 基准使用的数据库名和缓存文件名
+
+/***
+ * @name: bench_case_t
+ * @description: 一个基准用例
+ */
+typedef struct bench_case_s
+{
+    const char     *spool;              // 后端配置，同客户端-Q
+    const char     *profile;            // SQLite存储配置，同客户端-S
+    int             batch_rows;         // 每次落盘的条数，同客户端-B
+} bench_case_t;
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 20:10:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:10:00
+ * @Description: 文本帧解析微基准，单线程测量每个核每秒能解析的帧数
+ *   legacy    最初的data_segmentation()：strtok + strcpy + atof，不转换时间
+ *   strtok_r  可重入的strtok_r副本切分 + atof + sscanf/mktime转换时间
+ *   view      packinfo_parse()：SIMD查找分隔符，快速浮点解析，按小时缓存的时间转换
+ *
+ *   编译: gcc -O2 -Iinc -I../server/inc src/parse_bench.c ../server/src/packinfo.c
+ *         ../server/src/logger.c -o parse_bench -lm
+ */
+
+#include "parse_bench.h"
+
+typedef int (*bench_parser_t)(char *frame, size_t len, packinfo_t *pack_info);
+
+/**
+ * @name: static int64_t bench_now_ns(void)
+ * @description: 获取单调时钟的纳秒数
+ * @return {int64_t} 纳秒数
+ */
+static int64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @name: static int parse_legacy(char *frame, size_t len, packinfo_t *pack_info)
+ * @description: 最初的data_segmentation()，字段数不对时会越界，这里只用于对比
+ * @param {char} *frame 以'\0'结尾的帧
+ * @param {size_t} len 帧长度
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行
+ */
+static int parse_legacy(char *frame, size_t len, packinfo_t *pack_info)
+{
+    char        *buf_ptr[4];
+    char        *p = NULL;
+    int          j = 0;
+
+    p = strtok(frame, "/");
+    while(p)
+    {
+        buf_ptr[j++] = p;
+        p = strtok(NULL, "/");
+    }
+
+    strcpy(pack_info->devid, buf_ptr[0]);
+    strcpy(pack_info->time, buf_ptr[1]);
+    pack_info->temp = atof(buf_ptr[2]);
+    pack_info->humi = atof(buf_ptr[3]);
+
+    return 0;
+}
+
+/**
+ * @name: static int parse_strtok_r(char *frame, size_t len, packinfo_t *pack_info)
+ * @description: 在副本上用strtok_r切分，sscanf + mktime转换时间
+ * @param {char} *frame 以'\0'结尾的帧
+ * @param {size_t} len 帧长度
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int parse_strtok_r(char *frame, size_t len, packinfo_t *pack_info)
+{
+    char         line[DEVID_LEN + TIME_LEN + 64];
+    char        *buf_ptr[4];
+    char        *p = NULL;
+    char        *saveptr = NULL;
+    int          j = 0;
+    struct tm    tm;
+
+    snprintf(line, sizeof(line), "%s", frame);
+    p = strtok_r(line, "/", &saveptr);
+    while(p && j < 4)
+    {
+        buf_ptr[j++] = p;
+        p = strtok_r(NULL, "/", &saveptr);
+    }
+
+    if( j != 4 || strlen(buf_ptr[0]) >= DEVID_LEN || strlen(buf_ptr[1]) >= TIME_LEN )
+    {
+        return -1;
+    }
+
+    strcpy(pack_info->devid, buf_ptr[0]);
+    strcpy(pack_info->time, buf_ptr[1]);
+    pack_info->temp = atof(buf_ptr[2]);
+    pack_info->humi = atof(buf_ptr[3]);
+
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(pack_info->time, "%d-%d-%d %d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+    {
+        return -2;
+    }
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    tm.tm_isdst = -1;
+    pack_info->ts = (int64_t)mktime(&tm) * 1000;
+
+    return 0;
+}
+
+/**
+ * @name: static int parse_view(char *frame, size_t len, packinfo_t *pack_info)
+ * @description: packinfo_parse()
+ * @param {char} *frame 帧
+ * @param {size_t} len 帧长度
+ * @param {packinfo_t} *pack_info 数据结构体
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int parse_view(char *frame, size_t len, packinfo_t *pack_info)
+{
+    return packinfo_parse(frame, len, pack_info);
+}
+
+/**
+ * @name: static size_t bench_gen_frames(char *buf, size_t size, int nframes)
+ * @description: 按客户端sendata()的格式生成一段接收缓冲区，每帧以'\n'结尾
+ * @param {char} *buf 缓冲区
+ * @param {size_t} size 缓冲区大小
+ * @param {int} nframes 帧数
+ * @return {size_t} 数据长度
+ */
+static size_t bench_gen_frames(char *buf, size_t size, int nframes)
+{
+    size_t      len = 0;
+    time_t      t   = 1767225600;
+    struct tm   tm;
+    int         i;
+
+    for (i = 0; i < nframes; i++, t += 4)
+    {
+        localtime_r(&t, &tm);
+        len += snprintf(buf + len, size - len, "RPI4B-%02d/%04d-%02d-%02d %02d:%02d:%02d/%f/%f\n", i % 16,
+                        tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                        -20.0 + (rand() % 6000) / 100.0, (rand() % 10000) / 100.0);
+    }
+
+    return len;
+}
+
+/**
+ * @name: static double bench_run(bench_parser_t parser, const char *src, size_t len, int nframes)
+ * @description: 重复解析整段缓冲区直到超过BENCH_MIN_MS，帧的切分与conn_next_frame()相同
+ *               strtok会修改缓冲区，每轮先复制一份，复制的开销对所有解析函数相同
+ * @param {bench_parser_t} parser 解析函数
+ * @param {char} *src 生成的接收缓冲区
+ * @param {size_t} len 数据长度
+ * @param {int} nframes 帧数
+ * @return {double} 每秒解析的帧数
+ */
+static double bench_run(bench_parser_t parser, const char *src, size_t len, int nframes)
+{
+    char           *buf     = malloc(len);
+    char           *frame;
+    char           *end;
+    packinfo_t      pack_info;
+    int64_t         start   = bench_now_ns();
+    int64_t         elapsed;
+    uint64_t        frames  = 0;
+    double          sum     = 0;
+
+    do
+    {
+        memcpy(buf, src, len);
+        for (frame = buf; (end = memchr(frame, '\n', buf + len - frame)) != NULL; frame = end + 1)
+        {
+            *end = '\0';
+            if (parser(frame, end - frame, &pack_info) == 0)
+            {
+                sum += pack_info.temp;
+            }
+            frames++;
+        }
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < BENCH_MIN_MS * 1000000LL);
+
+    free(buf);
+
+    // 防止编译器把解析结果优化掉
+    if (sum == 0.12345)
+    {
+        printf("%f\n", sum);
+    }
+
+    return frames * 1e9 / elapsed;
+}
+
+/**
+ * @name: static int bench_check(const char *src, size_t len)
+ * @description: 检查view解析结果与strtok_r + atof完全一致，并检查随机格式浮点数与(float)strtod()逐位一致
+ * @param {char} *src 生成的接收缓冲区
+ * @param {size_t} len 数据长度
+ * @return {int} 不一致的个数
+ */
+static int bench_check(const char *src, size_t len)
+{
+    static const char  *formats[] = { "%f", "%.2f", "%.1f", "%.9f", "%.17g", "%g", "%e" };
+    char               *buf     = malloc(len);
+    char               *frame;
+    char               *end;
+    char                num[64];
+    packinfo_t          a, b;
+    packinfo_view_t     view;
+    float               f;
+    int                 bad     = 0;
+    int                 n;
+    int                 i;
+
+    memcpy(buf, src, len);
+    for (frame = buf; (end = memchr(frame, '\n', buf + len - frame)) != NULL; frame = end + 1)
+    {
+        *end = '\0';
+        if ((parse_strtok_r(frame, end - frame, &a) < 0) || (packinfo_parse(frame, end - frame, &b) < 0)
+            || strcmp(a.devid, b.devid) || strcmp(a.time, b.time) || (a.ts != b.ts)
+            || memcmp(&a.temp, &b.temp, sizeof(float)) || memcmp(&a.humi, &b.humi, sizeof(float)))
+        {
+            printf("mismatch: %s\n", frame);
+            bad++;
+        }
+    }
+    free(buf);
+
+    for (i = 0; i < BENCH_CHECK_VALUES; i++)
+    {
+        n = snprintf(num, sizeof(num), "RPI4B/2026-01-01 00:00:00/");
+        n += snprintf(num + n, sizeof(num) - n, formats[i % 7], (rand() - RAND_MAX / 2) / (double)(1 << (rand() % 24)));
+        f = (float)strtod(strrchr(num, '/') + 1, NULL);
+        n += snprintf(num + n, sizeof(num) - n, "/0");
+        if ((packinfo_parse_view(num, n, &view) < 0) || memcmp(&f, &view.temp, sizeof(float)))
+        {
+            printf("mismatch: %s\n", num);
+            bad++;
+        }
+    }
+
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    static char     buf[BENCH_FRAMES * 80];
+    size_t          len;
+    double          legacy, reentrant, view;
+
+    logger_init("stdout", LOG_LEVEL_FATAL);
+    srand(1);
+    len = bench_gen_frames(buf, sizeof(buf), BENCH_FRAMES);
+
+    if (bench_check(buf, len) > 0)
+    {
+        printf("view parser disagrees with strtod\n");
+        return -1;
+    }
+
+    legacy    = bench_run(parse_legacy, buf, len, BENCH_FRAMES);
+    reentrant = bench_run(parse_strtok_r, buf, len, BENCH_FRAMES);
+    view      = bench_run(parse_view, buf, len, BENCH_FRAMES);
+
+    printf("frames: %d, %.1f bytes/frame\n", BENCH_FRAMES, (double)len / BENCH_FRAMES);
+    printf("legacy   (strtok/atof)              %12.0f frames/s\n", legacy);
+    printf("strtok_r (copy/atof/sscanf/mktime)  %12.0f frames/s\n", reentrant);
+    printf("view     (SIMD/fast float/cached)   %12.0f frames/s  %.1fx legacy, %.1fx strtok_r\n",
+           view, view / legacy, view / reentrant);
+
+    return 0;
+}
@@ -0,0 +1,841 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 19:40:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:49:23
+ * @Description: 旧版全文本表到时序表的在线迁移工具
+ *   多个读取线程按rowid分区并发读取、解析旧表(时间转换按小时缓存，见packinfo_parse_time)，单个写线程以大事务写入samples表
+ *   每个事务同时更新migrate_progress中对应分区的续传位置，中断后重新运行即可从断点继续
+ *   写入使用INSERT OR IGNORE，服务器可以同时在线写入新数据
+ *
+ *   编译: gcc -O2 -Iinc -I../server/inc src/sht20_migrate.c ../server/src/database.c
+ *         ../server/src/logger.c ../server/src/packinfo.c -o sht20_migrate -lsqlite3 -lpthread -lm
+ */
+
+#include "sht20_migrate.h"
+
+static volatile int g_sigstop = 0;      // 停止信号
+
+static inline void print_usage(char *progname);
+static void sig_stop(int signum);
+
+/**
+ * @name: static int64_t migrate_now_ms(void)
+ * @description: 获取单调时钟的毫秒数
+ * @return {int64_t} 毫秒数
+ */
+static int64_t migrate_now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @name: static int migrate_queue_init(migrate_queue_t *queue, int size, int producers)
+ * @description: 初始化批次队列
+ * @param {migrate_queue_t} *queue 批次队列
+ * @param {int} size 容量
+ * @param {int} producers 读取线程数
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int migrate_queue_init(migrate_queue_t *queue, int size, int producers)
+{
+    memset(queue, 0, sizeof(migrate_queue_t));
+    if ((queue->slots = calloc(size, sizeof(migrate_batch_t *))) == NULL)
+    {
+        log_error("migrate_queue_init calloc failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->size      = size;
+    queue->producers = producers;
+    return 0;
+}
+
+/**
+ * @name: static void migrate_queue_destroy(migrate_queue_t *queue)
+ * @description: 释放批次队列及队列中未写入的批次
+ * @param {migrate_queue_t} *queue 批次队列
+ * @return {*}
+ */
+static void migrate_queue_destroy(migrate_queue_t *queue)
+{
+    while (queue->count > 0)
+    {
+        free(queue->slots[queue->head]);
+        queue->head = (queue->head + 1) % queue->size;
+        queue->count--;
+    }
+
+    free(queue->slots);
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
+
+/**
+ * @name: static int migrate_queue_push(migrate_queue_t *queue, migrate_batch_t *batch)
+ * @description: 读取线程提交一个批次，队列满时等待写线程
+ * @param {migrate_queue_t} *queue 批次队列
+ * @param {migrate_batch_t} *batch 批次
+ * @return {int} 0为正常执行，-1为写线程已退出
+ */
+static int migrate_queue_push(migrate_queue_t *queue, migrate_batch_t *batch)
+{
+    pthread_mutex_lock(&queue->lock);
+    while ((queue->count == queue->size) && !queue->closed)
+    {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+
+    if (queue->closed)
+    {
+        pthread_mutex_unlock(&queue->lock);
+        return -1;
+    }
+
+    queue->slots[(queue->head + queue->count) % queue->size] = batch;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+}
+
+/**
+ * @name: static migrate_batch_t *migrate_queue_pop(migrate_queue_t *queue, int timeout, int *done)
+ * @description: 写线程取出一个批次，队列为空时最多等待timeout毫秒
+ * @param {migrate_queue_t} *queue 批次队列
+ * @param {int} timeout 等待超时(ms)
+ * @param {int} *done 队列为空且所有读取线程都已退出时置1
+ * @return {migrate_batch_t} 批次，超时返回NULL
+ */
+static migrate_batch_t *migrate_queue_pop(migrate_queue_t *queue, int timeout, int *done)
+{
+    migrate_batch_t    *batch = NULL;
+    struct timespec     deadline;
+
+    pthread_mutex_lock(&queue->lock);
+    if ((queue->count == 0) && (queue->producers > 0))
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec  += timeout / 1000;
+        deadline.tv_nsec += (timeout % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&queue->not_empty, &queue->lock, &deadline);
+    }
+
+    if (queue->count > 0)
+    {
+        batch = queue->slots[queue->head];
+        queue->head = (queue->head + 1) % queue->size;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+    }
+
+    *done = (queue->count == 0) && (queue->producers == 0);
+    pthread_mutex_unlock(&queue->lock);
+    return batch;
+}
+
+/**
+ * @name: static void migrate_queue_done(migrate_queue_t *queue)
+ * @description: 读取线程退出
+ * @param {migrate_queue_t} *queue 批次队列
+ * @return {*}
+ */
+static void migrate_queue_done(migrate_queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->producers--;
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @name: static void migrate_queue_close(migrate_queue_t *queue)
+ * @description: 停止接收新批次，唤醒等待入队的读取线程
+ * @param {migrate_queue_t} *queue 批次队列
+ * @return {*}
+ */
+static void migrate_queue_close(migrate_queue_t *queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @name: static int migrate_read_part(migrate_t *migrate, sqlite3_stmt *stmt, int idx)
+ * @description: 从续传位置开始按批读取并解析一个分区，每批送入队列
+ * @param {migrate_t} *migrate 迁移任务
+ * @param {sqlite3_stmt} *stmt 读取线程的查询语句
+ * @param {int} idx 分区下标
+ * @return {int} 0为正常执行，非0则出现错误或已停止
+ */
+static int migrate_read_part(migrate_t *migrate, sqlite3_stmt *stmt, int idx)
+{
+    migrate_part_t     *part    = &migrate->parts[idx];
+    migrate_batch_t    *batch;
+    packinfo_t         *row;
+    const char         *sn, *datime, *temp, *humi;
+    int64_t             from    = part->next;
+    int64_t             rowid   = 0;
+    int                 scanned;
+    int                 rv;
+
+    while ((from <= part->hi) && !g_sigstop)
+    {
+        batch = malloc(sizeof(migrate_batch_t) + migrate->batch_rows * sizeof(packinfo_t));
+        if (batch == NULL)
+        {
+            log_error("migrate_read_part malloc failure: %s\n", strerror(errno));
+            return -1;
+        }
+        batch->part  = idx;
+        batch->nrows = 0;
+        batch->bad   = 0;
+
+        sqlite3_bind_int64(stmt, 1, from);
+        sqlite3_bind_int64(stmt, 2, part->hi);
+        sqlite3_bind_int(stmt, 3, migrate->batch_rows);
+
+        scanned = 0;
+        while ((rv = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            scanned++;
+            rowid  = sqlite3_column_int64(stmt, 0);
+            sn     = (const char *)sqlite3_column_text(stmt, 1);
+            datime = (const char *)sqlite3_column_text(stmt, 2);
+            temp   = (const char *)sqlite3_column_text(stmt, 3);
+            humi   = (const char *)sqlite3_column_text(stmt, 4);
+            row    = &batch->rows[batch->nrows];
+
+            if (!sn || !datime || !temp || !humi || (strlen(sn) >= DEVID_LEN) || (strlen(datime) >= TIME_LEN)
+                || ((row->ts = packinfo_parse_time(datime, strlen(datime))) < 0))
+            {
+                batch->bad++;
+                continue;
+            }
+
+            strcpy(row->devid, sn);
+            strcpy(row->time, datime);
+            row->temp = atof(temp);
+            row->humi = atof(humi);
+            batch->nrows++;
+        }
+        sqlite3_reset(stmt);
+
+        if (rv != SQLITE_DONE)
+        {
+            log_error("migrate_read_part part[%d] select error:%s\n", idx, sqlite3_errstr(rv));
+            free(batch);
+            return -2;
+        }
+
+        // rowid有空洞时本分区剩余部分可能一行都没有
+        batch->next = scanned ? rowid + 1 : part->hi + 1;
+        from = batch->next;
+        if (migrate_queue_push(&migrate->queue, batch) < 0)
+        {
+            free(batch);
+            return -3;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static void *migrate_reader(void *arg)
+ * @description: 读取线程，使用独立的只读连接依次领取未完成的分区
+ * @param {void} *arg 迁移任务
+ * @return {*}
+ */
+static void *migrate_reader(void *arg)
+{
+    migrate_t          *migrate = (migrate_t *)arg;
+    sqlite3            *db      = NULL;
+    sqlite3_stmt       *stmt    = NULL;
+    char                sql[256];
+    int                 idx;
+
+    if (sqlite3_open_v2(migrate->dbpath, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+    {
+        log_error("migrate_reader open %s error:%s\n", migrate->dbpath, sqlite3_errmsg(db));
+    }
+    else
+    {
+        sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT);
+        snprintf(sql, sizeof(sql),
+                 "SELECT rowid, SN, DATIME, TEMP, HUMI FROM %s WHERE rowid >= ? AND rowid <= ? ORDER BY rowid LIMIT ?;",
+                 migrate->table);
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        {
+            log_error("migrate_reader prepare error:%s\n", sqlite3_errmsg(db));
+        }
+        else
+        {
+            while (!g_sigstop && ((idx = __atomic_fetch_add(&migrate->next_part, 1, __ATOMIC_RELAXED)) < migrate->nparts))
+            {
+                if ((migrate->parts[idx].next <= migrate->parts[idx].hi)
+                    && (migrate_read_part(migrate, stmt, idx) < 0))
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    migrate_queue_done(&migrate->queue);
+    return NULL;
+}
+
+/**
+ * @name: static int migrate_exec(sqlite3 *db, const char *sql)
+ * @description: 执行不需要返回结果的SQL，出错时记录日志
+ * @param {sqlite3} *db 数据库句柄
+ * @param {char} *sql SQL语句
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int migrate_exec(sqlite3 *db, const char *sql)
+{
+    char   *zErrMsg     = 0;
+
+    if (sqlite3_exec(db, sql, 0, 0, &zErrMsg) != SQLITE_OK)
+    {
+        log_error("Sqlite exec error:%s\n", zErrMsg);
+        sqlite3_free(zErrMsg);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static int64_t migrate_query_int(sqlite3 *db, const char *sql, int64_t dflt)
+ * @description: 执行返回单个整数的查询
+ * @param {sqlite3} *db 数据库句柄
+ * @param {char} *sql SQL语句
+ * @param {int64_t} dflt 没有结果或结果为NULL时的返回值
+ * @return {int64_t} 查询结果
+ */
+static int64_t migrate_query_int(sqlite3 *db, const char *sql, int64_t dflt)
+{
+    sqlite3_stmt   *stmt;
+    int64_t         value = dflt;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("Sqlite prepare error:%s\n", sqlite3_errmsg(db));
+        return dflt;
+    }
+
+    if ((sqlite3_step(stmt) == SQLITE_ROW) && (sqlite3_column_type(stmt, 0) != SQLITE_NULL))
+    {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    return value;
+}
+
+/**
+ * @name: static int migrate_create_parts(migrate_t *migrate)
+ * @description: 首次运行时按rowid范围把旧表均分为若干分区并写入进度表
+ * @param {migrate_t} *migrate 迁移任务
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int migrate_create_parts(migrate_t *migrate)
+{
+    char            sql[256];
+    sqlite3_stmt   *stmt;
+    int64_t         lo, hi, span, step;
+    int             i;
+
+    snprintf(sql, sizeof(sql), "SELECT min(rowid) FROM %s;", migrate->table);
+    lo = migrate_query_int(migrate->db, sql, 1);
+    snprintf(sql, sizeof(sql), "SELECT max(rowid) FROM %s;", migrate->table);
+    hi = migrate_query_int(migrate->db, sql, 0);
+    if (hi < lo)
+    {
+        migrate->nparts = 0;
+        return 0;
+    }
+
+    span = hi - lo + 1;
+    migrate->nparts = migrate->nthreads * MIGRATE_PARTS_PER_THREAD;
+    if (migrate->nparts > span)
+    {
+        migrate->nparts = span;
+    }
+    step = (span + migrate->nparts - 1) / migrate->nparts;
+    migrate->nparts = (span + step - 1) / step;
+
+    if ((migrate->parts = calloc(migrate->nparts, sizeof(migrate_part_t))) == NULL)
+    {
+        log_error("migrate_create_parts calloc failure: %s\n", strerror(errno));
+        return -1;
+    }
+
+    snprintf(sql, sizeof(sql), "INSERT INTO %s(part, lo, hi, next) VALUES (?, ?, ?, ?);", MIGRATE_PROGRESS_TABLE);
+    if (sqlite3_prepare_v2(migrate->db, sql, -1, &stmt, NULL) != SQLITE_OK)
+    {
+        log_error("migrate_create_parts prepare error:%s\n", sqlite3_errmsg(migrate->db));
+        return -2;
+    }
+
+    migrate_exec(migrate->db, "BEGIN IMMEDIATE;");
+    for (i = 0; i < migrate->nparts; i++)
+    {
+        migrate->parts[i].id   = i;
+        migrate->parts[i].lo   = lo + i * step;
+        migrate->parts[i].hi   = (i == migrate->nparts - 1) ? hi : lo + (i + 1) * step - 1;
+        migrate->parts[i].next = migrate->parts[i].lo;
+
+        sqlite3_bind_int(stmt, 1, i);
+        sqlite3_bind_int64(stmt, 2, migrate->parts[i].lo);
+        sqlite3_bind_int64(stmt, 3, migrate->parts[i].hi);
+        sqlite3_bind_int64(stmt, 4, migrate->parts[i].next);
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+        {
+            log_error("migrate_create_parts insert error:%s\n", sqlite3_errmsg(migrate->db));
+            sqlite3_finalize(stmt);
+            migrate_exec(migrate->db, "ROLLBACK;");
+            return -3;
+        }
+        sqlite3_reset(stmt);
+    }
+    sqlite3_finalize(stmt);
+
+    if (migrate_exec(migrate->db, "COMMIT;") < 0)
+    {
+        migrate_exec(migrate->db, "ROLLBACK;");
+        return -4;
+    }
+
+    log_info("migrate: rowid %lld..%lld split into %d partitions\n", (long long)lo, (long long)hi, migrate->nparts);
+    return 0;
+}
+
+/**
+ * @name: static int migrate_load_parts(migrate_t *migrate)
+ * @description: 读取进度表中的分区，进度表为空时新建分区，并预编译进度更新语句
+ * @param {migrate_t} *migrate 迁移任务
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int migrate_load_parts(migrate_t *migrate)
+{
+    char            sql[256];
+    sqlite3_stmt   *stmt;
+    int             i;
+
+    snprintf(sql, sizeof(sql),
+             "CREATE TABLE IF NOT EXISTS %s(part INTEGER PRIMARY KEY, lo INTEGER NOT NULL,"
+             " hi INTEGER NOT NULL, next INTEGER NOT NULL);", MIGRATE_PROGRESS_TABLE);
+    if (migrate_exec(migrate->db, sql) < 0)
+    {
+        return -1;
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s;", MIGRATE_PROGRESS_TABLE);
+    migrate->nparts = migrate_query_int(migrate->db, sql, 0);
+    if (migrate->nparts == 0)
+    {
+        if (migrate_create_parts(migrate) < 0)
+        {
+            return -2;
+        }
+    }
+    else
+    {
+        if ((migrate->parts = calloc(migrate->nparts, sizeof(migrate_part_t))) == NULL)
+        {
+            log_error("migrate_load_parts calloc failure: %s\n", strerror(errno));
+            return -3;
+        }
+
+        snprintf(sql, sizeof(sql), "SELECT part, lo, hi, next FROM %s ORDER BY part;", MIGRATE_PROGRESS_TABLE);
+        if (sqlite3_prepare_v2(migrate->db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        {
+            log_error("migrate_load_parts prepare error:%s\n", sqlite3_errmsg(migrate->db));
+            return -4;
+        }
+
+        for (i = 0; (i < migrate->nparts) && (sqlite3_step(stmt) == SQLITE_ROW); i++)
+        {
+            migrate->parts[i].id   = sqlite3_column_int(stmt, 0);
+            migrate->parts[i].lo   = sqlite3_column_int64(stmt, 1);
+            migrate->parts[i].hi   = sqlite3_column_int64(stmt, 2);
+            migrate->parts[i].next = sqlite3_column_int64(stmt, 3);
+        }
+        sqlite3_finalize(stmt);
+
+        log_info("migrate: resume %d partitions from %s\n", migrate->nparts, MIGRATE_PROGRESS_TABLE);
+    }
+
+    snprintf(sql, sizeof(sql), "UPDATE %s SET next = ? WHERE part = ?;", MIGRATE_PROGRESS_TABLE);
+    if (sqlite3_prepare_v2(migrate->db, sql, -1, &migrate->progress, NULL) != SQLITE_OK)
+    {
+        log_error("migrate_load_parts prepare error:%s\n", sqlite3_errmsg(migrate->db));
+        return -5;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static void migrate_rollback(migrate_t *migrate)
+ * @description: 回滚写线程当前的事务
+ * @param {migrate_t} *migrate 迁移任务
+ * @return {*}
+ */
+static void migrate_rollback(migrate_t *migrate)
+{
+    if (migrate->batch.pending > 0)
+    {
+        sqlite3_exec(migrate->db, "ROLLBACK;", 0, 0, 0);
+        migrate->batch.pending = 0;
+
+        // 回滚后本事务中新建的设备id失效
+        memset(migrate->batch.devices, 0, DB_DEVICE_CACHE_SIZE * sizeof(db_device_t));
+    }
+}
+
+/**
+ * @name: static int migrate_write_batch(migrate_t *migrate, migrate_batch_t *batch)
+ * @description: 在一个事务中写入一批行并更新所属分区的续传位置
+ * @param {migrate_t} *migrate 迁移任务
+ * @param {migrate_batch_t} *batch 批次
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int migrate_write_batch(migrate_t *migrate, migrate_batch_t *batch)
+{
+    int     rv;
+    int     i;
+
+    for (i = 0; i < batch->nrows; i++)
+    {
+        if (database_batch_insert(&migrate->batch, &batch->rows[i]) < 0)
+        {
+            migrate_rollback(migrate);
+            return -1;
+        }
+    }
+
+    // 整批都是坏行时没有开启事务，进度更新自动提交
+    sqlite3_bind_int64(migrate->progress, 1, batch->next);
+    sqlite3_bind_int(migrate->progress, 2, migrate->parts[batch->part].id);
+    rv = sqlite3_step(migrate->progress);
+    sqlite3_reset(migrate->progress);
+    if (rv != SQLITE_DONE)
+    {
+        log_error("migrate_write_batch update progress error:%s\n", sqlite3_errstr(rv));
+        migrate_rollback(migrate);
+        return -2;
+    }
+
+    if (database_batch_commit(&migrate->batch) < 0)
+    {
+        return -3;
+    }
+
+    migrate->parts[batch->part].next = batch->next;
+    migrate->rows += batch->nrows;
+    migrate->bad  += batch->bad;
+    migrate->batches++;
+    return 0;
+}
+
+/**
+ * @name: static int migrate_finish(migrate_t *migrate)
+ * @description: 所有分区完成后删除旧表和进度表
+ * @param {migrate_t} *migrate 迁移任务
+ * @return {int} 0为正常执行，1为还有未完成的分区，负数则出现错误
+ */
+static int migrate_finish(migrate_t *migrate)
+{
+    char    sql[256];
+    int     i;
+
+    for (i = 0; i < migrate->nparts; i++)
+    {
+        if (migrate->parts[i].next <= migrate->parts[i].hi)
+        {
+            return 1;
+        }
+    }
+
+    sqlite3_finalize(migrate->progress);
+    migrate->progress = NULL;
+
+    snprintf(sql, sizeof(sql), "BEGIN IMMEDIATE; DROP TABLE %s; DROP TABLE %s; COMMIT;",
+             migrate->table, MIGRATE_PROGRESS_TABLE);
+    if (migrate_exec(migrate->db, sql) < 0)
+    {
+        migrate_exec(migrate->db, "ROLLBACK;");
+        return -1;
+    }
+
+    log_info("migrate: dropped %s and %s\n", migrate->table, MIGRATE_PROGRESS_TABLE);
+    return 0;
+}
+
+/**
+ * @name: static void migrate_report(migrate_t *migrate, int64_t elapsed, uint64_t rows, int64_t interval)
+ * @description: 打印迁移进度和速度
+ * @param {migrate_t} *migrate 迁移任务
+ * @param {int64_t} elapsed 开始迁移以来的毫秒数
+ * @param {uint64_t} rows 本时间段内提交的行数
+ * @param {int64_t} interval 时间段长度(ms)
+ * @return {*}
+ */
+static void migrate_report(migrate_t *migrate, int64_t elapsed, uint64_t rows, int64_t interval)
+{
+    int64_t     total   = 0;
+    int64_t     done    = 0;
+    int         i;
+
+    for (i = 0; i < migrate->nparts; i++)
+    {
+        total += migrate->parts[i].hi - migrate->parts[i].lo + 1;
+        done  += (migrate->parts[i].next > migrate->parts[i].hi ? migrate->parts[i].hi + 1 : migrate->parts[i].next)
+                 - migrate->parts[i].lo;
+    }
+
+    printf("migrate: %llu rows (%.1f%%) %llu skipped, %.0f rows/s now, %.0f rows/s avg, %.1fs\n",
+           (unsigned long long)migrate->rows, total ? 100.0 * done / total : 100.0,
+           (unsigned long long)migrate->bad,
+           interval > 0 ? rows * 1000.0 / interval : 0.0,
+           elapsed > 0 ? migrate->rows * 1000.0 / elapsed : 0.0,
+           elapsed / 1000.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    static migrate_t    migrate;                                    // 迁移任务
+    pthread_t           tids[MIGRATE_MAX_THREADS];                  // 读取线程
+    migrate_batch_t    *batch;
+    db_profile_t        profile;                                    // 解析后的存储配置
+    char                dbname[128];                                // 不带.db后缀的数据库名
+    char                sql[256];
+    char               *progname        = argv[0];                  // 程序名
+    char               *db_opt          = MIGRATE_DATABASE;         // 数据库名
+    char               *storage_opt     = MIGRATE_PROFILE;          // 存储配置
+    int64_t             start_ms;                                   // 开始时间
+    int64_t             last_ms;                                    // 上一次打印的时间
+    uint64_t            last_rows       = 0;                        // 上一次打印时的行数
+    int                 started         = 0;                        // 已启动的读取线程数
+    int                 failed          = 0;                        // 写入出错
+    int                 done            = 0;                        // 所有批次都已写入
+    int                 opt;
+    int                 rv              = 0;
+    int                 i;
+
+    struct option long_option[] =
+        {
+            {"database", required_argument, NULL, 'd'},
+            {"table", required_argument, NULL, 't'},
+            {"threads", required_argument, NULL, 'j'},
+            {"batch", required_argument, NULL, 'B'},
+            {"storage", required_argument, NULL, 'S'},
+            {"help", no_argument, NULL, 'h'},
+            {0, 0, 0, 0}};
+
+    migrate.table      = MIGRATE_LEGACY_TABLE;
+    migrate.batch_rows = MIGRATE_BATCH_ROWS;
+    migrate.nthreads   = sysconf(_SC_NPROCESSORS_ONLN);
+    if (migrate.nthreads > MIGRATE_MAX_THREADS)
+    {
+        migrate.nthreads = MIGRATE_MAX_THREADS;
+    }
+
+    while ((opt = getopt_long(argc, argv, "d:t:j:B:S:h", long_option, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            db_opt = optarg;
+            break;
+        case 't':
+            migrate.table = optarg;
+            break;
+        case 'j':
+            migrate.nthreads = atoi(optarg);
+            break;
+        case 'B':
+            migrate.batch_rows = atoi(optarg);
+            break;
+        case 'S':
+            storage_opt = optarg;
+            break;
+        case 'h':
+            print_usage(progname);
+            return EXIT_SUCCESS;
+        default:
+            break;
+        }
+    }
+
+    if (logger_init("stdout", LOG_LEVEL_INFO) < 0)
+    {
+        fprintf(stderr, "initial logger system failure\n");
+        return -1;
+    }
+
+    // 数据库名可以带.db后缀，database_init()会自动加上
+    snprintf(dbname, sizeof(dbname), "%s", db_opt);
+    if ((strlen(dbname) > 3) && !strcmp(dbname + strlen(dbname) - 3, ".db"))
+    {
+        dbname[strlen(dbname) - 3] = '\0';
+    }
+    snprintf(migrate.dbpath, sizeof(migrate.dbpath), "%s.db", dbname);
+
+    if ((migrate.nthreads < 1) || (migrate.nthreads > MIGRATE_MAX_THREADS) || (migrate.batch_rows < 1)
+        || (database_profile_parse(storage_opt, &profile) < 0) || (access(migrate.dbpath, F_OK) < 0))
+    {
+        print_usage(progname);
+        return -2;
+    }
+
+    signal(SIGINT, sig_stop);
+    signal(SIGTERM, sig_stop);
+
+    if (database_init(dbname, &migrate.db, &profile) < 0)
+    {
+        return -3;
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM sqlite_master WHERE type='table' AND name='%s';", migrate.table);
+    if (migrate_query_int(migrate.db, sql, 0) == 0)
+    {
+        log_info("migrate: no legacy table %s in %s, nothing to do\n", migrate.table, migrate.dbpath);
+        database_close(dbname, &migrate.db);
+        return 0;
+    }
+
+    // 行数和时间都不触发自动提交，每批只在更新续传位置后由migrate_write_batch()提交一次
+    if ((database_schema_init(NULL, &migrate.db) < 0)
+        || (database_batch_init(DB_SAMPLE_TABLE, &migrate.db, &migrate.batch, INT_MAX, INT_MAX) < 0)
+        || (migrate_load_parts(&migrate) < 0)
+        || (migrate_queue_init(&migrate.queue, migrate.nthreads * 2, migrate.nthreads) < 0))
+    {
+        database_batch_close(&migrate.batch);
+        database_close(dbname, &migrate.db);
+        return -4;
+    }
+
+    for (i = 0; i < migrate.nthreads; i++)
+    {
+        if (pthread_create(&tids[i], NULL, migrate_reader, &migrate) != 0)
+        {
+            log_error("Create reader thread failure: %s\n", strerror(errno));
+            migrate_queue_done(&migrate.queue);
+            continue;
+        }
+        started++;
+    }
+
+    // 主线程作为唯一的写线程
+    start_ms = last_ms = migrate_now_ms();
+    while (!done)
+    {
+        if (g_sigstop && !migrate.queue.closed)
+        {
+            migrate_queue_close(&migrate.queue);
+        }
+
+        if ((batch = migrate_queue_pop(&migrate.queue, MIGRATE_REPORT_MS / 5, &done)) != NULL)
+        {
+            if (!failed && (migrate_write_batch(&migrate, batch) < 0))
+            {
+                failed    = 1;
+                g_sigstop = 1;
+            }
+            free(batch);
+        }
+
+        if (migrate_now_ms() - last_ms >= MIGRATE_REPORT_MS)
+        {
+            migrate_report(&migrate, migrate_now_ms() - start_ms, migrate.rows - last_rows, migrate_now_ms() - last_ms);
+            last_rows = migrate.rows;
+            last_ms   = migrate_now_ms();
+        }
+    }
+
+    for (i = 0; i < started; i++)
+    {
+        pthread_join(tids[i], NULL);
+    }
+    migrate_report(&migrate, migrate_now_ms() - start_ms, migrate.rows - last_rows, migrate_now_ms() - last_ms);
+
+    if (failed)
+    {
+        log_error("migrate: write failure, rerun to resume from the last committed batch\n");
+        rv = -5;
+    }
+    else if (g_sigstop)
+    {
+        log_info("migrate: interrupted, rerun to resume from the last committed batch\n");
+    }
+    else if ((rv = migrate_finish(&migrate)) > 0)
+    {
+        log_error("migrate: some partitions did not finish, rerun to resume\n");
+        rv = -6;
+    }
+
+    sqlite3_finalize(migrate.progress);
+    database_batch_close(&migrate.batch);
+    migrate_queue_destroy(&migrate.queue);
+    free(migrate.parts);
+    database_close(dbname, &migrate.db);
+
+    return rv;
+}
+
+/**
+ * @name: static inline void print_usage(char *progname)
+ * @description: 打印帮助信息
+ * @param {char} *progname 程序名
+ * @return {*}
+ */
+static inline void print_usage(char *progname)
+{
+    printf("Usage: %s [OPTION] ...\n", progname);
+
+    printf(" %s moves rows of the legacy text table into the typed samples table, online and resumable\n", progname);
+    printf("\nMandatory arguments to long options are mandatory for short option too:\n");
+
+    printf(" -d[database] Database file, with or without .db (default %s)\n", MIGRATE_DATABASE);
+    printf(" -t[table   ] Legacy table name (default %s)\n", MIGRATE_LEGACY_TABLE);
+    printf(" -j[threads ] Reader/parser threads, at most %d (default: online cpus)\n", MIGRATE_MAX_THREADS);
+    printf(" -B[batch   ] Rows per batch and per write transaction (default %d)\n", MIGRATE_BATCH_ROWS);
+    printf(" -S[storage ] Storage profile durable|throughput[,key=value...] (default %s)\n", MIGRATE_PROFILE);
+    printf(" -h[help    ] Display this help information\n");
+
+    printf("\nExample: %s -d sht20.db -j 4\n", progname);
+    return;
+}
+
+/**
+ * @name: static void sig_stop(int signum)
+ * @description: 收到SIGINT/SIGTERM后停止读取，已读取的批次写完后退出
+ * @param {int} signum 信号
+ * @return {*}
+ */
+static void sig_stop(int signum)
+{
+    g_sigstop = 1;
+}
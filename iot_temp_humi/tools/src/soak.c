@@ -0,0 +1,397 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 22:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 20:12:14
+ * @Description: 客户端和服务器的长时间运行测试
+ *   在运行目录下分别启动服务器和使用模拟传感器的客户端，按报告间隔输出两个进程的RSS、打开的描述符数、
+ *   服务器已入库的记录数和该间隔内每条记录的堆分配次数，同时写入运行目录下的soak.csv
+ *   堆分配次数由LD_PRELOAD的libsoak_alloc.so统计，结束时给出预热之后的RSS增长速度
+ *
+ *   客户端默认使用模拟传感器(-D sim)，--之后的客户端选项可以覆盖
+ *
+ *   编译: gcc -O2 -Iinc src/soak.c -o soak -lsqlite3
+ *         gcc -O2 -Iinc -shared -fPIC src/soak_alloc.c -o libsoak_alloc.so
+ *   运行: ./soak -s ../server/server -c ../client/client -a ./libsoak_alloc.so -t 8 -- -M 64 -D sim,fail=0.001
+ */
+
+#include <sqlite3.h>
+#include "soak.h"
+
+static volatile int g_sigstop = 0;      // 停止信号
+
+static inline void print_usage(char *progname);
+static void sig_stop(int signum);
+
+/**
+ * @name: static double soak_now_s(void)
+ * @description: 获取单调时钟的秒数
+ * @return {double} 秒数
+ */
+static double soak_now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @name: static int soak_mkdirs(const char *dir)
+ * @description: 创建进程的工作目录和其中的logger目录
+ * @param {char} *dir 工作目录
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int soak_mkdirs(const char *dir)
+{
+    char            path[340];
+
+    snprintf(path, sizeof(path), "%s/logger", dir);
+    if (((mkdir(dir, 0755) < 0) && (errno != EEXIST)) || ((mkdir(path, 0755) < 0) && (errno != EEXIST)))
+    {
+        printf("mkdir %s failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static int soak_spawn(soak_proc_t *proc, const char *alloc_lib, char **argv)
+ * @description: 在proc->dir中启动被测进程，预加载分配计数库
+ * @param {soak_proc_t} *proc 被测进程
+ * @param {char} *alloc_lib libsoak_alloc.so的绝对路径，NULL为不统计分配
+ * @param {char} **argv 命令行，argv[0]为可执行文件的绝对路径
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int soak_spawn(soak_proc_t *proc, const char *alloc_lib, char **argv)
+{
+    if ((proc->pid = fork()) < 0)
+    {
+        printf("fork %s failed: %s\n", proc->role, strerror(errno));
+        return -1;
+    }
+
+    if (proc->pid == 0)
+    {
+        if (chdir(proc->dir) < 0)
+        {
+            _exit(127);
+        }
+        if (alloc_lib)
+        {
+            setenv("LD_PRELOAD", alloc_lib, 1);
+            setenv(SOAK_ALLOC_ENV, proc->alloc_path, 1);
+        }
+        freopen("/dev/null", "w", stdout);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static int soak_sample(soak_proc_t *proc)
+ * @description: 读取进程的RSS、描述符数和分配计数
+ * @param {soak_proc_t} *proc 被测进程
+ * @return {int} 0为正常执行，非0则进程已退出
+ */
+static int soak_sample(soak_proc_t *proc)
+{
+    char            path[64];
+    char            line[128];
+    FILE           *fp;
+    DIR            *dirp;
+    struct dirent  *entry;
+    int             fd;
+
+    snprintf(path, sizeof(path), "/proc/%d/status", proc->pid);
+    if ((fp = fopen(path, "r")) == NULL)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "VmRSS: %ld", &proc->rss_kb) == 1)
+        {
+            break;
+        }
+    }
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "/proc/%d/fd", proc->pid);
+    if ((dirp = opendir(path)) == NULL)
+    {
+        return -2;
+    }
+    for (proc->fds = 0; (entry = readdir(dirp)) != NULL; )
+    {
+        if (entry->d_name[0] != '.')
+        {
+            proc->fds++;
+        }
+    }
+    closedir(dirp);
+
+    proc->alloc_last = proc->alloc;
+    if ((fd = open(proc->alloc_path, O_RDONLY)) >= 0)
+    {
+        if (pread(fd, &proc->alloc, sizeof(proc->alloc), 0) != sizeof(proc->alloc))
+        {
+            memset(&proc->alloc, 0, sizeof(proc->alloc));
+        }
+        close(fd);
+    }
+
+    return 0;
+}
+
+/**
+ * @name: static long long soak_records(const char *dir)
+ * @description: 只读打开服务器数据库，统计已入库的记录数
+ * @param {char} *dir 服务器工作目录
+ * @return {long long} 记录数，负数则出现错误
+ */
+static long long soak_records(const char *dir)
+{
+    char            path[340];
+    sqlite3        *db      = NULL;
+    sqlite3_stmt   *stmt    = NULL;
+    long long       records = -1;
+
+    snprintf(path, sizeof(path), "%s/sht20.db", dir);
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK)
+    {
+        sqlite3_busy_timeout(db, 1000);
+        if ((sqlite3_prepare_v2(db, "SELECT count(*) FROM samples;", -1, &stmt, NULL) == SQLITE_OK)
+            && (sqlite3_step(stmt) == SQLITE_ROW))
+        {
+            records = sqlite3_column_int64(stmt, 0);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+
+    return records;
+}
+
+/**
+ * @name: static double soak_per_record(soak_proc_t *proc, long long records)
+ * @description: 本报告间隔内每条记录的堆分配次数
+ * @param {soak_proc_t} *proc 被测进程
+ * @param {long long} records 本间隔内入库的记录数
+ * @return {double} 分配次数，没有新记录时为0
+ */
+static double soak_per_record(soak_proc_t *proc, long long records)
+{
+    if (records <= 0)
+    {
+        return 0;
+    }
+
+    return (double)(proc->alloc.allocs - proc->alloc_last.allocs) / records;
+}
+
+int main(int argc, char **argv)
+{
+    soak_proc_t     procs[2];
+    soak_proc_t    *server = &procs[0];
+    soak_proc_t    *client = &procs[1];
+    char           *server_bin = NULL;
+    char           *client_bin = NULL;
+    char           *alloc_lib  = NULL;
+    char           *dir        = SOAK_DIR;
+    char            run_dir[256];
+    char            port[16];
+    char           *server_argv[8];
+    char           *client_argv[64];
+    double          hours      = SOAK_HOURS;
+    int             report_s   = SOAK_REPORT_S;
+    int             opt;
+    int             nargs;
+    int             i;
+    double          start, elapsed = 0;
+    long long       records, records_last = 0;
+    FILE           *csv;
+    int             rv = 0;
+
+    snprintf(port, sizeof(port), "%d", SOAK_PORT);
+    while ((opt = getopt(argc, argv, "s:c:a:p:t:i:d:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            server_bin = realpath(optarg, NULL);
+            break;
+        case 'c':
+            client_bin = realpath(optarg, NULL);
+            break;
+        case 'a':
+            alloc_lib = realpath(optarg, NULL);
+            break;
+        case 'p':
+            snprintf(port, sizeof(port), "%s", optarg);
+            break;
+        case 't':
+            hours = atof(optarg);
+            break;
+        case 'i':
+            report_s = atoi(optarg);
+            break;
+        case 'd':
+            dir = optarg;
+            break;
+        default:
+            print_usage(argv[0]);
+            return 0;
+        }
+    }
+
+    if (!server_bin || !client_bin || (hours <= 0) || (report_s < 1) || (soak_mkdirs(dir) < 0)
+        || (realpath(dir, run_dir) == NULL))
+    {
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    memset(procs, 0, sizeof(procs));
+    server->role = "server";
+    client->role = "client";
+    for (i = 0; i < 2; i++)
+    {
+        snprintf(procs[i].dir, sizeof(procs[i].dir), "%s/%s", run_dir, procs[i].role);
+        snprintf(procs[i].alloc_path, sizeof(procs[i].alloc_path), "%s/%s.alloc", run_dir, procs[i].role);
+        if (soak_mkdirs(procs[i].dir) < 0)
+        {
+            return -2;
+        }
+    }
+
+    // 客户端的额外参数放在--之后
+    nargs = 0;
+    client_argv[nargs++] = client_bin;
+    client_argv[nargs++] = "-i";
+    client_argv[nargs++] = "127.0.0.1";
+    client_argv[nargs++] = "-p";
+    client_argv[nargs++] = port;
+    client_argv[nargs++] = "-D";
+    client_argv[nargs++] = "sim";
+    for (i = optind; (i < argc) && (nargs < sizeof(client_argv) / sizeof(client_argv[0]) - 1); i++)
+    {
+        client_argv[nargs++] = argv[i];
+    }
+    client_argv[nargs] = NULL;
+
+    server_argv[0] = server_bin;
+    server_argv[1] = "-p";
+    server_argv[2] = port;
+    server_argv[3] = NULL;
+
+    signal(SIGINT, sig_stop);
+    signal(SIGTERM, sig_stop);
+
+    snprintf(run_dir + strlen(run_dir), sizeof(run_dir) - strlen(run_dir), "/soak.csv");
+    if ((csv = fopen(run_dir, "w")) == NULL)
+    {
+        printf("open %s failed: %s\n", run_dir, strerror(errno));
+        return -3;
+    }
+    fprintf(csv, "elapsed_s,records,server_rss_kb,server_fds,server_allocs_per_record,"
+                 "client_rss_kb,client_fds,client_allocs_per_record\n");
+
+    if ((soak_spawn(server, alloc_lib, server_argv) < 0) || (sleep(1), soak_spawn(client, alloc_lib, client_argv) < 0))
+    {
+        g_sigstop = 1;
+        rv = -4;
+    }
+
+    printf("%8s %9s | %10s %5s %12s | %10s %5s %12s\n", "elapsed", "records",
+           "server_rss", "fds", "allocs/rec", "client_rss", "fds", "allocs/rec");
+    start = soak_now_s();
+    while (!g_sigstop && (elapsed < hours * 3600))
+    {
+        sleep(report_s);
+        elapsed = soak_now_s() - start;
+
+        if ((waitpid(server->pid, NULL, WNOHANG) != 0) || (waitpid(client->pid, NULL, WNOHANG) != 0)
+            || (soak_sample(server) < 0) || (soak_sample(client) < 0))
+        {
+            printf("%s exited after %.0f s\n", kill(server->pid, 0) ? "server" : "client", elapsed);
+            rv = -5;
+            break;
+        }
+
+        records = soak_records(server->dir);
+        for (i = 0; i < 2; i++)
+        {
+            if ((elapsed >= SOAK_WARMUP_S) && (procs[i].rss_base_kb == 0))
+            {
+                procs[i].rss_base_kb = procs[i].rss_kb;
+            }
+        }
+
+        printf("%7.0fs %9lld | %8ldkB %5d %12.1f | %8ldkB %5d %12.1f\n", elapsed, records,
+               server->rss_kb, server->fds, soak_per_record(server, records - records_last),
+               client->rss_kb, client->fds, soak_per_record(client, records - records_last));
+        fprintf(csv, "%.0f,%lld,%ld,%d,%.2f,%ld,%d,%.2f\n", elapsed, records,
+                server->rss_kb, server->fds, soak_per_record(server, records - records_last),
+                client->rss_kb, client->fds, soak_per_record(client, records - records_last));
+        fflush(stdout);
+        fflush(csv);
+        records_last = records;
+    }
+    fclose(csv);
+
+    for (i = 0; i < 2; i++)
+    {
+        if (procs[i].pid > 0)
+        {
+            kill(procs[i].pid, SIGTERM);
+            waitpid(procs[i].pid, NULL, 0);
+        }
+    }
+
+    // 预热之后RSS应当持平，持续增长说明有泄漏
+    for (i = 0; (i < 2) && (elapsed > SOAK_WARMUP_S); i++)
+    {
+        if (procs[i].rss_base_kb > 0)
+        {
+            printf("%s: RSS %ld kB -> %ld kB, %+.1f kB/hour after warmup, %llu allocs %llu frees\n", procs[i].role,
+                   procs[i].rss_base_kb, procs[i].rss_kb,
+                   (procs[i].rss_kb - procs[i].rss_base_kb) * 3600.0 / (elapsed - SOAK_WARMUP_S),
+                   (unsigned long long)procs[i].alloc.allocs, (unsigned long long)procs[i].alloc.frees);
+        }
+    }
+
+    return rv;
+}
+
+/**
+ * @name: static inline void print_usage(char *progname)
+ * @description: 打印帮助信息
+ * @param {char} *progname 程序名称
+ * @return {*}
+ */
+static inline void print_usage(char *progname)
+{
+    printf("Usage: %s -s SERVER -c CLIENT [OPTION] ... [-- CLIENT_OPTION ...]\n", progname);
+    printf(" -s[server ] Server binary\n");
+    printf(" -c[client ] Client binary, run with the simulated sensor unless -D is given after --\n");
+    printf(" -a[alloc  ] libsoak_alloc.so, count heap allocations of both processes\n");
+    printf(" -p[port   ] Port (default %d)\n", SOAK_PORT);
+    printf(" -t[hours  ] Run time in hours (default %.0f)\n", SOAK_HOURS);
+    printf(" -i[report ] Report interval in seconds (default %d)\n", SOAK_REPORT_S);
+    printf(" -d[dir    ] Run directory (default %s)\n", SOAK_DIR);
+}
+
+/**
+ * @name: static void sig_stop(int signum)
+ * @description: 停止信号处理函数
+ * @param {int} signum 信号
+ * @return {*}
+ */
+static void sig_stop(int signum)
+{
+    g_sigstop = 1;
+}
@@ -0,0 +1,87 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 22:20:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 22:20:00
+ * @Description: 通过LD_PRELOAD统计进程的堆分配次数，计数放在SOAK_ALLOC_FILE指向的共享文件中，由soak读取
+ *   只适用于glibc，直接转发到__libc_malloc等，不需要dlsym
+ *
+ *   编译: gcc -O2 -Iinc -shared -fPIC src/soak_alloc.c -o libsoak_alloc.so
+ */
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "soak.h"
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+
+static soak_alloc_t *g_counters = NULL;    // 共享计数，构造函数执行前的分配不计
+
+/**
+ * @name: static void soak_alloc_init(void)
+ * @description: 映射计数文件
+ * @return {*}
+ */
+__attribute__((constructor)) static void soak_alloc_init(void)
+{
+    const char     *path = getenv(SOAK_ALLOC_ENV);
+    void           *addr;
+    int             fd;
+
+    if ((path == NULL) || ((fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0))
+    {
+        return;
+    }
+
+    if ((ftruncate(fd, sizeof(soak_alloc_t)) == 0)
+        && ((addr = mmap(NULL, sizeof(soak_alloc_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) != MAP_FAILED))
+    {
+        g_counters = addr;
+    }
+    close(fd);
+}
+
+void *malloc(size_t size)
+{
+    if (g_counters)
+    {
+        __atomic_fetch_add(&g_counters->allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_counters->bytes, size, __ATOMIC_RELAXED);
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    if (g_counters)
+    {
+        __atomic_fetch_add(&g_counters->allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_counters->bytes, nmemb * size, __ATOMIC_RELAXED);
+    }
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (g_counters)
+    {
+        __atomic_fetch_add(&g_counters->allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&g_counters->bytes, size, __ATOMIC_RELAXED);
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (g_counters && ptr)
+    {
+        __atomic_fetch_add(&g_counters->frees, 1, __ATOMIC_RELAXED);
+    }
+    __libc_free(ptr);
+}
@@ -0,0 +1,216 @@
+/*
+ * @Author: RoxyKko
+ * @Date: 2026-10-17 21:50:00
+ * @LastEditors: RoxyKko
+ * @LastEditTime: 2026-10-17 21:50:00
+ * @Description: 客户端溢出缓存后端基准，比较SQLite和内存映射文件
+ *   每个用例先追加ROWS条记录(断网时的采样)，关闭后重新打开，按客户端的方式每次读回128条并删除(恢复后的补发)
+ *   写入量取自/proc/self/io的write_bytes，是本进程提交给块设备的字节数，需要在目标存储(SD卡)所在目录运行
+ *   tmpfs等不经过块设备的文件系统上write_bytes为0
+ *
+ *   编译: gcc -O2 -Iinc -I../client/inc src/spool_bench.c ../client/src/spool.c ../client/src/mmap_spool.c
+ *         ../client/src/database.c ../client/src/proto.c ../client/src/logger.c ../client/src/get_time.c
+ *         -o spool_bench -lsqlite3 -lm
+ *   运行: ./spool_bench [目录] [ROWS]
+ */
+
+#include "spool_bench.h"
+
+static const bench_case_t cases[] = {
+    { "sqlite",     "durable",      1  },
+    { "sqlite",     "durable",      64 },
+    { "sqlite",     "throughput",   64 },
+    { "mmap",       "durable",      1  },
+    { "mmap",       "durable",      64 },
+};
+
+/**
+ * @name: static int64_t bench_now_ns(void)
+ * @description: 获取单调时钟的纳秒数
+ * @return {int64_t} 纳秒数
+ */
+static int64_t bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @name: static long long bench_write_bytes(void)
+ * @description: 读取本进程提交给块设备的写入字节数
+ * @return {long long} 字节数，无法读取时返回-1
+ */
+static long long bench_write_bytes(void)
+{
+    FILE           *fp;
+    char            line[128];
+    long long       bytes = -1;
+
+    if ((fp = fopen("/proc/self/io", "r")) == NULL)
+    {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        if (sscanf(line, "write_bytes: %lld", &bytes) == 1)
+        {
+            break;
+        }
+    }
+    fclose(fp);
+
+    return bytes;
+}
+
+/**
+ * @name: static void bench_remove(void)
+ * @description: 删除上一个用例留下的文件
+ * @return {*}
+ */
+static void bench_remove(void)
+{
+    unlink(BENCH_NAME ".db");
+    unlink(BENCH_NAME ".db-wal");
+    unlink(BENCH_NAME ".db-shm");
+    unlink(BENCH_NAME ".spool");
+}
+
+/**
+ * @name: static int bench_open(spool_t *spool, const bench_case_t *bc)
+ * @description: 按用例打开溢出缓存
+ * @param {spool_t} *spool 溢出缓存
+ * @param {bench_case_t} *bc 用例
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int bench_open(spool_t *spool, const bench_case_t *bc)
+{
+    db_profile_t    profile;
+
+    if (database_profile_parse(bc->profile, &profile) < 0)
+    {
+        return -1;
+    }
+
+    return spool_open(spool, bc->spool, BENCH_NAME, "RPI4B", &profile, bc->batch_rows, 1000);
+}
+
+/**
+ * @name: static int bench_run(const bench_case_t *bc, int rows)
+ * @description: 运行一个用例并打印追加和补发的速度与每条记录的写入字节数
+ * @param {bench_case_t} *bc 用例
+ * @param {int} rows 追加的记录数
+ * @return {int} 0为正常执行，非0则出现错误
+ */
+static int bench_run(const bench_case_t *bc, int rows)
+{
+    static packinfo_t   drain[BENCH_DRAIN_ROWS];
+    spool_t             spool;
+    packinfo_t          pack_info;
+    time_t              t = 1767225600;
+    struct tm           tm;
+    int64_t             start;
+    double              append_s, drain_s;
+    long long           bytes;
+    long long           append_bytes, drain_bytes;
+    int                 drained = 0;
+    int                 count;
+    int                 i;
+
+    bench_remove();
+    bytes = bench_write_bytes();
+    if (bench_open(&spool, bc) < 0)
+    {
+        return -1;
+    }
+
+    // 追加：断网期间的采样，关闭时提交剩余的行，SQLite的检查点也计入写入量
+    start = bench_now_ns();
+    for (i = 0; i < rows; i++, t += 4)
+    {
+        memset(&pack_info, 0, sizeof(pack_info));
+        localtime_r(&t, &tm);
+        strcpy(pack_info.devid, "RPI4B");
+        strftime(pack_info.time, sizeof(pack_info.time), "%Y-%m-%d %H:%M:%S", &tm);
+        pack_info.ts   = (int64_t)t * 1000;
+        pack_info.temp = 20.0 + (i % 500) / 100.0;
+        pack_info.humi = 40.0 + (i % 300) / 100.0;
+        if (spool_append(&spool, &pack_info) < 0)
+        {
+            spool_close(&spool);
+            return -2;
+        }
+    }
+    spool_close(&spool);
+    append_s     = (bench_now_ns() - start) / 1e9;
+    append_bytes = bench_write_bytes() - bytes;
+
+    // 补发：每次读回一批并删除
+    bytes = bench_write_bytes();
+    start = bench_now_ns();
+    if (bench_open(&spool, bc) < 0)
+    {
+        return -3;
+    }
+    while ((count = spool_read(&spool, drain, BENCH_DRAIN_ROWS)) > 0)
+    {
+        if (spool_consume(&spool) < 0)
+        {
+            spool_close(&spool);
+            return -4;
+        }
+        drained += count;
+    }
+    spool_close(&spool);
+    drain_s     = (bench_now_ns() - start) / 1e9;
+    drain_bytes = bench_write_bytes() - bytes;
+
+    if (drained != rows)
+    {
+        printf("%s: drained %d of %d rows\n", bc->spool, drained, rows);
+        return -5;
+    }
+
+    printf("%-6s %-10s %5d  %12.0f %12.1f  %12.0f %12.1f\n", bc->spool, bc->profile, bc->batch_rows,
+           rows / append_s, bytes < 0 ? -1.0 : (double)append_bytes / rows,
+           rows / drain_s, bytes < 0 ? -1.0 : (double)drain_bytes / rows);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int             rows = BENCH_ROWS;
+    int             i;
+
+    if ((argc > 1) && (chdir(argv[1]) < 0))
+    {
+        printf("chdir %s failed\n", argv[1]);
+        return -1;
+    }
+
+    if ((argc > 2) && ((rows = atoi(argv[2])) < 1))
+    {
+        printf("Usage: %s [DIR] [ROWS]\n", argv[0]);
+        return -1;
+    }
+
+    logger_init("stdout", LOG_LEVEL_FATAL);
+
+    printf("rows: %d, mmap record %d bytes\n", rows, MMAP_SPOOL_REC_SIZE);
+    printf("%-6s %-10s %5s  %12s %12s  %12s %12s\n", "spool", "profile", "batch",
+           "append/s", "bytes/append", "drain/s", "bytes/drain");
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        if (bench_run(&cases[i], rows) < 0)
+        {
+            printf("%s %s failed\n", cases[i].spool, cases[i].profile);
+            return -2;
+        }
+    }
+    bench_remove();
+
+    return 0;
+}